@@ -0,0 +1,91 @@
+/*! \file adc.c
+ *  \brief implementacao do objeto conversor A/D.
+ *
+ *  Cada leitura liga a referencia e o ADC, faz uma conversao e desliga tudo de novo, para nao
+ *  gastar corrente entre os relatorios do sensor.
+ */
+
+#include "adc.h"
+#include "cc430x513x.h"
+
+// DEFINES
+#define ADC_REF_SETTLE     1000      // ciclos de MCLK (~12 MHz) para a referencia estabilizar (75 us)
+#define ADC_FULL_SCALE     4096
+#define ADC_REF_2V5        2500      // mV
+
+// calibracao do sensor de temperatura gravada na fabrica (TLV), com a referencia de 1,5 V
+#define ADC_CAL_15V_30C    (*(unsigned short *)0x1A1A)
+#define ADC_CAL_15V_85C    (*(unsigned short *)0x1A1C)
+
+// prototipos dos metodos
+void adcInit          (void * padc);
+signed short adcRead  (void * padc, ADC_INPUT input);
+
+// instancia do conversor
+ADC adc = {adcInit};
+
+// implementacao dos metodos
+void adcInit          (void * padc)
+{
+   ADC * a = (ADC *)padc;
+   
+   a->read = adcRead;
+   a->raw = 0;
+   
+#ifdef ADC_LEVEL_INPUT
+   P2SEL |= BIT0;                     // A0 como entrada analogica
+#endif
+   ADC12CTL0 = 0;
+   REFCTL0 = REFMSTR;                 // referencia controlada pelo REFCTL0, desligada
+}
+
+/*! \brief Faz uma conversao da entrada e converte para a unidade dela.
+ *   \return o valor lido (mV, 0,1 grau C ou a contagem bruta do nivel)
+ */
+signed short adcRead  (void * padc, ADC_INPUT input)
+{
+   ADC * a = (ADC *)padc;
+   unsigned short mctl;
+   
+   switch (input)
+   {
+      case ADC_INPUT_BATTERY:
+         // (AVCC - AVSS) / 2 passa de 1,5 V: usa a referencia de 2,5 V
+         REFCTL0 = REFMSTR + REFVSEL_2 + REFON;
+         mctl = ADC12SREF_1 + ADC12INCH_11;
+         break;
+      case ADC_INPUT_TEMPERATURE:
+         REFCTL0 = REFMSTR + REFVSEL_0 + REFON;
+         mctl = ADC12SREF_1 + ADC12INCH_10;
+         break;
+      default:
+         mctl = ADC12SREF_0 + ADC12INCH_0;
+         break;
+   }
+   
+   ADC12CTL0 = ADC12SHT0_8 + ADC12ON; // 256 ciclos de amostragem (o sensor de temperatura pede 30 us)
+   ADC12CTL1 = ADC12SHP;
+   ADC12CTL2 = ADC12RES_2;            // 12 bits
+   ADC12MCTL0 = mctl;
+   __delay_cycles(ADC_REF_SETTLE);
+   
+   ADC12CTL0 |= ADC12ENC + ADC12SC;
+   while (ADC12CTL1 & ADC12BUSY);
+   a->raw = ADC12MEM0;
+   
+   ADC12CTL0 &= ~ADC12ENC;
+   ADC12CTL0 = 0;
+   REFCTL0 = REFMSTR;
+   
+   switch (input)
+   {
+      case ADC_INPUT_BATTERY:
+         return (signed short)(((unsigned long)a->raw * 2 * ADC_REF_2V5) / ADC_FULL_SCALE);
+      case ADC_INPUT_TEMPERATURE:
+         if (ADC_CAL_15V_85C == ADC_CAL_15V_30C) return 0;
+         return (signed short)((((signed long)a->raw - ADC_CAL_15V_30C) * 550) /
+                               ((signed long)ADC_CAL_15V_85C - ADC_CAL_15V_30C) + 300);
+      default:
+         return (signed short)a->raw;
+   }
+}
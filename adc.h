@@ -0,0 +1,23 @@
+/*! \file adc.h
+ *  \brief interface publica para o objeto conversor A/D (ADC12_A com a referencia interna).
+ */
+
+// defina ADC_LEVEL_INPUT para ler o nivel analogico da entrada A0 (P2.0)
+
+typedef enum
+{
+   ADC_INPUT_BATTERY = 0,            // tensao de alimentacao (mV)
+   ADC_INPUT_TEMPERATURE,            // sensor de temperatura interno (0,1 grau C)
+   ADC_INPUT_LEVEL,                  // entrada analogica A0 em relacao a AVCC (0 a 4095)
+   ADC_INPUT_COUNT
+} ADC_INPUT;
+
+typedef struct ADC_STRUCT
+{
+   void (* init)              (void * padc);
+   signed short (* read)      (void * padc, ADC_INPUT input);
+   
+   unsigned short raw;               // ultima conversao, sem escala
+} ADC;
+
+extern ADC adc;
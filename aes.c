@@ -0,0 +1,272 @@
+/*! \file aes.c
+ *  \brief implementacao do AES-128 (so cifragem) e do modo CCM (RFC 3610).
+ *
+ *  CCM com L = 2 e MIC de AES_CCM_MIC_SIZE bytes: CBC-MAC sobre B0, os dados associados
+ *  (precedidos do tamanho em 2 bytes) e a mensagem, cada parte completada com zeros ate o
+ *  bloco; a mensagem e cifrada em modo contador a partir de A1 e o MIC e o CBC-MAC cifrado
+ *  com A0. Mensagens de ate 255 bytes (contador de bloco em um byte).
+ */
+
+#include "aes.h"
+#ifndef AES_SOFTWARE
+#include "cc430x513x.h"
+#endif
+
+// flags do B0 (Adata, M, L) e dos blocos A (L)
+#define AES_CCM_FLAGS_B0    (0x40 | (((AES_CCM_MIC_SIZE - 2) / 2) << 3) | (2 - 1))
+#define AES_CCM_FLAGS_A     (2 - 1)
+
+static unsigned char aesCbcMac (const unsigned char * key, unsigned char * x, unsigned char pos, const unsigned char * data, unsigned char len);
+static void aesCcmMac (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                       const unsigned char * data, unsigned char len, unsigned char * tag);
+static void aesCcmCtr (const unsigned char * key, const unsigned char * nonce, unsigned char * data, unsigned char len, unsigned char * tag);
+
+#ifdef AES_SOFTWARE
+
+// multiplicacao por x no GF(2^8)
+#define AES_XTIME(x) ((unsigned char)(((x) << 1) ^ (((x) & 0x80) ? 0x1B : 0x00)))
+
+const unsigned char AES_SBOX[256] =
+{
+   0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+   0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+   0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+   0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+   0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+   0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+   0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+   0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+   0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+   0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+   0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+   0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+   0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+   0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+   0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+   0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+/*! \brief Cifra um bloco com AES-128. As chaves de rodada sao calculadas durante a cifragem,
+ *   sem tabela expandida na RAM. dataIn e dataOut podem ser o mesmo buffer.
+ */
+void aesEncrypt (const unsigned char * key, const unsigned char * dataIn, unsigned char * dataOut)
+{
+   unsigned char state[AES_BLOCK_SIZE];
+   unsigned char roundKey[AES_KEY_SIZE];
+   unsigned char rcon = 0x01;
+   unsigned char i, t;
+   
+   for (i = 0; i < AES_BLOCK_SIZE; i++)
+   {
+      roundKey[i] = key[i];
+      state[i] = dataIn[i] ^ key[i];
+   }
+   for (unsigned char round = 1; round <= 10; round++)
+   {
+      // SubBytes
+      for (i = 0; i < AES_BLOCK_SIZE; i++)
+      {
+         state[i] = AES_SBOX[state[i]];
+      }
+      // ShiftRows (o estado e guardado por colunas)
+      t = state[1]; state[1] = state[5]; state[5] = state[9]; state[9] = state[13]; state[13] = t;
+      t = state[2]; state[2] = state[10]; state[10] = t;
+      t = state[6]; state[6] = state[14]; state[14] = t;
+      t = state[15]; state[15] = state[11]; state[11] = state[7]; state[7] = state[3]; state[3] = t;
+      // MixColumns, menos na ultima rodada
+      if (round < 10)
+      {
+         for (i = 0; i < AES_BLOCK_SIZE; i += 4)
+         {
+            unsigned char a0 = state[i], a1 = state[i + 1], a2 = state[i + 2], a3 = state[i + 3];
+            t = a0 ^ a1 ^ a2 ^ a3;
+            state[i]     = a0 ^ t ^ AES_XTIME(a0 ^ a1);
+            state[i + 1] = a1 ^ t ^ AES_XTIME(a1 ^ a2);
+            state[i + 2] = a2 ^ t ^ AES_XTIME(a2 ^ a3);
+            state[i + 3] = a3 ^ t ^ AES_XTIME(a3 ^ a0);
+         }
+      }
+      // proxima chave de rodada e AddRoundKey
+      roundKey[0] ^= AES_SBOX[roundKey[13]] ^ rcon;
+      roundKey[1] ^= AES_SBOX[roundKey[14]];
+      roundKey[2] ^= AES_SBOX[roundKey[15]];
+      roundKey[3] ^= AES_SBOX[roundKey[12]];
+      for (i = 4; i < AES_KEY_SIZE; i++)
+      {
+         roundKey[i] ^= roundKey[i - 4];
+      }
+      rcon = AES_XTIME(rcon);
+      for (i = 0; i < AES_BLOCK_SIZE; i++)
+      {
+         state[i] ^= roundKey[i];
+      }
+   }
+   for (i = 0; i < AES_BLOCK_SIZE; i++)
+   {
+      dataOut[i] = state[i];
+   }
+}
+
+#else
+
+static const unsigned char * aesKeyLoaded = 0;    // chave que esta no modulo AES
+
+/*! \brief Cifra um bloco com AES-128 no modulo AES do CC430. A chave so e escrita no modulo
+ *   quando muda. dataIn e dataOut podem ser o mesmo buffer.
+ */
+void aesEncrypt (const unsigned char * key, const unsigned char * dataIn, unsigned char * dataOut)
+{
+   unsigned char i;
+   
+   if (key != aesKeyLoaded)
+   {
+      AESACTL0 = AESOP_0;             // cifragem
+      for (i = 0; i < AES_KEY_SIZE; i += 2)
+      {
+         AESAKEY = key[i] | ((unsigned short)key[i + 1] << 8);
+      }
+      while (!(AESASTAT & AESKEYWR));
+      aesKeyLoaded = key;
+   }
+   
+   // a cifragem comeca sozinha depois do 16o byte
+   for (i = 0; i < AES_BLOCK_SIZE; i += 2)
+   {
+      AESADIN = dataIn[i] | ((unsigned short)dataIn[i + 1] << 8);
+   }
+   while (AESASTAT & AESBUSY);
+   for (i = 0; i < AES_BLOCK_SIZE; i += 2)
+   {
+      unsigned short word = AESADOUT;
+      dataOut[i] = (unsigned char)word;
+      dataOut[i + 1] = (unsigned char)(word >> 8);
+   }
+}
+
+#endif
+
+/*! \brief Cifra a mensagem no lugar e calcula o MIC. Os dados associados (aad) sao so autenticados. */
+void aesCcmEncrypt (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                    unsigned char * data, unsigned char len, unsigned char * mic)
+{
+   unsigned char tag[AES_BLOCK_SIZE];
+   
+   aesCcmMac (key, nonce, aad, aadLen, data, len, tag);
+   aesCcmCtr (key, nonce, data, len, tag);
+   for (unsigned char i = 0; i < AES_CCM_MIC_SIZE; i++)
+   {
+      mic[i] = tag[i];
+   }
+}
+
+/*! \brief Decifra a mensagem no lugar e confere o MIC. Se o MIC nao confere a mensagem
+ *   decifrada tem que ser descartada.
+ *   \return 1 se o MIC confere
+ */
+char aesCcmDecrypt (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                    unsigned char * data, unsigned char len, const unsigned char * mic)
+{
+   unsigned char tag[AES_BLOCK_SIZE];
+   unsigned char s0[AES_BLOCK_SIZE];
+   unsigned char diff = 0;
+   
+   // S0 sai junto com a decifragem (tag zerado), depois o CBC-MAC e feito sobre a mensagem aberta
+   for (unsigned char i = 0; i < AES_CCM_MIC_SIZE; i++)
+   {
+      s0[i] = 0;
+   }
+   aesCcmCtr (key, nonce, data, len, s0);
+   aesCcmMac (key, nonce, aad, aadLen, data, len, tag);
+   
+   // compara todos os bytes, sem sair no primeiro diferente
+   for (unsigned char i = 0; i < AES_CCM_MIC_SIZE; i++)
+   {
+      diff |= (tag[i] ^ s0[i]) ^ mic[i];
+   }
+   return (diff == 0);
+}
+
+/*! \brief Passa dados pelo CBC-MAC a partir da posicao pos do bloco corrente.
+ *   \return posicao no bloco corrente depois dos dados
+ */
+static unsigned char aesCbcMac (const unsigned char * key, unsigned char * x, unsigned char pos, const unsigned char * data, unsigned char len)
+{
+   for (unsigned char i = 0; i < len; i++)
+   {
+      x[pos] ^= data[i];
+      if (++pos == AES_BLOCK_SIZE)
+      {
+         aesEncrypt (key, x, x);
+         pos = 0;
+      }
+   }
+   return pos;
+}
+
+/*! \brief CBC-MAC do CCM (B0, dados associados e mensagem aberta). */
+static void aesCcmMac (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                       const unsigned char * data, unsigned char len, unsigned char * tag)
+{
+   unsigned char pos;
+   
+   tag[0] = (aadLen != 0) ? AES_CCM_FLAGS_B0 : (AES_CCM_FLAGS_B0 & ~0x40);
+   for (unsigned char i = 0; i < AES_CCM_NONCE_SIZE; i++)
+   {
+      tag[i + 1] = nonce[i];
+   }
+   tag[14] = 0;
+   tag[15] = len;
+   aesEncrypt (key, tag, tag);
+   
+   if (aadLen != 0)
+   {
+      // tamanho dos dados associados em 2 bytes e os dados, completando o bloco com zeros
+      tag[1] ^= aadLen;
+      pos = aesCbcMac (key, tag, 2, aad, aadLen);
+      if (pos != 0)
+      {
+         aesEncrypt (key, tag, tag);
+      }
+   }
+   pos = aesCbcMac (key, tag, 0, data, len);
+   if (pos != 0)
+   {
+      aesEncrypt (key, tag, tag);
+   }
+}
+
+/*! \brief Modo contador do CCM: cifra (ou decifra) a mensagem com A1, A2, ... e o inicio do
+ *   tag com A0.
+ */
+static void aesCcmCtr (const unsigned char * key, const unsigned char * nonce, unsigned char * data, unsigned char len, unsigned char * tag)
+{
+   unsigned char a[AES_BLOCK_SIZE];
+   unsigned char s[AES_BLOCK_SIZE];
+   unsigned char i, n;
+   
+   a[0] = AES_CCM_FLAGS_A;
+   for (i = 0; i < AES_CCM_NONCE_SIZE; i++)
+   {
+      a[i + 1] = nonce[i];
+   }
+   a[14] = 0;
+   a[15] = 0;
+   aesEncrypt (key, a, s);
+   for (i = 0; i < AES_CCM_MIC_SIZE; i++)
+   {
+      tag[i] ^= s[i];
+   }
+   
+   while (len != 0)
+   {
+      ++a[15];
+      aesEncrypt (key, a, s);
+      n = (len < AES_BLOCK_SIZE) ? len : AES_BLOCK_SIZE;
+      for (i = 0; i < n; i++)
+      {
+         data[i] ^= s[i];
+      }
+      data += n;
+      len -= n;
+   }
+}
@@ -0,0 +1,19 @@
+/*! \file aes.h
+ *  \brief interface publica para a cifra AES-128 e o modo CCM (cifragem com autenticacao).
+ *
+ *  No alvo o bloco e cifrado pelo modulo AES do CC430. Defina AES_SOFTWARE para usar a
+ *  implementacao em C (compilacao fora da placa e testes). O CCM so usa a cifragem do bloco.
+ */
+
+#define AES_BLOCK_SIZE      16
+#define AES_KEY_SIZE        16
+#define AES_CCM_NONCE_SIZE  13       // L = 2 (mensagens de ate 65535 bytes)
+#ifndef AES_CCM_MIC_SIZE
+#define AES_CCM_MIC_SIZE    4        // MIC curto: 4, 6, 8, ... 16
+#endif
+
+void aesEncrypt (const unsigned char * key, const unsigned char * dataIn, unsigned char * dataOut);
+void aesCcmEncrypt (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                    unsigned char * data, unsigned char len, unsigned char * mic);
+char aesCcmDecrypt (const unsigned char * key, const unsigned char * nonce, const unsigned char * aad, unsigned char aadLen,
+                    unsigned char * data, unsigned char len, const unsigned char * mic);
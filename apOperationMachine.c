@@ -4,7 +4,6 @@
 
 #include "apOperationMachine.h"
 #include "cc430x513x.h"
-#include "scrambler.h"
 
 // defines
 #define SYS_CLK       12000000UL
@@ -17,25 +16,36 @@
 #define DEFAULT_COMM_TIMEOUT 5
 
 #define COMM_MAX_TIMEOUT 5
-const unsigned short timeoutList[] = {1*OP_FREQ, 2*OP_FREQ, 4*OP_FREQ, 8*OP_FREQ, 16*OP_FREQ, 32*OP_FREQ};
 
-unsigned char discoveryAckPkg[] = {   14,                  // tamanho do pacote
-                                    0x00,                  // endereco do AP
-                                    0x00, 0x00, 0x00,      // semente do scrambler
-                                    'D','A','C','K',       // payload
-                                    0x31, 0x32, 0x33, 0x34,// ID do sensor
-                                    0x30,                  // tipo do sensor
-                                    0x46                   // checksum
-                                  };
-
-unsigned char statusAckPkg[]   =  {   14,                  // tamanho do pacote
-                                    0x00,                  // endereco do AP
-                                    0x00, 0x00, 0x00,      // semente do scrambler
-                                    'S','A','C','K',       // payload
-                                    0x31, 0x32, 0x33, 0x34,// ID do sensor
-                                    0x30,                  // tipo do sensor
-                                    0x46                   // checksum
-                                  };
+// preambulo do pacote de POLL: maior que o periodo do WOR dos EDs (~1s)
+#define WOR_PREAMBLE_MS 1100
+
+// periodos de recepcao em que o novo perfil de camada fisica e anunciado nos SACKs antes da troca
+#define PHY_ANNOUNCE_PERIODS 2
+#define PHY_NONE 0xFF
+
+// TDMA: um beacon a cada TDMA_PERIOD e cada ED transmite no slot do seu endereco; o slot cabe o
+// STATUS, o SACK e a folga TDMA_SLOT_GUARD. Os EDs sincronizados escutam na hora do beacon, entao
+// so um a cada TDMA_RESYNC_BEACONS vai com o preambulo do WOR, para os EDs sem sincronia
+#define TDMA_PERIOD      (16 * OP_FREQ)  // igual ao intervalo normal de relatorio dos EDs
+#define TDMA_SLOT_GUARD  3               // 10 ms
+#define TDMA_RESYNC_BEACONS 8            // ~2 min; o preambulo longo fica em <1% do tempo
+// o beacon com o preambulo do WOR comeca antes, para o pacote ir ao ar na hora (a referencia dos EDs)
+#define TDMA_BEACON_LEAD(op) (((op)->beaconCount == 0) ? (WOR_PREAMBLE_MS / 10) : 0)
+
+// os enderecos distribuidos aos EDs vao de RADIO_ADDR_ED_FIRST ate um por sensor da lista
+#define ED_ADDR_VALID(addr) (((addr) >= RADIO_ADDR_ED_FIRST) && ((addr) < (RADIO_ADDR_ED_FIRST + SENSOR_LIST_SIZE)))
+
+// maior pacote que o perfil de camada fisica transmite
+#define AP_FRAME_MAX(phy) (((phy) == RADIO_PHY_38K4_FEC) ? RADIO_FEC_FRAME_LEN : (RADIO_RX_BUFFER_SIZE - 2))
+
+// maior intervalo entre relatorios que pode ser pedido aos EDs (s)
+#define CONFIG_INTERVAL_MAX 3600
+// CSMA dos ACKs: o AP responde logo (sem espera inicial) e com poucas tentativas,
+// para nao ficar surdo enquanto o canal esta ocupado
+const RADIO_CSMA_CONFIG apCsma = {0, 3, 3, 320, 0};
+
+const unsigned short timeoutList[] = {1*OP_FREQ, 2*OP_FREQ, 4*OP_FREQ, 8*OP_FREQ, 16*OP_FREQ, 32*OP_FREQ};
 
 // prototipos dos metodos do objeto
 void opInit       (void * pOp);
@@ -46,9 +56,23 @@ void opIncTimer   (void * pOp);
 SENSOR_WRITE_STATUS opSensorWrite(void * pOp, unsigned char * sensorID, unsigned char sensorLen);
 SENSOR_ERASE_STATUS opSensorErase(void * pOp, unsigned char * sensorID, unsigned char sensorLen);
 signed char opSensorGetPos       (void * pOp, unsigned char * sensorID);
+void opEpochSave (unsigned short epoch);
 unsigned char opSensorGetCount   (void * pOp);
 
 void valueToASCII (unsigned char * input, unsigned char * output);
+unsigned char opSensorFreeAddr (OPERATION_MACHINE * op);
+void opBeaconSend (OPERATION_MACHINE * op);
+char opDownlinkPending (OPERATION_MACHINE * op, unsigned char idx);
+char opSeqCheck (OPERATION_MACHINE * op, unsigned char idx, unsigned char seq, unsigned char flags);
+void opSeqReset (OPERATION_MACHINE * op, unsigned char idx);
+unsigned char opPaClamp (unsigned short level);
+void opEpochAccepted (OPERATION_MACHINE * op, unsigned char idx);
+void opEventsReport (OPERATION_MACHINE * op, signed char pos);
+void opChanDecode (OPERATION_MACHINE * op);
+char opConfigParse (const unsigned char * text, PACKET_CONFIG * type, unsigned short * value);
+void opConfigSet (OPERATION_MACHINE * op, unsigned char idx, PACKET_CONFIG type, unsigned short value);
+void opConfigFill (OPERATION_MACHINE * op, PACKET_SACK * sack, unsigned char * flags);
+void opConfigAcked (OPERATION_MACHINE * op);
 
 __no_init OPERATION_MACHINE operationMachine;// = {opInit};
 
@@ -77,6 +101,8 @@ void opInit       (void * pOp)
    op->commTimeout = DEFAULT_COMM_TIMEOUT;
    
    op->earlyMessage = 0;
+   op->phyPending = PHY_NONE;
+   op->seq = 0;
 
    //inicializa a lista de sensores
    op->sensorsFound = op->sensorGetCount(op);
@@ -91,14 +117,18 @@ void opInit       (void * pOp)
          op->sensorValue[i][2] = 0; 
          op->sensorValue[i][3] = 0; 
          op->sensorType[i] = 0;
+         op->sensorRssi[i] = 0;
+         op->sensorLqi[i] = 0;
       }
    }
    for (unsigned char i = 0; i < SENSOR_LIST_SIZE; i++)
    {
       op->sensorStatus[i] = SENSOR_COMM_STATUS_NOT_PRESENT;
+      opSeqReset(op, i);
    }
    // inicializa o radio
    op->radio->init(op->radio);
+   op->radio->setCsma(op->radio, &apCsma);
    
    // inicializa a serial
    op->serial->init(op->serial);
@@ -109,6 +139,22 @@ void opInit       (void * pOp)
    // inicializa a flash
    op->flash->init();
    
+   // chaves da instalacao e nova epoca do contador de quadros dos pacotes
+   packetSecurityInit(op->flash->epoch, opEpochSave, op->flash->secret);
+   // o ultimo contador aceito de cada ED nao sobrevive ao boot: so aceita epocas mais novas que
+   // a gravada (o ED passa para a proxima quando fica sem ACK), para nao aceitar pacotes gravados
+   for (unsigned char i = 0; i < SENSOR_LIST_SIZE; i++)
+   {
+      op->edCounter[i] = ((unsigned long)op->flash->edEpochs[i] << 16) | 0xFFFF;
+   }
+   
+   op->beaconTick = op->radio->ticks;
+   op->beaconCount = 0;                // o primeiro beacon ja sincroniza os EDs
+   for (unsigned char i = 0; i < (PACKET_SLOT_COUNT / 8); i++)
+   {
+      op->ackMap[i] = 0;
+   }
+   
    // manda pro estado inicial da maquina
    op->setState(op, OPERATION_MACHINE_STATE_IDLE);
    //op->setState(op, OPERATION_MACHINE_STATE_DEBUG);
@@ -133,9 +179,33 @@ void opRun        (void * pOp)
    unsigned char * tempPtr;
    SENSOR_WRITE_STATUS ret;
    SENSOR_ERASE_STATUS retE;
+   signed char tempPos;
+   PACKET_TYPE packetType;
+   char duplicate;
    
    OPERATION_MACHINE * op = (OPERATION_MACHINE *)pOp;
    
+   // andamento da transmissao do radio (ACKs sao enviados sem bloquear)
+   op->radio->run(op->radio);
+   
+   // a busca de sensores e feita na rede e no perfil de pareamento, o resto na rede e no perfil
+   // do AP (troca so com o radio livre, setNetwork e setPhy nao fazem nada se nao mudou)
+   if (op->radio->txState == RADIO_TX_STATE_IDLE)
+   {
+      if ((op->state == OPERATION_MACHINE_STATE_SCAN_WAIT) || (op->state == OPERATION_MACHINE_STATE_SCAN_ACK))
+      {
+         op->radio->setNetwork(op->radio, RADIO_NETWORK_PAIRING, RADIO_ADDR_AP);
+         op->radio->setPhy(op->radio, RADIO_PHY_PAIRING);
+         packetSetNetwork(RADIO_NETWORK_PAIRING);
+      }
+      else
+      {
+         op->radio->setNetwork(op->radio, op->flash->netId, RADIO_ADDR_AP);
+         op->radio->setPhy(op->radio, (RADIO_PHY)op->flash->phy);
+         packetSetNetwork(op->flash->netId);
+      }
+   }
+   
    op->serial->processBuffRx(op->serial);
    if (op->serial->getMessage(op->serial, &serialMessage))
    {
@@ -196,8 +266,143 @@ void opRun        (void * pOp)
             ++tempPtr;
             op->serial->transmit(op->serial, op->tempBuff);
             break;
+         case SERIAL_MESSAGE_SENSOR_QUALITY:
+            // qualidade do enlace do ultimo pacote recebido de cada sensor, a potencia de transmissao
+            // dele (atual e media, em dBm) e os STATUS perdidos e repetidos
+            op->serial->transmit(op->serial, "{");
+            for (i = 0; i < op->sensorsFound; i++)
+            {
+               unsigned char idx = op->flash->sensors[i][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST;
+               char valid = ED_ADDR_VALID(op->flash->sensors[i][SENSOR_ADDR_POS]);
+               op->serial->transmit(op->serial, "%I:%d,%d,%d,%d,%d,%d\r", &(op->flash->sensors[i]), op->sensorRssi[i], op->sensorLqi[i],
+                                    valid ? RADIO_PA_DBM[opPaClamp(op->edPaLevel[idx])] : 0,
+                                    valid ? RADIO_PA_DBM[opPaClamp((op->edPaAvg[idx] + 8) >> 4)] : 0,
+                                    valid ? (int)op->edLost[idx] : 0, valid ? (int)op->edDup[idx] : 0);
+            }
+            op->serial->transmit(op->serial, "CRC:%d}", op->radio->rxCrcError);
+            break;
+         case SERIAL_MESSAGE_SENSOR_DATA:
+            // canais de cada sensor (contato, nivel, bateria em mV, temperatura em 0,1 grau C); ? se desconhecido
+            op->serial->transmit(op->serial, "{");
+            for (i = 0; i < op->sensorsFound; i++)
+            {
+               unsigned char idx = op->flash->sensors[i][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST;
+               char valid = ED_ADDR_VALID(op->flash->sensors[i][SENSOR_ADDR_POS]);
+               op->serial->transmit(op->serial, "%I:", &(op->flash->sensors[i]));
+               for (unsigned char j = 0; j < PACKET_CHAN_COUNT; j++)
+               {
+                  if (valid && (op->edChanValid[idx] & (1 << j)))
+                  {
+                     op->serial->transmit(op->serial, "%d", (int)op->edChan[idx][j]);
+                  }
+                  else
+                  {
+                     op->serial->transmit(op->serial, "?");
+                  }
+                  op->serial->transmit(op->serial, (j < PACKET_CHAN_COUNT - 1) ? "," : "\r");
+               }
+            }
+            op->serial->transmit(op->serial, "}");
+            break;
+         case SERIAL_MESSAGE_SENSOR_CONFIG:
+            // comando de configuracao para o sensor (ou para todos com o ID "****"), levado nos proximos
+            // SACKs: tipo (opConfigParse) e valor com 4 digitos decimais
+            {
+               unsigned short value;
+               PACKET_CONFIG type;
+               char all = (op->serial->var1[0] == '*') && (op->serial->var1[1] == '*') &&
+                          (op->serial->var1[2] == '*') && (op->serial->var1[3] == '*');
+               char ok = opConfigParse(&(op->serial->var1[SENSOR_ID_SIZE]), &type, &value);
+               unsigned char count = 0;
+               
+               for (i = 0; ok && (i < op->sensorsFound); i++)
+               {
+                  if (!ED_ADDR_VALID(op->flash->sensors[i][SENSOR_ADDR_POS])) continue;
+                  if (!all && !packetIdMatch(op->serial->var1, op->flash->sensors[i])) continue;
+                  opConfigSet(op, op->flash->sensors[i][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST, type, value);
+                  ++count;
+               }
+               op->serial->transmit(op->serial, (count != 0) ? "\rOK\r" : "\rERRO\r");
+            }
+            break;
+         case SERIAL_MESSAGE_SENSOR_GROUP:
+            // um pacote com preambulo longo para um grupo de sensores (FF todos, 80 + tipo, zona 01 a 7F):
+            // R pede o status, os outros tipos de opConfigParse configuram. A configuracao de grupo nao
+            // e confirmada, entao os sensores do grupo conhecidos pelo AP tambem a recebem nos SACKs
+            {
+               PACKET_CONFIG type = PACKET_CONFIG_COUNT;
+               unsigned short value = 0;
+               unsigned char group = 0;
+               char ok = 1;
+               
+               for (unsigned char j = 0; j < 2; j++)
+               {
+                  unsigned char c = op->serial->var1[j];
+                  group <<= 4;
+                  if ((c >= '0') && (c <= '9')) group |= c - '0';
+                  else if ((c >= 'A') && (c <= 'F')) group |= c - 'A' + 10;
+                  else ok = 0;
+               }
+               if (op->serial->var1[2] != 'R')
+               {
+                  ok = ok && opConfigParse(&(op->serial->var1[2]), &type, &value);
+               }
+               if (!ok || (group == 0) || (op->radio->txState != RADIO_TX_STATE_IDLE))
+               {
+                  op->serial->transmit(op->serial, "\rERRO\r");
+                  break;
+               }
+               
+               {
+                  PACKET tx;
+                  
+                  packetSetHeader(&tx, PACKET_TYPE_GROUP, 0, ++op->seq, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+                  tx.body.group.group = group;
+                  tx.body.group.poll = (type == PACKET_CONFIG_COUNT);
+                  tx.body.group.configCount = 0;
+                  if (type != PACKET_CONFIG_COUNT)
+                  {
+                     tx.body.group.config[0].type = type;
+                     tx.body.group.config[0].value[0] = (unsigned char)(value >> 8);
+                     tx.body.group.config[0].value[1] = (unsigned char)value;
+                     tx.body.group.configCount = 1;
+                  }
+                  op->tempLen = packetBuild(&tx, op->tempBuff);
+                  op->radio->transmitWakeup(op->radio, op->tempBuff, op->tempLen, WOR_PREAMBLE_MS, (op->radio->state == RADIO_STATE_RX_MODE));
+               }
+               
+               for (i = 0; (type != PACKET_CONFIG_COUNT) && (i < op->sensorsFound); i++)
+               {
+                  unsigned char idx = op->flash->sensors[i][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST;
+                  if (!ED_ADDR_VALID(op->flash->sensors[i][SENSOR_ADDR_POS])) continue;
+                  if (!packetGroupMatch(group, op->flash->sensors[i][SENSOR_ID_SIZE], op->flash->zones[idx])) continue;
+                  opConfigSet(op, idx, type, value);
+               }
+               op->serial->transmit(op->serial, "\rOK\r");
+            }
+            break;
+         case SERIAL_MESSAGE_SENSOR_POLL:
+            // acorda o sensor (em WOR) com um preambulo longo e pede um relatorio de status
+            tempPos = op->sensorGetPos(op, op->serial->var1);
+            if ((tempPos != -1) && (op->radio->txState == RADIO_TX_STATE_IDLE))
+            {
+               PACKET tx;
+               
+               packetSetHeader(&tx, PACKET_TYPE_POLL, 0, ++op->seq, op->flash->sensors[tempPos][SENSOR_ADDR_POS], RADIO_ADDR_AP);
+               for (unsigned char j = 0; j < SENSOR_ID_SIZE; j++) tx.body.poll.id[j] = op->serial->var1[j];
+               op->tempLen = packetBuild(&tx, op->tempBuff);
+               
+               op->radio->transmitWakeup(op->radio, op->tempBuff, op->tempLen, WOR_PREAMBLE_MS, (op->radio->state == RADIO_STATE_RX_MODE));
+               op->serial->transmit(op->serial, "\rOK\r");
+            }
+            else
+            {
+               op->serial->transmit(op->serial, "\rERRO\r");
+            }
+            break;
          case SERIAL_MESSAGE_CHANNEL_SET:
-            if ( (op->serial->var1[0]  > '0') && (op->serial->var1[0] < ( '0' + OPERATION_MACHINE_MAX_CHANNELS)))
+            if ( (op->serial->var1[0] >= '0') && (op->serial->var1[0] < ( '0' + OPERATION_MACHINE_MAX_CHANNELS)) &&
+                 (op->radio->setChannel(op->radio, op->serial->var1[0] - '0')) )
             {
                op->channel = op->serial->var1[0] - '0';
                op->serial->transmit(op->serial, "\rOK\r");
@@ -210,6 +415,51 @@ void opRun        (void * pOp)
          case SERIAL_MESSAGE_CHANNEL_READ:
             op->serial->transmit(op->serial, "\rCHANNEL: %c\r", (op->channel + '0'));
             break;
+         case SERIAL_MESSAGE_NETWORK_SET:
+            // o AP troca a palavra de sincronismo e a chave na hora, e os sensores ja pareados so
+            // mudam de rede se forem pareados de novo: com sensores na lista so aceita a rede atual
+            // (apague os sensores antes de mudar a rede)
+            if ( (op->serial->var1[0] >= '0') && (op->serial->var1[0] < ( '0' + RADIO_NETWORK_COUNT)) &&
+                 ((op->sensorsFound == 0) || ((op->serial->var1[0] - '0') == op->flash->netId)) )
+            {
+               op->flash->netId = op->serial->var1[0] - '0';
+               op->flash->update();
+               op->serial->transmit(op->serial, "\rOK\r");
+            }
+            else
+            {
+               op->serial->transmit(op->serial, "\rERRO\r");
+            }
+            break;
+         case SERIAL_MESSAGE_PHY_SET:
+            // os sensores recebem o novo perfil nos SACKs e o AP so troca depois de alguns periodos
+            if ( (op->serial->var1[0] >= '0') && (op->serial->var1[0] < ( '0' + RADIO_PHY_COUNT)) )
+            {
+               op->phyPending = op->serial->var1[0] - '0';
+               op->phyAnnounce = 0;
+               if ((op->phyPending == op->flash->phy) || (op->sensorsFound == 0))
+               {
+                  op->flash->phy = op->phyPending;
+                  op->flash->update();
+                  op->phyPending = PHY_NONE;
+               }
+               op->serial->transmit(op->serial, "\rOK\r");
+            }
+            else
+            {
+               op->serial->transmit(op->serial, "\rERRO\r");
+            }
+            break;
+         case SERIAL_MESSAGE_PHY_READ:
+            {
+               // perfil em uso e o tempo no ar de um SACK (em ms)
+               unsigned long airtime = op->radio->airtime(op->radio, PACKET_FRAME_SIZE(PACKET_SACK_BASE_SIZE));
+               op->serial->transmit(op->serial, "\rPHY: %c AIRTIME: %d.%c ms\r", (op->radio->phy + '0'), (int)(airtime / 1000), (char)(((airtime / 100) % 10) + '0'));
+            }
+            break;
+         case SERIAL_MESSAGE_NETWORK_READ:
+            op->serial->transmit(op->serial, "\rNETWORK: %c\r", (op->flash->netId + '0'));
+            break;
          case SERIAL_MESSAGE_MODE_SEARCH:
             op->serial->transmit(op->serial, "\rMODE: SEARCH\r");
             
@@ -292,29 +542,23 @@ void opRun        (void * pOp)
          
          break;
       case OPERATION_MACHINE_STATE_SCAN_WAIT:
-         op->radio->isr();
-      
          if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            if ((op->tempBuff[0] - 6) > 14) op->tempBuff[0] = 20; // so processa mensagens de ate 20 caracteres
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0] - 6, &(op->tempBuff[2]));
+            if (!op->radio->rxLink.crcOk) break; // descarta pacotes corrompidos
             
-            if ( (op->message[0] == 'D') &&
-                 (op->message[1] == 'I') &&
-                 (op->message[2] == 'S') &&
-                 (op->message[3] == 'C')   )
+            if (packetParse(op->tempBuff, op->tempLen, &(op->packet)) == PACKET_TYPE_DISC)
             {
-               ret = op->sensorWrite(op, &(op->message[4]), 4);
+               ret = op->sensorWrite(op, op->packet.body.disc.id, PACKET_ID_SIZE);
                if (ret == SENSOR_WRITE_STATUS_OK)
                {
-                  //op->serial->transmit(op->serial, "\rNEW SENSOR: %s\r", &(op->message[4]));
+                  //op->serial->transmit(op->serial, "\rNEW SENSOR: %s\r", op->packet.body.disc.id);
                   op->setState(op, OPERATION_MACHINE_STATE_SCAN_ACK);
                   ++op->sensorsFound;
                   op->serial->transmit(op->serial, "[Modo Busca      \r %c%c encontrados ]\r", ((op->sensorsFound)/10) + '0', ((op->sensorsFound%10) + '0'));
                }
                else if (ret == SENSOR_WRITE_STATUS_ALREADY_ON_LIST)
                {
-                  //op->serial->transmit(op->serial, "\rSENSOR ALREADY ON LIST: %s\r", &(op->message[4]));
+                  //op->serial->transmit(op->serial, "\rSENSOR ALREADY ON LIST: %s\r", op->packet.body.disc.id);
                   op->setState(op, OPERATION_MACHINE_STATE_SCAN_ACK);
                   //++op->sensorsFound;
                }
@@ -332,54 +576,102 @@ void opRun        (void * pOp)
          }
          break;
       case OPERATION_MACHINE_STATE_SCAN_ACK:
-         //embaralha a mensagem antes de enviar
-         op->tempBuff[0 ] = sizeof(discoveryAckPkg) - 1; // tamanho do payload
-         op->tempBuff[1 ] = 0x00;                     // endereco do ED
-         op->tempBuff[2 ] = SCRAMBLER_SEED1;          // semente do scrambler
-         op->tempBuff[3 ] = SCRAMBLER_SEED2;          // semente do scrambler
-         op->tempBuff[4 ] = SCRAMBLER_SEED3;          // semente do scrambler
-         discoveryAckPkg[9 ] = op->message[4];    // ID do sensor
-         discoveryAckPkg[10] = op->message[5];    // ID do sensor
-         discoveryAckPkg[11] = op->message[6];    // ID do sensor
-         discoveryAckPkg[12] = op->message[7];    // ID do sensor
-         discoveryAckPkg[13] = op->message[8];    // ID do sensor
+         if (op->radio->txState != RADIO_TX_STATE_IDLE) break; // espera o radio terminar a transmissao anterior
          
-         scrambler (&(discoveryAckPkg[5]), &(op->tempBuff[5]), sizeof(discoveryAckPkg) - 5, &(op->tempBuff[2]));
+         {
+            PACKET tx;
+            
+            // o ED ainda nao tem endereco
+            packetSetHeader(&tx, PACKET_TYPE_DACK, 0, ++op->seq, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+            for (unsigned char j = 0; j < PACKET_ID_SIZE; j++) tx.body.dack.id[j] = op->packet.body.disc.id[j];
+            tx.body.dack.netId = op->flash->netId;  // rede em que o sensor vai operar
+            tempPos = op->sensorGetPos(op, op->packet.body.disc.id);
+            tx.body.dack.address = (tempPos != -1) ? op->flash->sensors[tempPos][SENSOR_ADDR_POS] : RADIO_ADDR_BROADCAST;
+            tx.body.dack.phy = (op->phyPending != PHY_NONE) ? op->phyPending : op->flash->phy;
+            tx.body.dack.sensorType = op->packet.body.disc.sensorType;
+            op->tempLen = packetBuild(&tx, op->tempBuff);
+         }
          
-         op->radio->transmit(op->radio, op->tempBuff, sizeof(discoveryAckPkg));
-         op->radio->receiveOn(op->radio);
+         // transmite sem bloquear e volta para a recepcao quando terminar
+         op->radio->transmitStart(op->radio, op->tempBuff, op->tempLen, 1);
          
          op->setState(op, OPERATION_MACHINE_STATE_SCAN_WAIT);
          op->setTimeout(op, 50 * 100);
          break;
       case OPERATION_MACHINE_STATE_RECEIVE_WAIT:
-         op->radio->isr();
-      
-         if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
+         if (((signed long)(op->radio->ticks - op->beaconTick) >= (TDMA_PERIOD - TDMA_BEACON_LEAD(op))) &&
+             (op->radio->txState == RADIO_TX_STATE_IDLE))
+         {
+            opBeaconSend(op);
+         }
+         else if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            signed char tempPos;
-            if ((op->tempBuff[0] - 4) > 14) op->tempBuff[0] = 18; // so processa mensagens de ate 20 caracteres
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0] - 4, &(op->tempBuff[2]));
-            op->message[op->tempBuff[0]-5] = 0;
-            //op->serial->transmit(op->serial, "\r RX DATA: %s\r", op->message);
+            if (!op->radio->rxLink.crcOk) break; // descarta pacotes corrompidos (sem ACK, o sensor retransmite)
+            
+            // o DISC de um sensor ja pareado (procurando o AP) tambem e confirmado com um SACK
+            packetType = packetParse(op->tempBuff, op->tempLen, &(op->packet));
+            if ((packetType != PACKET_TYPE_STATUS) && (packetType != PACKET_TYPE_DISC)) break;
+            
+            // descarta a repeticao de um pacote ja aceito do mesmo endereco
+            if (ED_ADDR_VALID(op->packet.hdr.src))
+            {
+               if (!packetCounterFresh(op->packet.hdr.counter, &(op->edCounter[op->packet.hdr.src - RADIO_ADDR_ED_FIRST]))) break;
+               opEpochAccepted(op, op->packet.hdr.src - RADIO_ADDR_ED_FIRST);
+            }
             
-            tempPos = op->sensorGetPos(op, &(op->message[0]));
+            // STATUS repetido (o SACK anterior se perdeu): so confirma de novo, sem reprocessar
+            duplicate = (packetType == PACKET_TYPE_STATUS) && ED_ADDR_VALID(op->packet.hdr.src) &&
+                        opSeqCheck(op, op->packet.hdr.src - RADIO_ADDR_ED_FIRST, op->packet.hdr.seq, op->packet.hdr.flags);
+            
+            // o ID esta no inicio do corpo do DISC e do STATUS
+            tempPos = op->sensorGetPos(op, op->packet.body.status.id);
+            op->ackAddress = RADIO_ADDR_BROADCAST;
             if (tempPos != -1)
+            {
+               op->ackAddress = op->flash->sensors[tempPos][SENSOR_ADDR_POS];
+            }
+            if ((tempPos != -1) && (packetType == PACKET_TYPE_STATUS) && !duplicate)
             {
                unsigned char tempValue[4];
                op->sensorStatus[tempPos] = SENSOR_COMM_STATUS_OK;
-               valueToASCII ((unsigned char *)&(op->message[5]), tempValue);
+               valueToASCII (op->packet.body.status.value, tempValue);
                if (tempValue[0] != op->sensorValue[tempPos][0])
                {
                   op->setTimeout(op, 1);
                   op->earlyMessage = 1;
                }
                for (unsigned char j = 0; j < 4; j++) op->sensorValue[tempPos][j] = tempValue[j];
-               //op->sensorType[tempPos] = op->message[4];
+               op->sensorRssi[tempPos] = op->radio->rxLink.rssi;
+               op->sensorLqi[tempPos] = op->radio->rxLink.lqi;
+               if ((op->packet.body.status.paLevel < RADIO_PA_LEVELS) && ED_ADDR_VALID(op->ackAddress))
+               { // nivel de potencia do sensor e a sua media (em 1/16 de nivel, peso 1/8), pelo endereco
+                  unsigned char idx = op->ackAddress - RADIO_ADDR_ED_FIRST;
+                  op->edPaLevel[idx] = op->packet.body.status.paLevel;
+                  op->edPaAvg[idx] = op->edPaAvg[idx] - (op->edPaAvg[idx] >> 3) + (op->packet.body.status.paLevel << 1);
+               }
+               // tipo informado pelo sensor: e o que os grupos por tipo usam (0xFF marca entrada livre)
+               op->sensorType[tempPos] = op->packet.body.status.sensorType;
+               if ((op->packet.body.status.sensorType != 0xFF) &&
+                   (op->flash->sensors[tempPos][SENSOR_ID_SIZE] != op->packet.body.status.sensorType))
+               {
+                  op->flash->sensors[tempPos][SENSOR_ID_SIZE] = op->packet.body.status.sensorType;
+                  op->flash->update();
+               }
+               if (op->packet.body.status.eventCount != 0) opEventsReport(op, tempPos);
+               if (op->packet.hdr.flags & PACKET_FLAG_CHANNELS) opChanDecode(op);
+               if (op->packet.hdr.flags & PACKET_FLAG_CONFIG) opConfigAcked(op);
             }
             
-            //op->setState(op, OPERATION_MACHINE_STATE_RECEIVE_ACK);
-            op->state = OPERATION_MACHINE_STATE_RECEIVE_ACK; // para nao mexer no timeout
+            if ((packetType == PACKET_TYPE_STATUS) && (op->packet.hdr.flags & PACKET_FLAG_SLOTTED) && ED_ADDR_VALID(op->packet.hdr.src))
+            { // relatorio no slot: vai no ACK em grupo do proximo beacon, o AP continua ouvindo
+               i = op->packet.hdr.src - RADIO_ADDR_ED_FIRST;
+               op->ackMap[i >> 3] |= 1 << (i & 0x07);
+            }
+            else
+            {
+               //op->setState(op, OPERATION_MACHINE_STATE_RECEIVE_ACK);
+               op->state = OPERATION_MACHINE_STATE_RECEIVE_ACK; // para nao mexer no timeout
+            }
          }
          else if (op->timer >= op->timeout)
          {
@@ -395,6 +687,14 @@ void opRun        (void * pOp)
             op->serial->transmit(op->serial, ">\r");
             op->setTimeout(op, timeoutList[op->commTimeout]);
             
+            // fim do anuncio do novo perfil: passa a usar (o setPhy e feito no inicio do opRun)
+            if ((op->phyPending != PHY_NONE) && (++op->phyAnnounce >= PHY_ANNOUNCE_PERIODS))
+            {
+               op->flash->phy = op->phyPending;
+               op->flash->update();
+               op->phyPending = PHY_NONE;
+            }
+            
             if(op->earlyMessage == 0)
             {
               for (i = 0; i < op->sensorsFound; i++)
@@ -414,36 +714,38 @@ void opRun        (void * pOp)
          }
          break;
       case OPERATION_MACHINE_STATE_RECEIVE_ACK:
-         //embaralha a mensagem antes de enviar
-         op->tempBuff[0 ] = sizeof(discoveryAckPkg) - 1; // tamanho do payload
-         op->tempBuff[1 ] = 0x00;                     // endereco do ED
-         op->tempBuff[2 ] = SCRAMBLER_SEED1;          // semente do scrambler
-         op->tempBuff[3 ] = SCRAMBLER_SEED2;          // semente do scrambler
-         op->tempBuff[4 ] = SCRAMBLER_SEED3;          // semente do scrambler
-         statusAckPkg[9 ] = op->message[4];    // ID do sensor
-         statusAckPkg[10] = op->message[5];    // ID do sensor
-         statusAckPkg[11] = op->message[6];    // ID do sensor
-         statusAckPkg[12] = op->message[7];    // ID do sensor
-         statusAckPkg[13] = op->message[8];    // ID do sensor
+         if (op->radio->txState != RADIO_TX_STATE_IDLE) break; // espera o radio terminar a transmissao anterior
          
-         scrambler (&(statusAckPkg[5]), &(op->tempBuff[5]), sizeof(statusAckPkg) - 5, &(op->tempBuff[2]));
+         {
+            PACKET tx;
+            unsigned char flags = 0;
+            
+            // sem a base dos deltas do sensor: pede os valores absolutos dos canais
+            if (ED_ADDR_VALID(op->ackAddress) && (op->edChanSync & (1ul << (op->ackAddress - RADIO_ADDR_ED_FIRST))))
+            {
+               flags = PACKET_FLAG_CHANNELS;
+            }
+            opConfigFill(op, &(tx.body.sack), &flags);
+            packetSetHeader(&tx, PACKET_TYPE_SACK, flags, ++op->seq, op->ackAddress, RADIO_ADDR_AP);
+            tx.body.sack.ackSeq = op->packet.hdr.seq;
+            tx.body.sack.rssi = op->radio->rxLink.rssi; // o sensor ajusta a sua potencia por este valor
+            tx.body.sack.phy = (op->phyPending != PHY_NONE) ? op->phyPending : op->flash->phy;
+            op->tempLen = packetBuild(&tx, op->tempBuff);
+         }
          
-         op->radio->transmit(op->radio, op->tempBuff, sizeof(discoveryAckPkg));
-         op->radio->receiveOn(op->radio);
+         // transmite sem bloquear e volta para a recepcao quando terminar
+         op->radio->transmitStart(op->radio, op->tempBuff, op->tempLen, 1);
          
          //op->setState(op, OPERATION_MACHINE_STATE_RECEIVE_WAIT);
          op->state = OPERATION_MACHINE_STATE_RECEIVE_WAIT; // para nao mexer no timeout
          
          break;
       case OPERATION_MACHINE_STATE_INVENTORY_WAIT:
-         op->radio->isr();
-      
          if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            if ((op->tempBuff[0] - 6) > 14) op->tempBuff[0] = 20; // so processa mensagens de ate 20 caracteres
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0] - 6, &(op->tempBuff[2]));
-            op->message[4] = 0;
-            op->serial->transmit(op->serial, "(%I)\r", &(op->message[0]));
+            if (!op->radio->rxLink.crcOk) break; // descarta pacotes corrompidos
+            if (packetParse(op->tempBuff, op->tempLen, &(op->packet)) != PACKET_TYPE_DISC) break;
+            op->serial->transmit(op->serial, "(%I)\r", op->packet.body.disc.id);
          }
          else if (op->timer >= op->timeout)
          {
@@ -451,15 +753,11 @@ void opRun        (void * pOp)
          }
          break;
       case OPERATION_MACHINE_STATE_DEBUG:
-         op->radio->isr();
-      
          if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0], &(op->tempBuff[2]));
-            op->message[op->tempBuff[0]-1] = 0;
-            op->serial->transmit(op->serial, "\r DEBUG DATA: %s\r", op->message[2]);
-            op->tempBuff[op->tempBuff[0]-1] = 0;
-            op->serial->transmit(op->serial, "%s", &(op->tempBuff[2]));
+            op->serial->transmit(op->serial, "\r DEBUG TYPE: %d SEQ: %d SRC: %d LEN: %d\r", packetParse(op->tempBuff, op->tempLen, &(op->packet)),
+                                 op->packet.hdr.seq, op->packet.hdr.src, op->tempLen);
+            op->serial->transmit(op->serial, "\r RSSI: %d LQI: %d CRC: %c\r", op->radio->rxLink.rssi, op->radio->rxLink.lqi, op->radio->rxLink.crcOk + '0');
          }
          break;
    }
@@ -488,6 +786,7 @@ void opIncTimer   (void * pOp)
    ++op->timer;
    ++op->serial->timeoutSerial;
    ++op->radio->timer;
+   ++op->radio->ticks;
    op->wdtControl = 1;
 }
 
@@ -531,8 +830,20 @@ SENSOR_WRITE_STATUS opSensorWrite(void * pOp, unsigned char * sensorID, unsigned
       {
          op->flash->sensors[sensorCount][j] = sensorID[j];
       }
-      op->flash->sensors[sensorCount][SENSOR_ID_SIZE] = 0x30;
+      op->flash->sensors[sensorCount][SENSOR_ID_SIZE] = 0x30;   // tipo padrao ate o primeiro STATUS
+      op->flash->sensors[sensorCount][SENSOR_ADDR_POS] = opSensorFreeAddr(op);
+      // o endereco pode ter sido de um sensor apagado: comeca sem zona e aceita qualquer epoca
+      if (ED_ADDR_VALID(op->flash->sensors[sensorCount][SENSOR_ADDR_POS]))
+      {
+         op->flash->zones[op->flash->sensors[sensorCount][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST] = 0;
+         op->flash->edEpochs[op->flash->sensors[sensorCount][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST] = 0;
+      }
       op->flash->update();
+      // o endereco pode ter sido de um sensor apagado: o contador e as sequencias recomecam
+      if (ED_ADDR_VALID(op->flash->sensors[sensorCount][SENSOR_ADDR_POS]))
+      {
+         opSeqReset(op, op->flash->sensors[sensorCount][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST);
+      }
       return SENSOR_WRITE_STATUS_OK;
    }
    else
@@ -564,12 +875,12 @@ SENSOR_ERASE_STATUS opSensorErase(void * pOp, unsigned char * sensorID, unsigned
          if (sensorLen == SENSOR_ID_SIZE)
          {
             unsigned char * tempPtr = &(op->flash->sensors[sensorCount][0]);
-            while (tempPtr < ((&(op->flash->sensors[SENSOR_LIST_SIZE][0])) - 1 - SENSOR_ID_SIZE - SENSOR_TYPE_SIZE))
+            while (tempPtr < ((&(op->flash->sensors[SENSOR_LIST_SIZE][0])) - SENSOR_ENTRY_SIZE))
             {
-               *tempPtr = *(tempPtr + SENSOR_ID_SIZE + SENSOR_TYPE_SIZE);
+               *tempPtr = *(tempPtr + SENSOR_ENTRY_SIZE);
                ++tempPtr;
             }
-            for (unsigned char j = 0; j < (SENSOR_ID_SIZE + SENSOR_TYPE_SIZE); j++)
+            for (unsigned char j = 0; j < SENSOR_ENTRY_SIZE; j++)
             {
                *tempPtr = 0xFF;
                ++tempPtr;
@@ -637,6 +948,362 @@ unsigned char opSensorGetCount (void * pOp)
    return (char)sensorCount;
 }
 
+/*! \brief Retorna o menor endereco de radio que nenhum sensor da lista esta usando. */
+unsigned char opSensorFreeAddr (OPERATION_MACHINE * op)
+{
+   unsigned char addr = RADIO_ADDR_ED_FIRST;
+   unsigned char i = 0;
+   
+   while ((i < SENSOR_LIST_SIZE) && (op->flash->sensors[i][SENSOR_ID_SIZE] != 0xFF))
+   {
+      if (op->flash->sensors[i][SENSOR_ADDR_POS] == addr)
+      { // endereco em uso, tenta o proximo desde o inicio da lista
+         ++addr;
+         i = 0;
+      }
+      else
+      {
+         ++i;
+      }
+   }
+   return addr;
+}
+
+/*! \brief Transmite o beacon de TDMA sem bloquear: relogio, slots e o ACK em grupo dos
+ *   STATUS recebidos nos slots desde o beacon anterior. O slot de cada sensor e o do seu
+ *   endereco; o tamanho do slot acompanha o perfil de camada fisica. Os sensores com algo
+ *   que so vai no SACK vao no pendMap; se o pendMap nao cabe no quadro, o STATUS no slot deles
+ *   fica sem ACK em grupo e o sensor repete fora do slot, esperando o SACK. Vai com o preambulo
+ *   normal, menos um a cada TDMA_RESYNC_BEACONS.
+ */
+void opBeaconSend (OPERATION_MACHINE * op)
+{
+   PACKET tx;
+   unsigned char slots = 0;
+   unsigned char flags = 0;
+   
+   // com o preambulo do WOR o pacote so vai ao ar depois dele: o relogio do beacon (e a hora do
+   // proximo) e o do pacote, que e a referencia dos EDs para a janela e os slots
+   op->beaconTick = op->radio->ticks + TDMA_BEACON_LEAD(op);
+   
+   for (unsigned char j = 0; j < (PACKET_SLOT_COUNT / 8); j++)
+   {
+      tx.body.beacon.pendMap[j] = 0;
+   }
+   for (unsigned char j = 0; (j < SENSOR_LIST_SIZE) && (j < PACKET_SLOT_COUNT); j++)
+   {
+      if (opDownlinkPending(op, j))
+      {
+         tx.body.beacon.pendMap[j >> 3] |= 1 << (j & 0x07);
+         flags = PACKET_FLAG_CONFIG;
+      }
+   }
+   if ((signed short)PACKET_SIZE(PACKET_BEACON) > AP_FRAME_MAX(op->radio->phy))
+   {
+      flags = 0;
+   }
+   
+   packetSetHeader(&tx, PACKET_TYPE_BEACON, flags, ++op->seq, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   tx.body.beacon.time = (unsigned short)op->beaconTick;
+   tx.body.beacon.period = TDMA_PERIOD / 10;
+   tx.body.beacon.slotLen = (unsigned char)(((op->radio->airtime(op->radio, PACKET_FRAME_SIZE(PACKET_STATUS_BASE_SIZE)) +
+                                              op->radio->airtime(op->radio, PACKET_FRAME_SIZE(PACKET_SACK_CONFIG_SIZE(PACKET_CONFIG_COUNT)))) / 10000) + TDMA_SLOT_GUARD);
+   for (unsigned char j = 0; j < op->sensorsFound; j++)
+   {
+      if (ED_ADDR_VALID(op->flash->sensors[j][SENSOR_ADDR_POS]) && ((op->flash->sensors[j][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST) >= slots))
+      {
+         slots = op->flash->sensors[j][SENSOR_ADDR_POS] - RADIO_ADDR_ED_FIRST + 1;
+      }
+   }
+   tx.body.beacon.slots = slots;
+   tx.body.beacon.phy = (op->phyPending != PHY_NONE) ? op->phyPending : op->flash->phy;
+   for (unsigned char j = 0; j < (PACKET_SLOT_COUNT / 8); j++)
+   {
+      tx.body.beacon.ackMap[j] = (flags & PACKET_FLAG_CONFIG) ? op->ackMap[j] : (op->ackMap[j] & ~tx.body.beacon.pendMap[j]);
+      op->ackMap[j] = 0;
+   }
+   op->tempLen = packetBuild(&tx, op->tempBuff);
+   
+   if (op->beaconCount == 0)
+   { // para os EDs em WOR sem sincronia (recem pareados, reiniciados ou que perderam beacons)
+      op->radio->transmitWakeup(op->radio, op->tempBuff, op->tempLen, WOR_PREAMBLE_MS, 1);
+   }
+   else
+   {
+      op->radio->transmitStart(op->radio, op->tempBuff, op->tempLen, 1);
+   }
+   if (++op->beaconCount >= TDMA_RESYNC_BEACONS)
+   {
+      op->beaconCount = 0;
+   }
+}
+
+/*! \brief O endereco idx tem algo que so vai no SACK: comandos de configuracao (se cabem no
+ *   SACK do perfil em uso) ou o pedido dos valores absolutos dos canais.
+ *   \return 1 se o proximo STATUS do sensor deve esperar o SACK
+ */
+char opDownlinkPending (OPERATION_MACHINE * op, unsigned char idx)
+{
+   if (op->edChanSync & (1ul << idx))
+   {
+      return 1;
+   }
+   return (op->edConfigPending[idx] != 0) &&
+          ((signed short)PACKET_FRAME_SIZE(PACKET_SACK_CONFIG_SIZE(1)) <= AP_FRAME_MAX(op->radio->phy));
+}
+
+/*! \brief Confere a sequencia de um STATUS na janela de duplicatas do endereco idx e atualiza
+ *   as contagens de perdas e duplicatas. So uma retransmissao (PACKET_FLAG_RETRY) pode ser
+ *   duplicata; um STATUS novo com sequencia antiga e de um ED que reiniciou e recomeca a janela.
+ *   \return 1 se o STATUS ja tinha sido recebido
+ */
+char opSeqCheck (OPERATION_MACHINE * op, unsigned char idx, unsigned char seq, unsigned char flags)
+{
+   unsigned char ahead = seq - op->edSeq[idx];
+   unsigned char behind = op->edSeq[idx] - seq;
+   
+   if ((op->edSeqMap[idx] != 0) && (flags & PACKET_FLAG_RETRY) && (behind < 8))
+   {
+      if (op->edSeqMap[idx] & (1 << behind))
+      {
+         ++op->edDup[idx];
+         return 1;
+      }
+      // atrasado, tinha sido contado como perdido
+      op->edSeqMap[idx] |= 1 << behind;
+      if (op->edLost[idx] != 0) --op->edLost[idx];
+      return 0;
+   }
+   if ((op->edSeqMap[idx] != 0) && (ahead != 0) && (ahead < 0x80))
+   { // mais novo: as sequencias puladas nunca chegaram
+      op->edLost[idx] += ahead - 1;
+      op->edSeqMap[idx] = (ahead < 8) ? (op->edSeqMap[idx] << ahead) : 0;
+   }
+   else
+   { // primeiro STATUS ou ED reiniciado
+      op->edSeqMap[idx] = 0;
+   }
+   op->edSeqMap[idx] |= 1;
+   op->edSeq[idx] = seq;
+   return 0;
+}
+
+/*! \brief Grava a epoca do contador aceito do endereco idx quando muda (uma vez por boot do ED
+ *   ou do AP, veja apCounterFresh no ED): e o limite para os pacotes desse ED depois de um boot do AP.
+ */
+void opEpochAccepted (OPERATION_MACHINE * op, unsigned char idx)
+{
+   unsigned short epoch = (unsigned short)(op->edCounter[idx] >> 16);
+   
+   if (epoch != op->flash->edEpochs[idx])
+   {
+      op->flash->edEpochs[idx] = epoch;
+      op->flash->update();
+   }
+}
+
+/*! \brief Recomeca o contador de quadros, a janela de duplicatas, as contagens e a potencia do endereco idx. */
+void opSeqReset (OPERATION_MACHINE * op, unsigned char idx)
+{
+   op->edCounter[idx] = 0;
+   op->edSeq[idx] = 0;
+   op->edSeqMap[idx] = 0;
+   op->edLost[idx] = 0;
+   op->edDup[idx] = 0;
+   op->edEventNext[idx] = 0;
+   op->edEventSync &= ~(1ul << idx);
+   op->edChanValid[idx] = 0;
+   op->edChanSync &= ~(1ul << idx);
+   op->edConfigPending[idx] = 0;
+   op->edConfigSent[idx] = 0;
+   op->edConfigSeq[idx] = 0;
+   op->edPaLevel[idx] = RADIO_PA_LEVEL_MAX;
+   op->edPaAvg[idx] = RADIO_PA_LEVEL_MAX << 4;
+}
+
+/*! \brief Limita um nivel de potencia a tabela RADIO_PA_DBM.
+ *   \return o nivel, ou RADIO_PA_LEVEL_MAX se estiver fora da tabela
+ */
+unsigned char opPaClamp (unsigned short level)
+{
+   return (level < RADIO_PA_LEVELS) ? (unsigned char)level : RADIO_PA_LEVEL_MAX;
+}
+
+/*! \brief Le o tipo (I intervalo em s, P potencia maxima, C canal, Z zona) e o valor com 4
+ *   digitos decimais de um comando de configuracao da serial.
+ *   \return 1 se o tipo e o valor sao validos
+ */
+char opConfigParse (const unsigned char * text, PACKET_CONFIG * type, unsigned short * value)
+{
+   unsigned short valueMax;
+   
+   switch (text[0])
+   {
+      case 'I':
+         *type = PACKET_CONFIG_INTERVAL;
+         valueMax = CONFIG_INTERVAL_MAX;
+         break;
+      case 'P':
+         *type = PACKET_CONFIG_PA_MAX;
+         valueMax = RADIO_PA_LEVEL_MAX;
+         break;
+      case 'C':
+         *type = PACKET_CONFIG_CHANNEL;
+         valueMax = OPERATION_MACHINE_MAX_CHANNELS - 1;
+         break;
+      case 'Z':
+         *type = PACKET_CONFIG_ZONE;
+         valueMax = PACKET_GROUP_ZONE_MAX;
+         break;
+      default:
+         return 0;
+   }
+   *value = 0;
+   for (unsigned char j = 1; j < 5; j++)
+   {
+      if ((text[j] < '0') || (text[j] > '9')) return 0;
+      *value = (*value * 10) + (text[j] - '0');
+   }
+   return *value <= valueMax;
+}
+
+/*! \brief Coloca um comando de configuracao na fila do endereco idx. Um comando novo do mesmo
+ *   tipo substitui o anterior, e o lote ganha uma sequencia nova para que a confirmacao de um
+ *   lote antigo nao o tire da fila.
+ */
+void opConfigSet (OPERATION_MACHINE * op, unsigned char idx, PACKET_CONFIG type, unsigned short value)
+{
+   op->edConfig[idx][type] = value;
+   op->edConfigPending[idx] |= 1 << type;
+   op->edConfigSent[idx] &= ~(1 << type);
+   ++op->edConfigSeq[idx];
+}
+
+/*! \brief Poe no SACK os comandos pendentes do sensor que vai receber (os que couberem no
+ *   pacote do perfil em uso; com FEC e PACKET_SECURITY nenhum).
+ */
+void opConfigFill (OPERATION_MACHINE * op, PACKET_SACK * sack, unsigned char * flags)
+{
+   unsigned char idx;
+   signed short room;
+   
+   sack->configCount = 0;
+   if (!ED_ADDR_VALID(op->ackAddress)) return;
+   idx = op->ackAddress - RADIO_ADDR_ED_FIRST;
+   if (op->edConfigPending[idx] == 0) return;
+   
+   room = (AP_FRAME_MAX(op->radio->phy) - (signed short)PACKET_FRAME_SIZE(PACKET_SACK_CONFIG_SIZE(0))) / (signed short)sizeof(PACKET_CONFIG_ITEM);
+   op->edConfigSent[idx] = 0;
+   for (unsigned char type = 0; (type < PACKET_CONFIG_COUNT) && (sack->configCount < room); type++)
+   {
+      if (!(op->edConfigPending[idx] & (1 << type))) continue;
+      sack->config[sack->configCount].type = type;
+      sack->config[sack->configCount].value[0] = (unsigned char)(op->edConfig[idx][type] >> 8);
+      sack->config[sack->configCount].value[1] = (unsigned char)op->edConfig[idx][type];
+      ++sack->configCount;
+      op->edConfigSent[idx] |= 1 << type;
+   }
+   if (sack->configCount != 0)
+   {
+      sack->configSeq = op->edConfigSeq[idx];
+      *flags |= PACKET_FLAG_CONFIG;
+   }
+}
+
+/*! \brief O STATUS recebido confirma um lote de comandos: tira da fila os enviados com essa
+ *   sequencia. Se sobrou comando (nao coube no SACK), o proximo lote ganha sequencia nova.
+ */
+void opConfigAcked (OPERATION_MACHINE * op)
+{
+   unsigned char idx;
+   
+   if (!ED_ADDR_VALID(op->packet.hdr.src)) return;
+   idx = op->packet.hdr.src - RADIO_ADDR_ED_FIRST;
+   
+   if ((op->packet.body.status.configAck != op->edConfigSeq[idx]) || (op->edConfigSent[idx] == 0)) return;
+   // a zona confirmada define os grupos de zona que o AP conhece (gravada, vale depois de um reset)
+   if ((op->edConfigSent[idx] & (1 << PACKET_CONFIG_ZONE)) && (op->flash->zones[idx] != op->edConfig[idx][PACKET_CONFIG_ZONE]))
+   {
+      op->flash->zones[idx] = (unsigned char)op->edConfig[idx][PACKET_CONFIG_ZONE];
+      op->flash->update();
+   }
+   op->edConfigPending[idx] &= ~op->edConfigSent[idx];
+   op->edConfigSent[idx] = 0;
+   if (op->edConfigPending[idx] != 0) ++op->edConfigSeq[idx];
+}
+
+/*! \brief Aplica os registros de canais do STATUS recebido aos valores do endereco de origem.
+ *   Um delta sem a base (AP reiniciado ou sensor re-pareado) e descartado e o SACK pede os
+ *   valores absolutos; um STATUS so com valores absolutos refaz a base.
+ */
+void opChanDecode (OPERATION_MACHINE * op)
+{
+   unsigned char idx;
+   unsigned char pos = 0;
+   PACKET_CHAN chan;
+   char delta;
+   char deltas = 0;
+   signed short value;
+   
+   if (!ED_ADDR_VALID(op->packet.hdr.src)) return;
+   idx = op->packet.hdr.src - RADIO_ADDR_ED_FIRST;
+   
+   while (packetChanGet(&(op->packet.body.status), &pos, &chan, &delta, &value))
+   {
+      if (chan >= PACKET_CHAN_COUNT) continue; // canal de uma versao mais nova
+      if (!delta)
+      {
+         op->edChan[idx][chan] = value;
+         op->edChanValid[idx] |= 1 << chan;
+         continue;
+      }
+      deltas = 1;
+      if (op->edChanValid[idx] & (1 << chan))
+      {
+         op->edChan[idx][chan] += value;
+      }
+      else
+      {
+         op->edChanSync |= 1ul << idx;
+      }
+   }
+   if (!deltas)
+   {
+      op->edChanSync &= ~(1ul << idx);
+   }
+}
+
+/*! \brief Informa na serial os eventos do STATUS recebido que ainda nao foram informados, no
+ *   formato (ID:valor,idade em s). Os eventos repetidos (SACK perdido) sao pulados pela sequencia.
+ */
+void opEventsReport (OPERATION_MACHINE * op, signed char pos)
+{
+   unsigned char idx;
+   unsigned char seq;
+   
+   if (!ED_ADDR_VALID(op->packet.hdr.src)) return;
+   idx = op->packet.hdr.src - RADIO_ADDR_ED_FIRST;
+   
+   for (unsigned char i = 0; i < op->packet.body.status.eventCount; i++)
+   {
+      PACKET_EVENT * event = &(op->packet.body.status.events[i]);
+      
+      seq = op->packet.body.status.eventSeq + i;
+      // ja informado: a sequencia esta atras do proximo esperado
+      if ((op->edEventSync & (1ul << idx)) && ((unsigned char)(seq - op->edEventNext[idx]) >= 0x80)) continue;
+      op->serial->transmit(op->serial, "(%I:%c,%d)\r", &(op->flash->sensors[pos]), event->value,
+                           (int)(((unsigned short)event->age[0] << 8) | event->age[1]));
+      op->edEventNext[idx] = seq + 1;
+      op->edEventSync |= 1ul << idx;
+   }
+}
+
+/*! \brief Grava na flash a epoca do contador de quadros (chamada pelo packet.c). */
+void opEpochSave (unsigned short epoch)
+{
+   operationMachine.flash->epoch = epoch;
+   operationMachine.flash->update();
+}
 
 // Timer1 A0 interrupt service routine
 #pragma vector=TIMER1_A0_VECTOR
@@ -5,6 +5,7 @@
 #include "serial.h"
 #include "radio.h"
 #include "flashParam.h"
+#include "packet.h"
 
 typedef enum
 {
@@ -61,15 +62,40 @@ typedef struct OPERATION_MACHINE_STRUCT
    RADIO *                    radio;
    unsigned char              tempBuff[256];
    unsigned char              tempLen;
-   unsigned char              message[32];
+   PACKET                     packet;        // ultimo pacote recebido
+   unsigned char              seq;           // sequencia dos pacotes transmitidos pelo AP
+   unsigned long              edCounter[SENSOR_LIST_SIZE];  // ultimo contador de quadros aceito de cada endereco de ED
+   unsigned char              edSeq[SENSOR_LIST_SIZE];      // ultima sequencia de STATUS de cada endereco de ED
+   unsigned char              edSeqMap[SENSOR_LIST_SIZE];   // janela de duplicatas: bit n = sequencia edSeq - n recebida
+   unsigned short             edLost[SENSOR_LIST_SIZE];     // STATUS que nunca chegaram (sequencias puladas)
+   unsigned short             edDup[SENSOR_LIST_SIZE];      // STATUS repetidos (retransmissoes depois de um SACK perdido)
+   unsigned char              edEventNext[SENSOR_LIST_SIZE]; // proximo evento ainda nao informado na serial
+   unsigned long              edEventSync;                  // bit n: edEventNext do endereco n ja valido
+   signed short               edChan[SENSOR_LIST_SIZE][PACKET_CHAN_COUNT]; // canais de cada endereco de ED (base dos deltas)
+   unsigned char              edChanValid[SENSOR_LIST_SIZE]; // bit n: canal n conhecido
+   unsigned long              edChanSync;                   // bit n: pedir os valores absolutos ao endereco n no SACK
+   unsigned short             edConfig[SENSOR_LIST_SIZE][PACKET_CONFIG_COUNT]; // valor de cada comando de configuracao
+   unsigned char              edConfigPending[SENSOR_LIST_SIZE]; // bit n: comando n ainda nao confirmado pelo ED
+   unsigned char              edConfigSent[SENSOR_LIST_SIZE];    // comandos do ultimo SACK enviado com edConfigSeq
+   unsigned char              edConfigSeq[SENSOR_LIST_SIZE];     // lote de comandos em envio
+   unsigned char              edPaLevel[SENSOR_LIST_SIZE];  // nivel de potencia informado por cada endereco de ED
+   unsigned short             edPaAvg[SENSOR_LIST_SIZE];    // media do nivel de potencia (x16)
    
    unsigned char              sensorsFound;
    
    SENSOR_COMM_STATUS         sensorStatus[SENSOR_LIST_SIZE+1];
    unsigned char              sensorValue[SENSOR_LIST_SIZE][4];
    unsigned char              sensorType[SENSOR_LIST_SIZE];
+   signed char                sensorRssi[SENSOR_LIST_SIZE];  // RSSI (dBm) do ultimo pacote de cada sensor
+   unsigned char              sensorLqi[SENSOR_LIST_SIZE];   // LQI do ultimo pacote de cada sensor
    
    unsigned char              commTimeout;
+   unsigned char              ackAddress;    // endereco do sensor que vai receber o SACK
+   unsigned char              phyPending;    // perfil de camada fisica anunciado aos sensores (0xFF = nenhum)
+   unsigned char              phyAnnounce;   // periodos de recepcao desde o inicio do anuncio
+   unsigned long              beaconTick;    // ticks do ultimo beacon de TDMA
+   unsigned char              beaconCount;   // beacons desde o ultimo com o preambulo do WOR
+   unsigned char              ackMap[PACKET_SLOT_COUNT / 8]; // STATUS no slot a confirmar no proximo beacon
 
    SERIAL *                   serial;
    FLASH_PARAM *              flash;
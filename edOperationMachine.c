@@ -4,28 +4,20 @@
 
 #include "edOperationMachine.h"
 #include "cc430x513x.h"
-#include "scrambler.h"
 #include "watchdog.h"
 
 unsigned char testPkg[] = {0x06, 0x00, 'T','E','S','T','E'};
-unsigned char discoveryPkg[] = {  14 ,                  // tamanho do pacote
-                                 0x00,                  // endereco do AP
-                                 0x00, 0x00, 0x00,      // semente do scrambler
-                                 'D','I','S','C',       // payload
-                                 0x30, 0x30, 0x30, 0x30,// ID do sensor
-                                 0x30,                  // tipo do sensor
-                                 0x46                   // checksum
-                               };
-unsigned char statusPkg[] =    { 12 ,                   // tamanho do pacote
-                                0x00,                   // endereco do AP
-                                0x00, 0x00, 0x00,       // semente do scrambler
-                                0x30, 0x30, 0x30, 0x30, // ID do sensor
-                                0x30,                   // tipo do sensor
-                                'F', 'F',               // valor do sensor
-                                0x46                    // checksum
-                               };
+// identificacao deste sensor
+unsigned char edSensorId[PACKET_ID_SIZE] = {0x30, 0x30, 0x30, 0x30};
+#define ED_SENSOR_TYPE 0x30
+// valor informado no STATUS ('0','0' enquanto o alarme nao for confirmado pelo AP)
+unsigned char edSensorValue[2] = {'F', 'F'};
 //unsigned char tempBuff[15];
 
+// CSMA dos relatorios de status: espera inicial aleatoria e janela longa, para que os EDs
+// que acordam juntos (ex.: depois de uma queda de energia) nao colidam sempre
+const RADIO_CSMA_CONFIG edCsma = {2, 6, 5, 320, 0};
+
 #define BT_CFG_PORT 0
 #define BT_CFG_BIT  1
 
@@ -47,7 +39,56 @@ unsigned char statusPkg[] =    { 12 ,                   // tamanho do pacote
 #define TIMEOUT_16S   (TIMEOUT_01S * 16)
 
 #define OPERATION_MACHINE_MAX_TIMEOUT 5
+
+// escuta em Wake-on-Radio enquanto dorme: ~1s de periodo, rx por 0,45% do periodo
+// (3,6% em 1,2 kbps, para caber a deteccao do preambulo e do sync word)
+#define ED_WOR_EVENT0  0x876B
+const unsigned char edWorRxTime[RADIO_PHY_COUNT] = {3, 3, 0, 3};
+
+// tamanho dos ACKs do AP (tamanho + payload), para esperar pelo tempo no ar de cada perfil
+#define ED_DACK_SIZE PACKET_SIZE(PACKET_DACK)
+#define ED_SACK_SIZE PACKET_SIZE(PACKET_SACK)
+// SACKs perdidos seguidos ate tentar o proximo perfil de camada fisica (o AP pode ter mudado)
+#define ED_PHY_FALLBACK_MISSES 4
 #define OPERATION_MACHINE_MAX_CHANNELS 8
+// com um canal pedido pelo AP: ACKs perdidos seguidos ate passar para o outro canal (o novo, se
+// o AP ja mudou, ou de volta ao anterior); o canal so vai para a flash com um ACK no canal novo
+#define ED_CHANNEL_MISSES 2
+#define ED_CHANNEL_NONE   0xFF
+
+// controle de potencia: RSSI desejado no AP (~20 dB acima da sensibilidade em 250 kbps) e a
+// faixa em que o nivel nao muda (maior que o maior passo do PATABLE, para nao oscilar)
+#define ED_RSSI_TARGET -75
+#define ED_RSSI_HYST   6
+
+// sincronizado com os beacons, o timer de sono so acorda o sensor se ED_TDMA_MISSES beacons
+// seguidos forem perdidos (o relatorio vai fora do slot e o sensor perde a sincronia)
+#define ED_TDMA_MISSES 2
+// o beacon so tem o preambulo do WOR de tempos em tempos: sincronizado, o sensor escuta direto
+// de ED_BEACON_GUARD antes da hora prevista ate ED_BEACON_GUARD + ED_BEACON_LATE depois (o AP
+// atrasa o beacon com o radio ocupado). A hora vem do periodo medido contra o relogio do AP;
+// antes da medida a folga e 1/16 do periodo (REFO: +-3,5%)
+#define ED_BEACON_GUARD   5          // 10 ms
+#define ED_BEACON_LATE    5          // 10 ms
+#define ED_WOR_EVENT0_BEACON 0x00B4  // ~5 ms ate comecar a escutar na janela do beacon
+// ticks de 10 ms para ticks do timer de sono (ACLK / 64)
+#define ED_SLEEP_TICKS(t) (((unsigned long)(t) * TIMEOUT_01S) / 100)
+// avanco do relogio do sensor a cada tick do timer com o sensor acordado
+#define ED_CLOCK_TICK     (TIMEOUT_01S / OP_FREQ)
+// maior pacote que o perfil de camada fisica transmite
+#define ED_FRAME_MAX(phy) (((phy) == RADIO_PHY_38K4_FEC) ? RADIO_FEC_FRAME_LEN : (RADIO_RX_BUFFER_SIZE - 2))
+
+// canais medidos pelo sensor (bit n = PACKET_CHAN n)
+#ifdef ADC_LEVEL_INPUT
+#define ED_CHANNELS     ((1 << PACKET_CHAN_CONTACT) | (1 << PACKET_CHAN_LEVEL) | (1 << PACKET_CHAN_BATTERY) | (1 << PACKET_CHAN_TEMPERATURE))
+#else
+#define ED_CHANNELS     ((1 << PACKET_CHAN_CONTACT) | (1 << PACKET_CHAN_BATTERY) | (1 << PACKET_CHAN_TEMPERATURE))
+#endif
+// STATUS com deltas entre dois envios dos valores absolutos (recupera a base se o AP reiniciar)
+#define ED_CHAN_REFRESH 16
+
+// maior intervalo entre relatorios aceito do AP (s)
+#define ED_INTERVAL_MAX 3600
 
 // prototipos dos metodos do objeto
 void opInit       (void * pOp);
@@ -56,6 +97,25 @@ void opSetState   (void * pOp, OPERATION_MACHINE_STATE state);
 void opSetTimeout (void * pOp, unsigned short timeout);
 void opIncTimer   (void * pOp);
 
+char pollReceived (OPERATION_MACHINE * op);
+void txPowerAdjust (OPERATION_MACHINE * op, signed char rssi);
+void phyFollow (OPERATION_MACHINE * op, unsigned char phy);
+void opEpochSave (unsigned short epoch);
+char apCounterFresh (OPERATION_MACHINE * op, unsigned long counter);
+void tdmaSync (OPERATION_MACHINE * op, PACKET_BEACON * beacon);
+unsigned long tdmaBeaconGuard (OPERATION_MACHINE * op);
+unsigned long tdmaBeaconDelay (OPERATION_MACHINE * op);
+char tdmaBeaconTimer (OPERATION_MACHINE * op);
+void edWorListen (OPERATION_MACHINE * op);
+void eventPush (OPERATION_MACHINE * op, unsigned char value);
+void eventAcked (OPERATION_MACHINE * op);
+void chanMeasure (OPERATION_MACHINE * op);
+void chanBuild (OPERATION_MACHINE * op, PACKET_STATUS * status, signed short room);
+void chanAcked (OPERATION_MACHINE * op, unsigned char flags);
+void configApply (OPERATION_MACHINE * op, PACKET_CONFIG_ITEM * config, unsigned char count);
+void channelAcked (OPERATION_MACHINE * op);
+void channelMissed (OPERATION_MACHINE * op);
+
 __no_init OPERATION_MACHINE operationMachine;// = {opInit};
 
 // implementacao dos metodos
@@ -71,13 +131,53 @@ void opInit       (void * pOp)
    op->led = &led1;
    op->btConfig = &btConfig;
    op->btSense = &btSense;
+   op->adc = &adc;
    op->flash = &flashParam;
    
    op->channel = 0;
    op->timeoutStatus = 0;
+   op->phy = RADIO_PHY_PAIRING;
+   op->ackMisses = 0;
+   op->seq = 0;
+   op->statusSeq = 0;
+   op->statusValue = 0;
+   op->clock = 0;
+   op->pinValue = 'F';
+   op->eventCount = 0;
+   op->eventSeq = 0;
+   op->eventSent = 0;
+   for (unsigned char i = 0; i < PACKET_CHAN_COUNT; i++)
+   {
+      op->chanValue[i] = 0;
+      op->chanSent[i] = 0;
+   }
+   op->chanBaseValid = 0;
+   op->chanPending = 0;
+   op->chanAbsolute = 0;
+   op->chanRefresh = 0;
+   op->paMax = RADIO_PA_LEVEL_MAX;
+   op->configAck = 0;
+   op->configAckPending = 0;
+   op->configAckSent = 0;
+   op->sleepWakes = 1;
+   op->reportClock = 0;
+   op->apCounter = 0;
+   op->tdmaSync = 0;
+   op->tdmaSlotArmed = 0;
+   op->tdmaInSlot = 0;
+   op->tdmaAckPending = 0;
+   op->tdmaDownlink = 0;
+   op->tdmaBeaconTicks = 0;
+   op->tdmaBeaconArmed = 0;
+   op->tdmaBeaconWindow = 0;
+   op->channelNext = ED_CHANNEL_NONE;
+   op->channelMisses = 0;
    
    // inicializa o radio
    op->radio->init(op->radio);
+   op->radio->setCsma(op->radio, &edCsma);
+   // semente do backoff a partir do ID do sensor
+   op->radio->seedRandom(op->radio, (((unsigned short)edSensorId[0] << 8) | edSensorId[1]) ^ (((unsigned short)edSensorId[2] << 8) | edSensorId[3]));
    
    // inicializa os pinos dos botoes
    op->btConfig->init(op->btConfig, BT_CFG_PORT, BT_CFG_BIT);
@@ -86,8 +186,17 @@ void opInit       (void * pOp)
    // inicializa os pinos dos LEDs
    op->led->init(op->led, 0, 4);
    
+   // inicializa o conversor A/D e faz a primeira medida dos canais
+   op->adc->init(op->adc);
+   chanMeasure(op);
+   
    //Inicia os dados da flash
    op->flash->init();
+   op->paMax = op->flash->paMax;
+   
+   // nova epoca do contador de quadros dos pacotes
+   packetSecurityInit(op->flash->epoch, opEpochSave, op->flash->secret);
+   
    if(op->flash->check != 0x55)
    {
        // manda pro estado inicial da maquina
@@ -116,6 +225,7 @@ void opInit       (void * pOp)
 void opRun        (void * pOp)
 {
    BUTTON_PRESS_TYPE tempBtType;
+   unsigned long sleepClock;
    OPERATION_MACHINE * op = (OPERATION_MACHINE *)pOp;
    
    switch(op->state)
@@ -196,6 +306,22 @@ void opRun        (void * pOp)
          break;
       case OPERATION_MACHINE_STATE_TURN_ON_RADIO:
          op->radio->init(op->radio);
+         op->phy = (op->flash->check == 0x55) ? op->flash->phy : RADIO_PHY_PAIRING;
+         op->radio->setPhy(op->radio, (RADIO_PHY)op->phy);
+         op->radio->setChannel(op->radio, op->channel);
+         if (op->flash->check == 0x55)
+         { // pareado: so recebe pacotes da rede do AP e para o seu endereco
+            op->radio->setNetwork(op->radio, op->flash->netId, op->flash->address);
+            packetSetNetwork(op->flash->netId);
+         }
+         else
+         {
+            op->radio->setNetwork(op->radio, RADIO_NETWORK_PAIRING, RADIO_ADDR_BROADCAST);
+            packetSetNetwork(RADIO_NETWORK_PAIRING);
+         }
+         op->ackMisses = 0;
+         op->tdmaInSlot = 0;
+         op->channelNext = ED_CHANNEL_NONE;  // a procura do AP passa por todos os canais
          op->setState(op, OPERATION_MACHINE_STATE_SEARCH_AP_QUERY);
          break;
       case OPERATION_MACHINE_STATE_TURN_OFF_RADIO:
@@ -205,49 +331,63 @@ void opRun        (void * pOp)
       case OPERATION_MACHINE_STATE_SEARCH_AP_QUERY:
          op->led->on(op->led);
          
-         //embaralha a mensagem antes de enviar
-         op->tempBuff[0] = sizeof(discoveryPkg) - 1; // tamanho do payload
-         op->tempBuff[1] = 0x00;                     // endereco do AP
-         op->tempBuff[2] = SCRAMBLER_SEED1;          // semente do scrambler
-         op->tempBuff[3] = SCRAMBLER_SEED2;          // semente do scrambler
-         op->tempBuff[4] = SCRAMBLER_SEED3;          // semente do scrambler
-         
-         scrambler (&(discoveryPkg[5]), &(op->tempBuff[5]), sizeof(discoveryPkg) - 5, &(op->tempBuff[2]));
+         {
+            PACKET tx;
+            
+            packetSetHeader(&tx, PACKET_TYPE_DISC, 0, ++op->seq, RADIO_ADDR_AP, op->radio->address);
+            for (unsigned char i = 0; i < PACKET_ID_SIZE; i++) tx.body.disc.id[i] = edSensorId[i];
+            tx.body.disc.sensorType = ED_SENSOR_TYPE;
+            op->tempLen = packetBuild(&tx, op->tempBuff);
+         }
          
-         op->radio->transmit(op->radio, op->tempBuff, sizeof(discoveryPkg));
+         op->radio->transmit(op->radio, op->tempBuff, op->tempLen);
          op->radio->receiveOn(op->radio);
          
          op->setState(op, OPERATION_MACHINE_STATE_SEARCH_AP_WAIT);
-         op->setTimeout(op, 50);
+         op->setTimeout(op, 50 + (op->radio->airtime(op->radio, ED_DACK_SIZE) / 10000));
          break;
       case OPERATION_MACHINE_STATE_SEARCH_AP_WAIT:
-         op->radio->isr();
          if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            if ((op->tempBuff[0] - 6) > 14) op->tempBuff[0] = 20; // so processa mensagens de ate 20 caracteres
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0] - 6, &(op->tempBuff[2]));
-            if ( (op->message[0] == 'D') &&
-                 (op->message[1] == 'A') &&
-                 (op->message[2] == 'C') &&
-                 (op->message[3] == 'K')   )
+            if (!op->radio->rxLink.crcOk) break; // descarta pacotes corrompidos
+            switch (packetParse(op->tempBuff, op->tempLen, &(op->packet)))
             {
-               op->led->off(op->led);
-               op->setState(op, OPERATION_MACHINE_STATE_SEND_STATUS);
-               op->flash->channel = op->channel;
-               op->flash->check = 0x55;
-               op->flash->update();
-               
-            }
-            
-            if ( (op->message[0] == 'S') &&
-                 (op->message[1] == 'A') &&
-                 (op->message[2] == 'C') &&
-                 (op->message[3] == 'K')   )
-            {
-               op->led->off(op->led);
-               op->setState(op, OPERATION_MACHINE_STATE_SEND_STATUS);
-               //op->flash->update();
-               
+               case PACKET_TYPE_DACK:
+                  if (!packetIdMatch(op->packet.body.dack.id, edSensorId)) break;
+                  
+                  // pode ser outro AP: o contador dele comeca a valer a partir daqui
+                  op->apCounter = op->packet.hdr.counter;
+                  // o DACK traz a rede do AP e o endereco deste sensor
+                  op->led->off(op->led);
+                  op->setState(op, OPERATION_MACHINE_STATE_SEND_STATUS);
+                  op->flash->channel = op->channel;
+                  op->flash->netId = op->packet.body.dack.netId;
+                  op->flash->address = op->packet.body.dack.address;
+                  if (op->flash->netId >= RADIO_NETWORK_COUNT)
+                  { // DACK de um AP sem redes: fica na rede original, so com broadcast
+                     op->flash->netId = RADIO_NETWORK_PAIRING;
+                     op->flash->address = RADIO_ADDR_BROADCAST;
+                  }
+                  op->flash->phy = (op->packet.body.dack.phy < RADIO_PHY_COUNT) ? op->packet.body.dack.phy : RADIO_PHY_PAIRING;
+                  op->flash->check = 0x55;
+                  op->flash->update();
+                  op->radio->setNetwork(op->radio, op->flash->netId, op->flash->address);
+                  packetSetNetwork(op->flash->netId);
+                  op->phy = op->flash->phy;
+                  op->radio->setPhy(op->radio, (RADIO_PHY)op->phy);
+                  break;
+               case PACKET_TYPE_SACK:
+                  // sensor ja pareado: o AP confirmou o DISC
+                  if (op->packet.body.sack.ackSeq != op->seq) break;
+                  if (!apCounterFresh(op, op->packet.hdr.counter)) break;
+                  
+                  op->led->off(op->led);
+                  op->setState(op, OPERATION_MACHINE_STATE_SEND_STATUS);
+                  txPowerAdjust(op, op->packet.body.sack.rssi);
+                  phyFollow(op, op->packet.body.sack.phy);
+                  break;
+               default:
+                  break;
             }
          }
          else if (op->timer >= op->timeout)
@@ -269,50 +409,155 @@ void opRun        (void * pOp)
       case OPERATION_MACHINE_STATE_CHANGE_CHANNEL:
          if (op->timer >= op->timeout)
          {
-            op->setState(op, OPERATION_MACHINE_STATE_TURN_ON_RADIO);
+            // so troca o canal, sem reinicializar o radio
+            op->radio->receiveOff(op->radio);
+            op->radio->setChannel(op->radio, op->channel);
+            op->setState(op, OPERATION_MACHINE_STATE_SEARCH_AP_QUERY);
          }
          
          break;
       case OPERATION_MACHINE_STATE_SEND_STATUS:
-         //embaralha a mensagem antes de enviar
-         op->tempBuff[0] = sizeof(statusPkg) - 1;    // tamanho do payload
-         op->tempBuff[1] = 0x00;                     // endereco do AP
-         op->tempBuff[2] = SCRAMBLER_SEED1;          // semente do scrambler
-         op->tempBuff[3] = SCRAMBLER_SEED2;          // semente do scrambler
-         op->tempBuff[4] = SCRAMBLER_SEED3;          // semente do scrambler
-         
          if (!(op->btSense->getPin(op->btSense)))
          {
-            statusPkg[10] = '0';
-            statusPkg[11] = '0';
+            edSensorValue[0] = '0';
+            edSensorValue[1] = '0';
          }
          
-         scrambler (&(statusPkg[5]), &(op->tempBuff[5]), sizeof(statusPkg) - 5, &(op->tempBuff[2]));
+         // guarda cada mudanca do valor lido, com o horario, ate o AP confirmar
+         {
+            unsigned char pin = (op->btSense->getPin(op->btSense)) ? 'F' : '0';
+            if (pin != op->pinValue)
+            {
+               eventPush(op, pin);
+               op->pinValue = pin;
+            }
+         }
          
-         op->radio->transmit(op->radio, op->tempBuff, sizeof(statusPkg));
+         {
+            PACKET tx;
+            unsigned char flags;
+            signed short events;
+            char chanNew;
+            
+            // canais que mudaram (ou todos, em absoluto) no espaco do pacote; os eventos usam o que sobrar
+            op->chanValue[PACKET_CHAN_CONTACT] = (edSensorValue[0] == '0') ? 1 : 0;
+            chanNew = 0;
+            for (unsigned char i = 0; i < PACKET_CHAN_COUNT; i++)
+            {
+               if (op->chanValue[i] != op->chanSent[i]) chanNew = 1;
+            }
+            chanBuild(op, &(tx.body.status), ED_FRAME_MAX(op->phy) - (signed short)PACKET_FRAME_SIZE(PACKET_STATUS_BASE_SIZE) - op->configAckPending);
+            
+            // eventos que cabem no pacote do perfil em uso (com FEC e PACKET_SECURITY nenhum)
+            events = (ED_FRAME_MAX(op->phy) - (signed short)PACKET_FRAME_SIZE(PACKET_STATUS_EVENTS_SIZE(0)) - tx.body.status.chanLen -
+                      op->configAckPending) / (signed short)sizeof(PACKET_EVENT);
+            if (events > PACKET_EVENTS_MAX) events = PACKET_EVENTS_MAX;
+            if (events > op->eventCount) events = op->eventCount;
+            if (events < 0) events = 0;
+            
+            // no slot, sem alarme, sem eventos, sem canais novos, sem ACK perdido e sem nada do AP para
+            // o SACK, a confirmacao vem no beacon; senao espera o SACK (que tambem traz o RSSI para o
+            // controle de potencia)
+            if (op->tdmaInSlot && (edSensorValue[0] == 'F') && (op->ackMisses == 0) && (op->eventCount == 0) &&
+                (tx.body.status.chanLen == 0) && !op->configAckPending && !op->tdmaDownlink)
+            {
+               flags = PACKET_FLAG_SLOTTED;
+            }
+            else
+            {
+               flags = (op->ackMisses) ? PACKET_FLAG_RETRY : 0;
+               op->tdmaInSlot = 0;
+            }
+            // a retransmissao depois de um ACK perdido repete a sequencia (o AP descarta a duplicata);
+            // um valor novo ou um STATUS depois do ACK ganha sequencia nova
+            if ((op->ackMisses == 0) || (edSensorValue[0] != op->statusValue) || (events != op->eventSent) ||
+                ((tx.body.status.chanLen != 0) && chanNew))
+            {
+               ++op->statusSeq;
+               op->statusValue = edSensorValue[0];
+            }
+            op->eventSent = (unsigned char)events;
+            if (tx.body.status.chanLen != 0)
+            {
+               flags |= PACKET_FLAG_CHANNELS;
+               for (unsigned char i = 0; i < PACKET_CHAN_COUNT; i++) op->chanSent[i] = op->chanValue[i];
+            }
+            // confirma ao AP os comandos de configuracao aplicados
+            op->configAckSent = op->configAckPending;
+            if (op->configAckPending)
+            {
+               flags |= PACKET_FLAG_CONFIG;
+               tx.body.status.configAck = op->configAck;
+            }
+            op->reportClock = op->clock;
+            if (events != 0)
+            {
+               flags |= PACKET_FLAG_EVENTS;
+               tx.body.status.eventSeq = op->eventSeq;
+               tx.body.status.eventCount = (unsigned char)events;
+               for (unsigned char i = 0; i < events; i++)
+               {
+                  unsigned long age = (op->clock - op->eventTime[i]) / TIMEOUT_01S;
+                  if (age > 0x7FFF) age = 0x7FFF;
+                  tx.body.status.events[i].value = op->eventValue[i];
+                  tx.body.status.events[i].age[0] = (unsigned char)(age >> 8);
+                  tx.body.status.events[i].age[1] = (unsigned char)age;
+               }
+            }
+            packetSetHeader(&tx, PACKET_TYPE_STATUS, flags, op->statusSeq, RADIO_ADDR_AP, op->radio->address);
+            for (unsigned char i = 0; i < PACKET_ID_SIZE; i++) tx.body.status.id[i] = edSensorId[i];
+            tx.body.status.sensorType = ED_SENSOR_TYPE;
+            tx.body.status.value[0] = edSensorValue[0];
+            tx.body.status.value[1] = edSensorValue[1];
+            tx.body.status.paLevel = op->radio->paLevel;
+            op->tempLen = packetBuild(&tx, op->tempBuff);
+         }
          
+         op->radio->transmit(op->radio, op->tempBuff, op->tempLen);
+         
+         if (op->tdmaInSlot)
+         { // volta a dormir logo; o proximo beacon confirma
+            // mede os canais como no MEASURE_BATT: um canal que mudou tira o proximo STATUS do slot
+            chanMeasure(op);
+            op->tdmaAckPending = 1;
+            op->timeoutStatus = 4;
+            op->setState(op, OPERATION_MACHINE_STATE_SLEEP);
+            break;
+         }
+         op->tdmaAckPending = 0;
          op->setState(op, OPERATION_MACHINE_STATE_MEASURE_BATT);
          
          op->led->on(op->led);
          break;
       case OPERATION_MACHINE_STATE_MEASURE_BATT:
+         // mede os canais analogicos com a bateria ainda sob a carga da transmissao; vao no proximo STATUS
+         chanMeasure(op);
          op->setState(op, OPERATION_MACHINE_STATE_WAIT_ACK);
          op->radio->receiveOn(op->radio);
-         op->setTimeout(op, 10);
+         op->setTimeout(op, 10 + (op->radio->airtime(op->radio, ED_SACK_SIZE) / 10000));
          break;
       case OPERATION_MACHINE_STATE_WAIT_ACK:
-         op->radio->isr();
          if (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
          {
-            if ((op->tempBuff[0] - 6) > 14) op->tempBuff[0] = 20; // so processa mensagens de ate 20 caracteres
-            descrambler (&(op->tempBuff[5]), op->message, op->tempBuff[0] - 6, &(op->tempBuff[2]));
-            if ( (op->message[0] == 'S') &&
-                 (op->message[1] == 'A') &&
-                 (op->message[2] == 'C') &&
-                 (op->message[3] == 'K')   )
+            if (!op->radio->rxLink.crcOk) break; // descarta pacotes corrompidos
+            if ((packetParse(op->tempBuff, op->tempLen, &(op->packet)) == PACKET_TYPE_SACK) &&
+                (op->packet.body.sack.ackSeq == op->statusSeq) && apCounterFresh(op, op->packet.hdr.counter))
             { // se deu o ack no pacote, pode dormir por mais tempo.
-               statusPkg[10] = 'F';
-               statusPkg[11] = 'F';
+               edSensorValue[0] = 'F';
+               edSensorValue[1] = 'F';
+               channelAcked(op);
+               txPowerAdjust(op, op->packet.body.sack.rssi);
+               phyFollow(op, op->packet.body.sack.phy);
+               eventAcked(op);
+               chanAcked(op, op->packet.hdr.flags);
+               if (op->configAckSent) op->configAckPending = 0;
+               if (op->packet.body.sack.configCount != 0)
+               { // o configSeq volta ao AP no proximo STATUS
+                  configApply(op, op->packet.body.sack.config, op->packet.body.sack.configCount);
+                  op->configAck = op->packet.body.sack.configSeq;
+                  op->configAckPending = 1;
+               }
+               op->ackMisses = 0;
                op->timeoutStatus = 4;
                op->setState(op, OPERATION_MACHINE_STATE_SLEEP);
             }
@@ -320,7 +565,20 @@ void opRun        (void * pOp)
          }
          else if (op->timer >= op->timeout)
          {
-            if (statusPkg[10] == '0')
+            // sem ACK: o enlace pode estar no limite, sobe a potencia
+            if (op->radio->paLevel < op->paMax)
+            {
+               op->radio->setTxPower(op->radio, op->radio->paLevel + 1);
+            }
+            channelMissed(op);
+            // muitos ACKs perdidos: tenta o proximo perfil (so na RAM, a flash muda quando o AP confirmar)
+            if (++op->ackMisses >= ED_PHY_FALLBACK_MISSES)
+            {
+               op->ackMisses = 0;
+               if (++op->phy >= RADIO_PHY_COUNT) op->phy = 0;
+               op->radio->setPhy(op->radio, (RADIO_PHY)op->phy);
+            }
+            if (edSensorValue[0] == '0')
             { // se tem pala, fica tentando transmitir mais rapido
                op->timeoutStatus = 2;
             }
@@ -332,9 +590,9 @@ void opRun        (void * pOp)
          }
          break;
       case OPERATION_MACHINE_STATE_SLEEP:
-         // desliga os perifericos
+         // desliga os perifericos; o radio fica em WOR (mantendo a configuracao) para receber POLLs do AP
          op->radio->receiveOff(op->radio);
-         op->radio->powerOff(op->radio);
+         edWorListen(op);
          op->led->off(op->led);
          
          //configura o timer para acordar o processador no timeout selecionado
@@ -362,6 +620,26 @@ void opRun        (void * pOp)
                
                break;
          }
+         op->sleepWakes = 1;
+         if ((op->timeoutStatus == 4) && (op->flash->interval != 0))
+         { // intervalo configurado pelo AP: acima do periodo do timer, dorme varios estouros (contados na interrupcao)
+            unsigned long sleepTicks = (unsigned long)op->flash->interval * TIMEOUT_01S;
+            op->sleepWakes = (unsigned short)((sleepTicks + 0xFFFF) >> 16);
+            TA1CCR0 = (unsigned short)((sleepTicks / op->sleepWakes) - 1);
+         }
+         if (op->tdmaSync && (op->timeoutStatus == 4))
+         { // acorda na janela do proximo beacon, que reprograma o timer para o slot deste sensor;
+           // com a janela ja passada espera um beacon com o preambulo do WOR
+            unsigned long sleepTicks = tdmaBeaconDelay(op);
+            op->tdmaBeaconArmed = (sleepTicks != 0);
+            if (!op->tdmaBeaconArmed)
+            {
+               sleepTicks = ED_SLEEP_TICKS((unsigned long)op->tdmaPeriod * ED_TDMA_MISSES);
+            }
+            TA1CCR0 = (sleepTicks > 0xFFFF) ? 0xFFFF : (unsigned short)sleepTicks;
+            op->sleepWakes = 1;
+         }
+         op->tdmaSlotArmed = 0;
          TA1CTL = TASSEL_1 + MC_1 + TACLR + ID_3;  // SMCLK, upmode, pre-scaler /8, clear TAR
          
          // configura a interrupcao do pino para acordar o processador
@@ -371,8 +649,38 @@ void opRun        (void * pOp)
          wdtStop();
          
          // vai dormir
-         __bis_SR_register(LPM3_bits);             // Enter LPM3
-         __no_operation();                         // For debugger
+         sleepClock = op->clock;
+         while(1)
+         {
+            op->sleepTimeout = 0;
+            __bis_SR_register(LPM3_bits);             // Enter LPM3
+            __no_operation();                         // For debugger
+            
+            if (!op->radio->worWake)
+            { // acordou pelo timer ou pelo botao (o timer pode so abrir ou fechar a janela do beacon)
+               if (op->sleepTimeout && tdmaBeaconTimer(op)) continue;
+               break;
+            }
+            if (pollReceived(op)) break;              // o AP pediu o status deste sensor
+            
+            // pacote para outro sensor (ou beacon): volta a escutar sem reiniciar o timer
+            edWorListen(op);
+         }
+         op->tdmaBeaconArmed = 0;
+         op->tdmaBeaconWindow = 0;
+         
+         // acordou sem o slot programado (beacons perdidos ou botao): relata fora do slot e
+         // espera o proximo beacon para sincronizar de novo
+         if (op->tdmaSync && !op->tdmaSlotArmed && !op->radio->worWake)
+         {
+            op->tdmaSync = 0;
+         }
+         op->tdmaInSlot = op->tdmaSync && op->tdmaSlotArmed && !op->radio->worWake;
+         
+         // tempo dormido desde o ultimo estouro do timer (os estouros sao contados na interrupcao)
+         op->clock += TA1R;
+         // os ticks do radio tambem contam o sono (idade das calibracoes do sintetizador)
+         op->radio->ticks += ((op->clock - sleepClock) * OP_FREQ) / TIMEOUT_01S;
          
          // desliga a interrupcao do pino
          op->btSense->intDisable(op->btSense);
@@ -385,9 +693,22 @@ void opRun        (void * pOp)
          //Configura novamente o watchdof
          wdtClear();
          
+         // slot antes do fim do intervalo configurado: so mantem a sincronia e volta a dormir
+         if (op->tdmaInSlot && (op->flash->interval != 0) && !op->tdmaDownlink &&
+             ((op->clock - op->reportClock) + (ED_SLEEP_TICKS(op->tdmaPeriod) / 2) < (unsigned long)op->flash->interval * TIMEOUT_01S))
+         {
+            op->tdmaInSlot = 0;
+            op->setState(op, OPERATION_MACHINE_STATE_SLEEP);
+            break;
+         }
+         
          // vai para o estado de informar o status
          op->setState(op, OPERATION_MACHINE_STATE_SEND_STATUS);
          op->radio->init(op->radio);
+         if (op->tdmaInSlot && (op->tdmaPhy != op->phy))
+         { // o SACK nao vem no slot: o perfil novo e o anunciado no beacon
+            phyFollow(op, op->tdmaPhy);
+         }
          op->led->on(op->led);
          break;
       case OPERATION_MACHINE_STATE_INFORM_STATUS:
@@ -420,18 +741,444 @@ void opIncTimer   (void * pOp)
    OPERATION_MACHINE * op = (OPERATION_MACHINE *)pOp;
    
    ++op->timer;
+   ++op->radio->ticks;
+   op->clock += ED_CLOCK_TICK;
    op->led->run(op->led);
    op->btConfig->run(op->btConfig);
    op->btConfig->run(op->btConfig);
 }
 
+/*! \brief Verifica se o pacote recebido em WOR e um POLL do AP para este sensor ou um pedido de
+ *   status a um grupo do sensor. Um beacon sincroniza o timer de sono com o slot do sensor, e a
+ *   configuracao de um pacote de grupo e aplicada na hora.
+ */
+char pollReceived (OPERATION_MACHINE * op)
+{
+   char ret = 0;
+   
+   while (op->radio->getData(op->radio, op->tempBuff, &(op->tempLen)))
+   {
+      if (!op->radio->rxLink.crcOk) continue; // descarta pacotes corrompidos
+      switch (packetParse(op->tempBuff, op->tempLen, &(op->packet)))
+      {
+         case PACKET_TYPE_POLL:
+            if (packetIdMatch(op->packet.body.poll.id, edSensorId) && apCounterFresh(op, op->packet.hdr.counter))
+            {
+               ret = 1;
+            }
+            break;
+         case PACKET_TYPE_BEACON:
+            if (apCounterFresh(op, op->packet.hdr.counter))
+            {
+               tdmaSync(op, &(op->packet.body.beacon));
+            }
+            break;
+         case PACKET_TYPE_GROUP:
+            // um pacote para todos os sensores do grupo (todos, tipo ou zona): configura e/ou pede o status
+            if (packetGroupMatch(op->packet.body.group.group, ED_SENSOR_TYPE, op->flash->zone) &&
+                apCounterFresh(op, op->packet.hdr.counter))
+            {
+               configApply(op, op->packet.body.group.config, op->packet.body.group.configCount);
+               if (op->packet.body.group.poll) ret = 1;
+            }
+            break;
+         default:
+            break;
+      }
+   }
+   return ret;
+}
+
+/*! \brief Confere o ACK em grupo do STATUS enviado no slot anterior e programa o timer de sono
+ *   para o slot deste sensor, contado a partir do beacon que acabou de chegar. Fora da janela de
+ *   slots (sensor desconhecido do AP) continua sem sincronia.
+ */
+void tdmaSync (OPERATION_MACHINE * op, PACKET_BEACON * beacon)
+{
+   unsigned short elapsed;
+   unsigned char slot = op->flash->address - RADIO_ADDR_ED_FIRST;
+   char assigned = (op->flash->check == 0x55) && (op->flash->address >= RADIO_ADDR_ED_FIRST) &&
+                   (slot < beacon->slots) && (slot < PACKET_SLOT_COUNT);
+   
+   if (op->tdmaAckPending)
+   {
+      op->tdmaAckPending = 0;
+      if (assigned && (beacon->ackMap[slot >> 3] & (1 << (slot & 0x07))))
+      {
+         op->ackMisses = 0;
+         channelAcked(op);
+      }
+      else
+      { // sem ACK: sobe a potencia e o proximo STATUS espera o SACK
+         if (op->radio->paLevel < op->paMax)
+         {
+            op->radio->setTxPower(op->radio, op->radio->paLevel + 1);
+         }
+         ++op->ackMisses;
+         channelMissed(op);
+      }
+   }
+   
+   if (!assigned)
+   {
+      op->tdmaSync = 0;
+      op->tdmaDownlink = 0;
+      return;
+   }
+   op->tdmaDownlink = (beacon->pendMap[slot >> 3] & (1 << (slot & 0x07))) ? 1 : 0;
+   op->tdmaPeriod = (unsigned short)beacon->period * 10;
+   op->tdmaPhy = beacon->phy;
+   
+   // o slot 0 comeca um slot depois do beacon
+   op->clock += TA1R;
+   op->sleepWakes = 1;
+   TA1CCR0 = (unsigned short)ED_SLEEP_TICKS((unsigned short)(slot + 1) * beacon->slotLen);
+   TA1CTL = TASSEL_1 + MC_1 + TACLR + ID_3;
+   
+   // periodo dos beacons no relogio do sensor, medido contra o relogio do AP (os REFOs dos dois
+   // diferem em ate alguns %); fora de 1/16 do nominal a medida e descartada
+   elapsed = (unsigned short)(beacon->time - op->tdmaBeaconTime);
+   op->tdmaBeaconTicks = 0;
+   if (op->tdmaSync && (elapsed != 0) && (elapsed <= op->tdmaPeriod * ED_TDMA_MISSES))
+   {
+      unsigned long ticks = ((op->clock - op->tdmaBeaconClock) * op->tdmaPeriod) / elapsed;
+      unsigned long nominal = ED_SLEEP_TICKS(op->tdmaPeriod);
+      
+      if ((ticks + (nominal / 16) > nominal) && (ticks < nominal + (nominal / 16)))
+      {
+         op->tdmaBeaconTicks = (unsigned short)ticks;
+      }
+   }
+   op->tdmaBeaconClock = op->clock;
+   op->tdmaBeaconTime = beacon->time;
+   op->tdmaBeaconArmed = 0;
+   op->tdmaBeaconWindow = 0;
+   op->tdmaSync = 1;
+   op->tdmaSlotArmed = 1;
+}
+
+/*! \brief Folga da janela do beacon antes da hora prevista (ticks do timer de sono).
+ *   \return ED_BEACON_GUARD com o periodo medido, 1/16 do periodo sem a medida
+ */
+unsigned long tdmaBeaconGuard (OPERATION_MACHINE * op)
+{
+   return (op->tdmaBeaconTicks != 0) ? ED_SLEEP_TICKS(ED_BEACON_GUARD) : (ED_SLEEP_TICKS(op->tdmaPeriod) / 16);
+}
+
+/*! \brief Tempo de sono ate o inicio da janela do proximo beacon (ticks do timer de sono).
+ *   \return 0 se a janela ja terminou, 1 se ja comecou
+ */
+unsigned long tdmaBeaconDelay (OPERATION_MACHINE * op)
+{
+   unsigned long period = (op->tdmaBeaconTicks != 0) ? op->tdmaBeaconTicks : ED_SLEEP_TICKS(op->tdmaPeriod);
+   unsigned long guard = tdmaBeaconGuard(op);
+   unsigned long elapsed = op->clock - op->tdmaBeaconClock;
+   
+   if (elapsed + guard < period)
+   {
+      return period - guard - elapsed;
+   }
+   return (elapsed < period + guard + ED_SLEEP_TICKS(ED_BEACON_LATE)) ? 1 : 0;
+}
+
+/*! \brief Trata o timer de sono com o sensor sincronizado: no inicio da janela do beacon passa
+ *   a escutar direto; no fim da janela sem beacon volta ao WOR e acorda depois de ED_TDMA_MISSES
+ *   periodos, como sem a janela (o relatorio vai fora do slot e o sensor perde a sincronia).
+ *   \return 1 se continua dormindo, 0 se o timer e o do fim do sono
+ */
+char tdmaBeaconTimer (OPERATION_MACHINE * op)
+{
+   if (op->tdmaBeaconArmed)
+   {
+      op->tdmaBeaconArmed = 0;
+      op->tdmaBeaconWindow = 1;
+      TA1CCR0 = (unsigned short)((2 * tdmaBeaconGuard(op)) + ED_SLEEP_TICKS(ED_BEACON_LATE));
+   }
+   else if (op->tdmaBeaconWindow)
+   {
+      op->tdmaBeaconWindow = 0;
+      TA1CCR0 = (unsigned short)ED_SLEEP_TICKS((unsigned long)op->tdmaPeriod * (ED_TDMA_MISSES - 1));
+   }
+   else
+   {
+      return 0;
+   }
+   op->sleepWakes = 1;
+   TA1CTL = TASSEL_1 + MC_1 + TACLR + ID_3;
+   edWorListen(op);
+   return 1;
+}
+
+/*! \brief Poe o radio para escutar enquanto dorme: direto na janela do beacon, com o periodo
+ *   normal do WOR fora dela.
+ */
+void edWorListen (OPERATION_MACHINE * op)
+{
+   if (op->tdmaBeaconWindow)
+   {
+      op->radio->worStart(op->radio, ED_WOR_EVENT0_BEACON, RADIO_WOR_RX_UNTIL_PACKET);
+   }
+   else
+   {
+      op->radio->worStart(op->radio, ED_WOR_EVENT0, edWorRxTime[op->phy]);
+   }
+}
+
+/*! \brief Ajusta a potencia de transmissao em um nivel para manter o RSSI no AP perto do alvo. */
+void txPowerAdjust (OPERATION_MACHINE * op, signed char rssi)
+{
+   unsigned char level = op->radio->paLevel;
+   
+   if ((rssi < (ED_RSSI_TARGET - ED_RSSI_HYST)) && (level < op->paMax))
+   {
+      ++level;
+   }
+   else if ((rssi > (ED_RSSI_TARGET + ED_RSSI_HYST)) && (level > 0))
+   {
+      --level;
+   }
+   if (level > op->paMax)
+   {
+      level = op->paMax;
+   }
+   op->radio->setTxPower(op->radio, level);
+}
+
+/*! \brief Passa a usar o perfil de camada fisica pedido pelo AP e grava na flash se mudou. */
+void phyFollow (OPERATION_MACHINE * op, unsigned char phy)
+{
+   if (phy >= RADIO_PHY_COUNT) return;
+   
+   op->phy = phy;
+   op->radio->setPhy(op->radio, (RADIO_PHY)phy);
+   if (op->flash->phy != phy)
+   {
+      op->flash->phy = phy;
+      op->flash->update();
+   }
+}
+
+/*! \brief Guarda uma mudanca do valor lido com o horario. Com a fila cheia a mais antiga e
+ *   descartada.
+ */
+void eventPush (OPERATION_MACHINE * op, unsigned char value)
+{
+   if (op->eventCount >= ED_EVENT_QUEUE)
+   {
+      for (unsigned char i = 1; i < ED_EVENT_QUEUE; i++)
+      {
+         op->eventValue[i - 1] = op->eventValue[i];
+         op->eventTime[i - 1] = op->eventTime[i];
+      }
+      --op->eventCount;
+      ++op->eventSeq;
+      if (op->eventSent != 0) --op->eventSent;
+   }
+   op->eventValue[op->eventCount] = value;
+   op->eventTime[op->eventCount] = op->clock;
+   ++op->eventCount;
+}
+
+/*! \brief Tira da fila os eventos enviados no STATUS que o AP confirmou. */
+void eventAcked (OPERATION_MACHINE * op)
+{
+   unsigned char sent = op->eventSent;
+   
+   for (unsigned char i = sent; i < op->eventCount; i++)
+   {
+      op->eventValue[i - sent] = op->eventValue[i];
+      op->eventTime[i - sent] = op->eventTime[i];
+   }
+   op->eventCount -= sent;
+   op->eventSeq += sent;
+   op->eventSent = 0;
+}
+
+/*! \brief Le os canais analogicos do sensor. */
+void chanMeasure (OPERATION_MACHINE * op)
+{
+   op->chanValue[PACKET_CHAN_BATTERY] = op->adc->read(op->adc, ADC_INPUT_BATTERY);
+   op->chanValue[PACKET_CHAN_TEMPERATURE] = op->adc->read(op->adc, ADC_INPUT_TEMPERATURE);
+#ifdef ADC_LEVEL_INPUT
+   op->chanValue[PACKET_CHAN_LEVEL] = op->adc->read(op->adc, ADC_INPUT_LEVEL);
+#endif
+}
+
+/*! \brief Monta os registros dos canais do STATUS em ate room bytes: os deltas dos canais que
+ *   mudaram desde a base confirmada, ou todos os valores absolutos se o AP pode nao ter a base
+ *   (sem base, STATUS anterior sem confirmacao ou a cada ED_CHAN_REFRESH). Se nao couber, o STATUS
+ *   vai sem canais.
+ */
+void chanBuild (OPERATION_MACHINE * op, PACKET_STATUS * status, signed short room)
+{
+   char absolute = !op->chanBaseValid || op->chanPending || (op->chanRefresh >= ED_CHAN_REFRESH);
+   
+   status->chanLen = 0;
+   for (unsigned char i = 0; i < PACKET_CHAN_COUNT; i++)
+   {
+      if (!(ED_CHANNELS & (1 << i))) continue;
+      if (absolute)
+      {
+         if (!packetChanPut(status, (PACKET_CHAN)i, 0, op->chanValue[i])) break;
+      }
+      else if (op->chanValue[i] != op->chanBase[i])
+      {
+         if (!packetChanPut(status, (PACKET_CHAN)i, 1, op->chanValue[i] - op->chanBase[i])) break;
+      }
+   }
+   if (status->chanLen > room)
+   {
+      status->chanLen = 0;
+   }
+   if (status->chanLen != 0)
+   {
+      op->chanPending = 1;
+      op->chanAbsolute = absolute;
+   }
+}
+
+/*! \brief O SACK confirmou o STATUS: os canais enviados viram a base dos proximos deltas. Com
+ *   PACKET_FLAG_CHANNELS no SACK o AP perdeu a base e o proximo STATUS vai com os valores absolutos.
+ */
+void chanAcked (OPERATION_MACHINE * op, unsigned char flags)
+{
+   if (op->chanPending)
+   {
+      for (unsigned char i = 0; i < PACKET_CHAN_COUNT; i++) op->chanBase[i] = op->chanSent[i];
+      op->chanBaseValid = 1;
+      op->chanRefresh = op->chanAbsolute ? 0 : op->chanRefresh + 1;
+      op->chanPending = 0;
+   }
+   if (flags & PACKET_FLAG_CHANNELS)
+   {
+      op->chanBaseValid = 0;
+   }
+}
+
+/*! \brief Aplica comandos de configuracao (do SACK, antes de dormir, ou de um pacote de grupo).
+ *   Os comandos so definem valores, entao um lote repetido e aplicado de novo sem efeito.
+ */
+void configApply (OPERATION_MACHINE * op, PACKET_CONFIG_ITEM * config, unsigned char count)
+{
+   for (unsigned char i = 0; i < count; i++)
+   {
+      unsigned short value = ((unsigned short)config[i].value[0] << 8) | config[i].value[1];
+      
+      switch (config[i].type)
+      {
+         case PACKET_CONFIG_INTERVAL:
+            if ((value <= ED_INTERVAL_MAX) && (op->flash->interval != value))
+            {
+               op->flash->interval = value;
+               op->flash->update();
+            }
+            break;
+         case PACKET_CONFIG_PA_MAX:
+            if ((value <= RADIO_PA_LEVEL_MAX) && (op->paMax != value))
+            {
+               op->paMax = (unsigned char)value;
+               if (op->radio->paLevel > op->paMax) op->radio->setTxPower(op->radio, op->paMax);
+               op->flash->paMax = op->paMax;
+               op->flash->update();
+            }
+            break;
+         case PACKET_CONFIG_CHANNEL:
+            // o AP muda de canal depois, pelo comando da serial: o sensor continua no canal atual
+            // (e confirma o comando nele) e so passa para o novo quando os ACKs pararem de chegar
+            if (value < OPERATION_MACHINE_MAX_CHANNELS)
+            {
+               op->channelNext = (value != op->channel) ? (unsigned char)value : ED_CHANNEL_NONE;
+               op->channelMisses = 0;
+            }
+            break;
+         case PACKET_CONFIG_ZONE:
+            if ((value <= PACKET_GROUP_ZONE_MAX) && (op->flash->zone != value))
+            {
+               op->flash->zone = (unsigned char)value;
+               op->flash->update();
+            }
+            break;
+         default:
+            break;
+      }
+   }
+}
+
+/*! \brief ACK recebido: se o sensor ja esta no canal pedido pelo AP, o canal vai para a flash. */
+void channelAcked (OPERATION_MACHINE * op)
+{
+   op->channelMisses = 0;
+   if ((op->channelNext != ED_CHANNEL_NONE) && (op->channel != op->flash->channel))
+   {
+      op->flash->channel = op->channel;
+      op->flash->update();
+      op->channelNext = ED_CHANNEL_NONE;
+   }
+}
+
+/*! \brief ACK perdido com um canal pedido pelo AP: depois de ED_CHANNEL_MISSES seguidos passa
+ *   para o outro canal (o novo, ou de volta ao gravado na flash se o AP nao mudou).
+ */
+void channelMissed (OPERATION_MACHINE * op)
+{
+   unsigned char channel;
+   
+   if ((op->channelNext == ED_CHANNEL_NONE) || (++op->channelMisses < ED_CHANNEL_MISSES))
+   {
+      return;
+   }
+   channel = op->channel;
+   op->channel = op->channelNext;
+   op->channelNext = channel;
+   op->channelMisses = 0;
+   op->radio->setChannel(op->radio, op->channel);
+}
+
+/*! \brief Grava na flash a epoca do contador de quadros (chamada pelo packet.c). */
+void opEpochSave (unsigned short epoch)
+{
+   operationMachine.flash->epoch = epoch;
+   operationMachine.flash->update();
+}
+
+/*! \brief Aceita o contador de um quadro do AP se for mais novo que o ultimo. O AP passa para
+ *   a proxima epoca a cada boot e, depois de reiniciar, so aceita deste ED epocas mais novas que
+ *   a gravada: quando a epoca do AP muda (ou ainda nao e conhecida, depois do boot do ED) o ED
+ *   tambem passa para a proxima, uma vez. Assim as gravacoes na flash acompanham os boots e nao
+ *   os ACKs perdidos.
+ *   \return 1 se o contador e novo
+ */
+char apCounterFresh (OPERATION_MACHINE * op, unsigned long counter)
+{
+   unsigned short apEpoch = (unsigned short)(op->apCounter >> 16);
+   
+   if (!packetCounterFresh(counter, &(op->apCounter)))
+   {
+      return 0;
+   }
+   if ((unsigned short)(counter >> 16) != apEpoch)
+   {
+      packetEpochNext();
+   }
+   return 1;
+}
+
 // Timer1 A0 interrupt service routine
 #pragma vector=TIMER1_A0_VECTOR
 __interrupt void TIMER1_A0_ISR(void)
 {
    if (operationMachine.state == OPERATION_MACHINE_STATE_SLEEP )
    {
-      LPM3_EXIT;
+      operationMachine.clock += TA1CCR0 + 1ul;
+      if (operationMachine.sleepWakes > 1)
+      { // intervalo longo: continua dormindo
+         --operationMachine.sleepWakes;
+      }
+      else
+      {
+         operationMachine.sleepTimeout = 1;
+         LPM3_EXIT;
+      }
    }
    else
    {
@@ -4,8 +4,12 @@
 
 #include "led.h"
 #include "button.h"
+#include "adc.h"
 #include "radio.h"
 #include "flashParam.h"
+#include "packet.h"
+
+#define ED_EVENT_QUEUE 16             // mudancas de valor guardadas enquanto o AP nao confirma
 
 typedef enum
 {
@@ -37,15 +41,60 @@ typedef struct OPERATION_MACHINE_STRUCT
    unsigned short             timeout;
    unsigned char              configState;
    unsigned char              timeoutStatus;
+   unsigned char              phy;           // perfil de camada fisica em uso
+   unsigned char              ackMisses;     // SACKs perdidos seguidos
    
    RADIO *                    radio;
    unsigned char              tempBuff[256];
    unsigned char              tempLen;
-   unsigned char              message[15];
+   PACKET                     packet;        // ultimo pacote recebido
+   unsigned char              seq;           // sequencia do ultimo DISC transmitido
+   unsigned char              statusSeq;     // sequencia do ultimo STATUS (repetida nas retransmissoes)
+   unsigned char              statusValue;   // valor enviado no ultimo STATUS
+   
+   unsigned long              clock;         // relogio do sensor (ticks do timer de sono, 1/512 s)
+   unsigned char              pinValue;      // valor lido na ultima leitura ('F' ou '0')
+   unsigned char              eventValue[ED_EVENT_QUEUE]; // mudancas de valor ainda nao confirmadas, a mais antiga primeiro
+   unsigned long              eventTime[ED_EVENT_QUEUE];  // horario de cada mudanca (clock)
+   unsigned char              eventCount;
+   unsigned char              eventSeq;      // numero do evento mais antigo guardado
+   unsigned char              eventSent;     // eventos do inicio da fila enviados no ultimo STATUS
+   
+   signed short               chanValue[PACKET_CHAN_COUNT]; // ultima medida de cada canal
+   signed short               chanSent[PACKET_CHAN_COUNT];  // valores do ultimo STATUS com canais
+   signed short               chanBase[PACKET_CHAN_COUNT];  // valores confirmados pelo AP (base dos deltas)
+   unsigned char              chanBaseValid; // o AP tem a base
+   unsigned char              chanPending;   // o ultimo STATUS com canais ainda nao foi confirmado
+   unsigned char              chanAbsolute;  // o ultimo STATUS com canais levou os valores absolutos
+   unsigned char              chanRefresh;   // STATUS com deltas desde os ultimos valores absolutos
+   
+   unsigned char              paMax;         // nivel maximo do controle de potencia (configurado pelo AP)
+   unsigned char              configAck;     // configSeq dos ultimos comandos aplicados
+   unsigned char              configAckPending; // configAck ainda nao confirmado por um SACK
+   unsigned char              configAckSent; // o ultimo STATUS levou o configAck
+   unsigned short             sleepWakes;    // estouros do timer ate o fim do sono (intervalos longos)
+   unsigned char              sleepTimeout;  // o timer (e nao um pacote ou o botao) acordou a CPU
+   unsigned long              reportClock;   // clock do ultimo STATUS
+   unsigned long              apCounter;     // ultimo contador de quadros aceito do AP
+   unsigned char              tdmaSync;      // sincronizado com os beacons do AP (relatorio no slot)
+   unsigned char              tdmaSlotArmed; // timer de sono programado para o slot pelo ultimo beacon
+   unsigned short             tdmaPeriod;    // intervalo entre beacons (10 ms)
+   unsigned char              tdmaInSlot;    // acordou no slot: o STATUS vai sem esperar SACK
+   unsigned char              tdmaAckPending; // STATUS no slot esperando o ACK em grupo do proximo beacon
+   unsigned char              tdmaPhy;       // perfil de camada fisica anunciado no ultimo beacon
+   unsigned char              tdmaDownlink;  // o ultimo beacon pediu um STATUS fora do slot (o AP tem algo para o SACK)
+   unsigned long              tdmaBeaconClock; // clock na chegada do ultimo beacon
+   unsigned short             tdmaBeaconTime;  // relogio do AP no ultimo beacon (10 ms)
+   unsigned short             tdmaBeaconTicks; // periodo dos beacons em ticks do timer de sono (0 = nao medido)
+   unsigned char              tdmaBeaconArmed; // timer de sono programado para a janela do proximo beacon
+   unsigned char              tdmaBeaconWindow; // escutando direto, na janela do beacon
+   unsigned char              channelNext;   // canal pedido pelo AP, ainda nao confirmado (ED_CHANNEL_NONE = nenhum)
+   unsigned char              channelMisses; // ACKs perdidos seguidos no canal atual com um canal pedido
 
    LED *                      led;
    BUTTON *                   btConfig;
    BUTTON *                   btSense;
+   ADC *                      adc;
    
    FLASH_PARAM *              flash;
 } OPERATION_MACHINE;
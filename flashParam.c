@@ -3,13 +3,19 @@
  */
 
 #include "flashParam.h"
+#include "radio.h"
 #include "cc430x513x.h"
 
 #define FLASH_INFO_A 0x1980
+#define FLASH_INFO_B 0x1900
+#define FLASH_INFO_C 0x1880
 #define INFO_FLASH_ADDR FLASH_INFO_A
+#define SECRET_FLASH_ADDR FLASH_INFO_B  // segredo da instalacao: gravado pelo programador, o firmware nunca apaga
+#define ZONE_FLASH_ADDR FLASH_INFO_C    // zonas e epocas dos sensores no AP (nao cabem no segmento A)
+#define EPOCH_FLASH_ADDR (FLASH_INFO_C + SENSOR_LIST_SIZE)
 
 // protitipos das funcoes de apoio
-void infoErase(void);
+void infoErase(unsigned char * addr);
 void infoWB (unsigned char * addr, char value);
 
 // prototipos dos metodos
@@ -38,6 +44,13 @@ void flashParamInit(void)
       flashParam.reset();
       flashParam.update();
    }
+#ifdef ACCESS_POINT
+   else if (flashParam.format != FLASH_PARAM_FORMAT)
+   { // a lista foi convertida do formato antigo, grava no formato novo
+      flashParam.format = FLASH_PARAM_FORMAT;
+      flashParam.update();
+   }
+#endif
 }
 
 void flashParamLoad(void)
@@ -46,19 +59,119 @@ void flashParamLoad(void)
 
 #ifdef ACCESS_POINT
    unsigned char * ramPtr = (unsigned char *)(flashParam.sensors);
-   unsigned char i;
+   unsigned char i, j;
 
-   // copia da flash para a ram
-   for (i = 0; i < FLASH_PARAM_DATA_LEN; i++)
+   if (flashPtr[FLASH_PARAM_DATA_LEN + 1] == FLASH_PARAM_FORMAT)
+   {
+      // copia da flash para a ram
+      for (i = 0; i < FLASH_PARAM_DATA_LEN; i++)
+      {
+         *ramPtr++ = *flashPtr++;
+      }
+      flashParam.netId = *flashPtr++;
+      flashParam.format = *flashPtr++;
+      flashParam.phy = *flashPtr++;
+      flashParam.epoch = flashPtr[0] | ((unsigned short)flashPtr[1] << 8);
+   }
+   else
+   {
+      // formato antigo (ID + tipo): os sensores ficam sem endereco proprio (broadcast)
+      for (i = 0; i < SENSOR_LIST_SIZE; i++)
+      {
+         for (j = 0; j < (SENSOR_ID_SIZE + SENSOR_TYPE_SIZE); j++)
+         {
+            flashParam.sensors[i][j] = *flashPtr++;
+         }
+         flashParam.sensors[i][SENSOR_ADDR_POS] = (flashParam.sensors[i][SENSOR_ID_SIZE] != 0xFF) ? RADIO_ADDR_BROADCAST : 0xFF;
+      }
+      flashParam.netId = RADIO_NETWORK_PAIRING;
+      flashParam.format = 0xFF;
+      flashParam.phy = RADIO_PHY_250K;
+      flashParam.epoch = 0;
+   }
+   if (flashParam.netId >= RADIO_NETWORK_COUNT)
+   {
+      flashParam.netId = RADIO_NETWORK_PAIRING;
+   }
+   if (flashParam.phy >= RADIO_PHY_COUNT)
+   {
+      flashParam.phy = RADIO_PHY_250K;
+   }
+   
+   // zonas: segmento apagado ou gravado por uma versao sem zonas fica sem zona
+   flashPtr = (unsigned char *)ZONE_FLASH_ADDR;
+   for (i = 0; i < SENSOR_LIST_SIZE; i++)
    {
-      *ramPtr++ = *flashPtr++;
+      flashParam.zones[i] = (flashPtr[i] != 0xFF) ? flashPtr[i] : 0;
+   }
+   // epocas: apagada ou gravada por uma versao sem epocas aceita qualquer uma
+   flashPtr = (unsigned char *)EPOCH_FLASH_ADDR;
+   for (i = 0; i < SENSOR_LIST_SIZE; i++)
+   {
+      flashParam.edEpochs[i] = flashPtr[2 * i] | ((unsigned short)flashPtr[2 * i + 1] << 8);
+      if (flashParam.edEpochs[i] == 0xFFFF)
+      {
+         flashParam.edEpochs[i] = 0;
+      }
    }
 #endif
    
 #ifdef END_DEVICE
    flashParam.check = *flashPtr++;
-   flashParam.channel = *flashPtr;
+   flashParam.channel = *flashPtr++;
+   flashParam.netId = *flashPtr++;
+   flashParam.address = *flashPtr++;
+   flashParam.phy = *flashPtr++;
+   flashParam.epoch = flashPtr[0] | ((unsigned short)flashPtr[1] << 8);
+   flashParam.interval = flashPtr[2] | ((unsigned short)flashPtr[3] << 8);
+   flashParam.zone = flashPtr[4];
+   flashParam.paMax = flashPtr[5];
+   
+   // gravado por uma versao sem intervalo configuravel
+   if (flashParam.interval == 0xFFFF)
+   {
+      flashParam.interval = 0;
+   }
+   // gravado por uma versao sem zona
+   if (flashParam.zone == 0xFF)
+   {
+      flashParam.zone = 0;
+   }
+   // gravado por uma versao sem potencia maxima configuravel
+   if (flashParam.paMax > RADIO_PA_LEVEL_MAX)
+   {
+      flashParam.paMax = RADIO_PA_LEVEL_MAX;
+   }
+   // gravado por uma versao sem rede/endereco: rede original e so broadcast
+   if (flashParam.netId >= RADIO_NETWORK_COUNT)
+   {
+      flashParam.netId = RADIO_NETWORK_PAIRING;
+   }
+   if (flashParam.address == 0xFF)
+   {
+      flashParam.address = RADIO_ADDR_BROADCAST;
+   }
+   if (flashParam.phy >= RADIO_PHY_COUNT)
+   {
+      flashParam.phy = RADIO_PHY_250K;
+   }
 #endif   
+   // gravado por uma versao sem epoca (flash apagada)
+   if (flashParam.epoch == 0xFFFF)
+   {
+      flashParam.epoch = 0;
+   }
+   
+   // segredo da instalacao: segmento todo apagado e sem segredo (chaves de fabrica)
+   flashParam.secret = 0;
+   flashPtr = (unsigned char *)SECRET_FLASH_ADDR;
+   for (unsigned char k = 0; k < FLASH_SECRET_SIZE; k++)
+   {
+      if (flashPtr[k] != 0xFF)
+      {
+         flashParam.secret = flashPtr;
+      }
+   }
 }
 
 char flashParamValidate(void)
@@ -74,16 +187,30 @@ void flashParamReset(void)
 
    for (i = 0; i < SENSOR_LIST_SIZE; i++)
    {
-      for (j = 0; j < (SENSOR_ID_SIZE + SENSOR_TYPE_SIZE); j++)
+      for (j = 0; j < SENSOR_ENTRY_SIZE; j++)
       {
          flashParam.sensors[i][j] = 0xFF;
       }
    }
+   flashParam.netId = RADIO_NETWORK_PAIRING;
+   flashParam.format = FLASH_PARAM_FORMAT;
+   flashParam.phy = RADIO_PHY_250K;
+   for (i = 0; i < SENSOR_LIST_SIZE; i++)
+   {
+      flashParam.zones[i] = 0;
+      flashParam.edEpochs[i] = 0;
+   }
 #endif
    
 #ifdef END_DEVICE
    flashParam.check = 0xFF;
    flashParam.channel = 0xFF;
+   flashParam.netId = RADIO_NETWORK_PAIRING;
+   flashParam.address = RADIO_ADDR_BROADCAST;
+   flashParam.phy = RADIO_PHY_250K;
+   flashParam.interval = 0;
+   flashParam.zone = 0;
+   flashParam.paMax = RADIO_PA_LEVEL_MAX;
 #endif 
 }
 
@@ -96,7 +223,7 @@ void flashParamUpdate(void)
    unsigned char i;
    
    // apaga a memoria flash de parametros
-   infoErase();
+   infoErase(flashPtr);
 
    // grava os novos valores
    for (i = 0; i < FLASH_PARAM_DATA_LEN; i++)
@@ -105,16 +232,57 @@ void flashParamUpdate(void)
       ++flashPtr;
       ++ramPtr;
    }
+   infoWB (flashPtr, flashParam.netId);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.format);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.phy);
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)flashParam.epoch);
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)(flashParam.epoch >> 8));
+   
+   // zonas no segmento proprio
+   flashPtr = (unsigned char *)ZONE_FLASH_ADDR;
+   infoErase(flashPtr);
+   for (i = 0; i < SENSOR_LIST_SIZE; i++)
+   {
+      infoWB (&(flashPtr[i]), flashParam.zones[i]);
+   }
+   flashPtr = (unsigned char *)EPOCH_FLASH_ADDR;
+   for (i = 0; i < SENSOR_LIST_SIZE; i++)
+   {
+      infoWB (&(flashPtr[2 * i]), (unsigned char)flashParam.edEpochs[i]);
+      infoWB (&(flashPtr[2 * i + 1]), (unsigned char)(flashParam.edEpochs[i] >> 8));
+   }
 #endif
    
 #ifdef END_DEVICE
    
    // apaga a memoria flash de parametros
-   infoErase();
+   infoErase(flashPtr);
 
    infoWB (flashPtr, flashParam.check);
    ++flashPtr;
    infoWB (flashPtr, flashParam.channel);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.netId);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.address);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.phy);
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)flashParam.epoch);
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)(flashParam.epoch >> 8));
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)flashParam.interval);
+   ++flashPtr;
+   infoWB (flashPtr, (unsigned char)(flashParam.interval >> 8));
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.zone);
+   ++flashPtr;
+   infoWB (flashPtr, flashParam.paMax);
    
 #endif
 }
@@ -174,14 +342,15 @@ void infoWB (unsigned char * addr, char value)
 }
 
 #pragma location="RAMCODE"
-/*!  \brief apaga a info flash.
+/*!  \brief apaga um segmento da info flash.
+ *   \param addr endereco do segmento
  */
-void infoErase (void)
+void infoErase (unsigned char * addr)
 {
    unsigned int * flashPtr;
 
    // carrega o endereco da secao a ser apagada
-   flashPtr = (unsigned int *) INFO_FLASH_ADDR;
+   flashPtr = (unsigned int *) addr;
 
    // desbloqieia a flash principal
    FCTL3 = FWKEY + LOCKA;
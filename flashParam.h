@@ -4,10 +4,19 @@
 
 #define SENSOR_ID_SIZE 4
 #define SENSOR_TYPE_SIZE 1
+#define SENSOR_ADDR_SIZE 1
 #define SENSOR_LIST_SIZE 20
 
+// cada entrada da lista: ID, tipo e endereco de radio do sensor
+#define SENSOR_ENTRY_SIZE (SENSOR_ID_SIZE + SENSOR_TYPE_SIZE + SENSOR_ADDR_SIZE)
+#define SENSOR_ADDR_POS   (SENSOR_ID_SIZE + SENSOR_TYPE_SIZE)
+
+// segredo da instalacao (chaves das redes, packet.c), gravado no segmento B na instalacao
+#define FLASH_SECRET_SIZE 16
+
 #ifdef ACCESS_POINT
-#define FLASH_PARAM_DATA_LEN ((SENSOR_ID_SIZE + SENSOR_TYPE_SIZE) * SENSOR_LIST_SIZE)
+#define FLASH_PARAM_DATA_LEN (SENSOR_ENTRY_SIZE * SENSOR_LIST_SIZE)
+#define FLASH_PARAM_FORMAT   0x02   // formato com endereco; a lista antiga (ID + tipo) e convertida
 #endif
 
 #ifdef END_DEVICE
@@ -22,13 +31,28 @@ typedef struct FLASH_PARAM_STRUCT
    void (* reset)    (void);
    void (* update)   (void);
    
+   const unsigned char * secret;     // segredo da instalacao na flash (0 se o segmento esta apagado)
+   
 #ifdef ACCESS_POINT
-   unsigned char sensors[SENSOR_LIST_SIZE][SENSOR_ID_SIZE + SENSOR_TYPE_SIZE];
+   unsigned char sensors[SENSOR_LIST_SIZE][SENSOR_ENTRY_SIZE];
+   unsigned char netId;
+   unsigned char format;
+   unsigned char phy;
+   unsigned short epoch;             // epoca do contador de quadros (packet.c), muda a cada boot
+   unsigned char zones[SENSOR_LIST_SIZE]; // zona confirmada por cada endereco (indice = endereco - RADIO_ADDR_ED_FIRST)
+   unsigned short edEpochs[SENSOR_LIST_SIZE]; // epoca do ultimo contador aceito de cada endereco (mesmo indice)
 #endif
 
 #ifdef END_DEVICE
    unsigned char check;
    unsigned char channel;
+   unsigned char netId;
+   unsigned char address;
+   unsigned char phy;
+   unsigned short epoch;             // epoca do contador de quadros (packet.c), muda a cada boot
+   unsigned short interval;          // intervalo entre relatorios pedido pelo AP (s, 0 = padrao)
+   unsigned char zone;               // zona para os pacotes de grupo (0 = sem zona)
+   unsigned char paMax;              // nivel maximo de potencia pedido pelo AP
 #endif
    
 } FLASH_PARAM;
@@ -0,0 +1,566 @@
+/*! \file packet.c
+ *  \brief implementacao da montagem e da leitura dos pacotes (versao 2).
+ */
+
+#include "packet.h"
+#include "scrambler.h"
+#include "radio.h"
+
+// tamanho do corpo de cada tipo de pacote
+const unsigned char PACKET_BODY_SIZE[PACKET_TYPE_COUNT] =
+{
+   0,
+   sizeof(PACKET_DISC),
+   sizeof(PACKET_DACK),
+   PACKET_STATUS_BASE_SIZE,          // os eventos sao opcionais (packetBodyLen)
+   PACKET_SACK_BASE_SIZE,            // os comandos sao opcionais (packetBodyLen)
+   sizeof(PACKET_POLL),
+   PACKET_BEACON_BASE_SIZE,          // o pendMap e opcional (packetBodyLen)
+   PACKET_GROUP_SIZE(0)              // os comandos sao opcionais (packetBodyLen)
+};
+
+static unsigned char packetBodyLen (PACKET * packet);
+static unsigned char packetTrailerLen (PACKET * packet);
+static void packetCopy (const unsigned char * dataIn, unsigned char * dataOut, unsigned char len);
+static void packetCodeBody (unsigned char * dataIn, unsigned char * dataOut, unsigned char len, char scramble);
+
+#ifdef PACKET_SECURITY
+// chave de fabrica de cada rede (indice = netId); a da rede de pareamento e comum a todos os
+// produtos, as outras so valem sem o segredo da instalacao (packetSecurityInit)
+const unsigned char PACKET_NETWORK_KEYS[RADIO_NETWORK_COUNT][AES_KEY_SIZE] =
+{
+   {0x3A, 0x91, 0x5C, 0x07, 0xE2, 0x48, 0xB6, 0x1D, 0x74, 0xC9, 0x20, 0x8F, 0x53, 0xAE, 0x16, 0xF0},
+   {0x8B, 0x24, 0xD7, 0x6E, 0x01, 0xF5, 0x39, 0xA2, 0xC8, 0x5D, 0x90, 0x13, 0x7A, 0xE6, 0x4F, 0xB1},
+   {0x62, 0xFD, 0x0E, 0x93, 0x47, 0xB8, 0x25, 0xDA, 0x1C, 0x81, 0x6F, 0xE4, 0x39, 0x05, 0xCE, 0x72},
+   {0xD4, 0x3F, 0xA8, 0x51, 0x9E, 0x0B, 0x76, 0xC3, 0x2A, 0xE7, 0x14, 0x68, 0xBD, 0x90, 0x45, 0x1F},
+   {0x17, 0xC6, 0x4D, 0xB9, 0x72, 0x2E, 0xE0, 0x85, 0x5B, 0x03, 0xDA, 0x36, 0x91, 0x4C, 0xF8, 0x6A},
+   {0xAF, 0x58, 0x93, 0x2C, 0xE5, 0x7D, 0x0A, 0xB4, 0x61, 0xCF, 0x38, 0x9B, 0x06, 0x72, 0xD1, 0x4E},
+   {0x45, 0xE1, 0x7B, 0x08, 0xCD, 0x96, 0x3A, 0x5F, 0xB2, 0x14, 0x89, 0xF3, 0x60, 0x2D, 0xA7, 0x9C},
+   {0xF9, 0x0D, 0x26, 0xE3, 0x58, 0xA1, 0xCB, 0x74, 0x1E, 0x9A, 0x47, 0x05, 0xD6, 0xB8, 0x33, 0x6D}
+};
+
+// chaves em uso, calculadas uma vez no packetSecurityInit (o aesEncrypt do modulo AES reconhece
+// a chave carregada pelo endereco, o conteudo nao pode mudar depois)
+static unsigned char packetKeys[RADIO_NETWORK_COUNT][AES_KEY_SIZE];
+static unsigned char packetNetId = RADIO_NETWORK_PAIRING; // rede (chave) dos proximos pacotes
+static unsigned short packetEpoch;                         // parte alta do contador, gravada pelo chamador
+static unsigned short packetCount;                         // quadros transmitidos na epoca
+static void (* packetEpochSave)(unsigned short epoch);
+
+static unsigned long packetNextCounter (void);
+static void packetNonce (unsigned char src, unsigned long counter, const unsigned char * id, unsigned char * nonce);
+#endif
+
+/*! \brief Preenche o cabecalho de um pacote a ser montado. */
+void packetSetHeader (PACKET * packet, PACKET_TYPE type, unsigned char flags, unsigned char seq, unsigned char dst, unsigned char src)
+{
+   packet->hdr.type = type;
+   packet->hdr.flags = flags;
+   packet->hdr.seq = seq;
+   packet->hdr.dst = dst;
+   packet->hdr.src = src;
+}
+
+/*! \brief Monta o pacote no formato do ar: cabecalho e corpo embaralhado. Com PACKET_SECURITY
+ *   o contador do cabecalho e o proximo do transmissor e o corpo vai cifrado, seguido do MIC.
+ *   \return numero de bytes a transmitir (incluindo o byte de tamanho)
+ */
+unsigned char packetBuild (PACKET * packet, unsigned char * frame)
+{
+   unsigned char fixedLen = packetBodyLen(packet);
+   unsigned char bodyLen = fixedLen + packetTrailerLen(packet);
+   unsigned char pos = fixedLen;
+   
+   frame[0] = PACKET_HEADER_SIZE - 1 + bodyLen + PACKET_MIC_SIZE;    // tamanho do payload
+   frame[1] = packet->hdr.dst;
+   frame[2] = (PACKET_VERSION << 4) | packet->hdr.type;
+   frame[3] = packet->hdr.flags;
+   frame[4] = packet->hdr.seq;
+   frame[5] = packet->hdr.src;
+   
+   // corpo do tipo e, no STATUS, a confirmacao da configuracao e os registros dos canais logo
+   // depois; embaralha tudo junto
+   packetCopy ((unsigned char *)&(packet->body), &(frame[PACKET_HEADER_SIZE]), fixedLen);
+   if ((packet->hdr.type == PACKET_TYPE_STATUS) && (packet->hdr.flags & PACKET_FLAG_CONFIG))
+   {
+      frame[PACKET_HEADER_SIZE + pos++] = packet->body.status.configAck;
+   }
+   packetCopy (packet->body.status.chan, &(frame[PACKET_HEADER_SIZE + pos]), bodyLen - pos);
+   packetCodeBody (&(frame[PACKET_HEADER_SIZE]), &(frame[PACKET_HEADER_SIZE]), bodyLen, 1);
+   
+#ifdef PACKET_SECURITY
+   {
+      unsigned char nonce[AES_CCM_NONCE_SIZE];
+      // sem endereco (origem 0) o ID do ED, no inicio do corpo, vai aberto e entra no nonce
+      unsigned char clearLen = (packet->hdr.src == RADIO_ADDR_BROADCAST) ? PACKET_ID_SIZE : 0;
+      
+      packet->hdr.counter = packetNextCounter();
+      frame[6] = (unsigned char)(packet->hdr.counter >> 24);
+      frame[7] = (unsigned char)(packet->hdr.counter >> 16);
+      frame[8] = (unsigned char)(packet->hdr.counter >> 8);
+      frame[9] = (unsigned char)packet->hdr.counter;
+      
+      packetNonce (packet->hdr.src, packet->hdr.counter, &(frame[PACKET_HEADER_SIZE]), nonce);
+      aesCcmEncrypt (packetKeys[packetNetId], nonce, frame, PACKET_HEADER_SIZE + clearLen,
+                     &(frame[PACKET_HEADER_SIZE + clearLen]), bodyLen - clearLen, &(frame[PACKET_HEADER_SIZE + bodyLen]));
+   }
+#else
+   packet->hdr.counter = 0;
+#endif
+   
+   return PACKET_HEADER_SIZE + bodyLen + PACKET_MIC_SIZE;
+}
+
+/*! \brief Le um pacote recebido (como entregue pelo getData do radio).
+ *   Bytes alem do corpo do tipo sao ignorados, para aceitar extensoes futuras (menos no STATUS com
+ *   PACKET_FLAG_CHANNELS, em que os canais ocupam o resto do corpo). Com PACKET_SECURITY o corpo
+ *   (com as extensoes) e decifrado no proprio quadro e o MIC conferido; a repeticao de pacotes
+ *   antigos e tratada por quem chama, com packetCounterFresh.
+ *   \return tipo do pacote, PACKET_TYPE_INVALID se a versao, o tipo, o tamanho ou o MIC nao conferem
+ */
+PACKET_TYPE packetParse (unsigned char * frame, unsigned char len, PACKET * packet)
+{
+   unsigned char type;
+   unsigned char bodyLen;
+   unsigned char fixedLen;
+   unsigned char count;
+   
+   if (len < PACKET_HEADER_SIZE)
+   {
+      return PACKET_TYPE_INVALID;
+   }
+   type = frame[2] & 0x0F;
+   // corpo e extensoes pelo byte de tamanho (no FEC o quadro vem completado)
+   bodyLen = frame[0] + 1 - PACKET_HEADER_SIZE - PACKET_MIC_SIZE;
+   if (((frame[2] >> 4) != PACKET_VERSION) || (type == PACKET_TYPE_INVALID) || (type >= PACKET_TYPE_COUNT) ||
+       (frame[0] >= len) || (bodyLen > frame[0]) || (bodyLen < PACKET_BODY_SIZE[type]))
+   {
+      return PACKET_TYPE_INVALID;
+   }
+   
+   packet->hdr.type = type;
+   packet->hdr.dst = frame[1];
+   packet->hdr.flags = frame[3];
+   packet->hdr.seq = frame[4];
+   packet->hdr.src = frame[5];
+   
+#ifdef PACKET_SECURITY
+   {
+      unsigned char nonce[AES_CCM_NONCE_SIZE];
+      unsigned char clearLen = (packet->hdr.src == RADIO_ADDR_BROADCAST) ? PACKET_ID_SIZE : 0;
+      
+      // o MIC fica no fim do payload
+      packet->hdr.counter = ((unsigned long)frame[6] << 24) | ((unsigned long)frame[7] << 16) |
+                            ((unsigned short)frame[8] << 8) | frame[9];
+      
+      packetNonce (packet->hdr.src, packet->hdr.counter, &(frame[PACKET_HEADER_SIZE]), nonce);
+      if ((bodyLen < clearLen) ||
+          !aesCcmDecrypt (packetKeys[packetNetId], nonce, frame, PACKET_HEADER_SIZE + clearLen,
+                          &(frame[PACKET_HEADER_SIZE + clearLen]), bodyLen - clearLen, &(frame[PACKET_HEADER_SIZE + bodyLen])))
+      {
+         return PACKET_TYPE_INVALID;
+      }
+   }
+#else
+   packet->hdr.counter = 0;
+#endif
+   
+   packetCodeBody (&(frame[PACKET_HEADER_SIZE]), &(frame[PACKET_HEADER_SIZE]), bodyLen, 0);
+   
+   fixedLen = bodyLen;
+   if ((type == PACKET_TYPE_STATUS) && (packet->hdr.flags & PACKET_FLAG_EVENTS))
+   { // eventos guardados pelo ED (o numero deles vem depois da sequencia do primeiro)
+      count = frame[PACKET_HEADER_SIZE + PACKET_STATUS_BASE_SIZE + 1];
+      if ((bodyLen < PACKET_STATUS_EVENTS_SIZE(0)) || (count > PACKET_EVENTS_MAX) ||
+          (bodyLen < PACKET_STATUS_EVENTS_SIZE(count)))
+      {
+         return PACKET_TYPE_INVALID;
+      }
+      fixedLen = PACKET_STATUS_EVENTS_SIZE(count);
+   }
+   else if (type == PACKET_TYPE_STATUS)
+   {
+      fixedLen = PACKET_STATUS_BASE_SIZE;
+   }
+   else if ((type == PACKET_TYPE_SACK) && (packet->hdr.flags & PACKET_FLAG_CONFIG))
+   { // comandos de configuracao (o numero deles vem depois da sequencia)
+      count = frame[PACKET_HEADER_SIZE + PACKET_SACK_BASE_SIZE + 1];
+      if ((bodyLen < PACKET_SACK_CONFIG_SIZE(0)) || (count > PACKET_CONFIG_COUNT) ||
+          (bodyLen < PACKET_SACK_CONFIG_SIZE(count)))
+      {
+         return PACKET_TYPE_INVALID;
+      }
+   }
+   else if ((type == PACKET_TYPE_BEACON) && (packet->hdr.flags & PACKET_FLAG_CONFIG) && (bodyLen < sizeof(PACKET_BEACON)))
+   {
+      return PACKET_TYPE_INVALID;
+   }
+   else if (type == PACKET_TYPE_GROUP)
+   { // comandos de configuracao do grupo (o numero deles vem antes)
+      count = frame[PACKET_HEADER_SIZE + 2];
+      if ((count > PACKET_CONFIG_COUNT) || (bodyLen < PACKET_GROUP_SIZE(count)))
+      {
+         return PACKET_TYPE_INVALID;
+      }
+   }
+   if (fixedLen > sizeof(packet->body))
+   {
+      fixedLen = sizeof(packet->body);
+   }
+   packetCopy (&(frame[PACKET_HEADER_SIZE]), (unsigned char *)&(packet->body), fixedLen);
+   
+   if ((type == PACKET_TYPE_SACK) && !(packet->hdr.flags & PACKET_FLAG_CONFIG))
+   {
+      packet->body.sack.configCount = 0;
+   }
+   if ((type == PACKET_TYPE_BEACON) && !(packet->hdr.flags & PACKET_FLAG_CONFIG))
+   {
+      for (count = 0; count < (PACKET_SLOT_COUNT / 8); count++) packet->body.beacon.pendMap[count] = 0;
+   }
+   
+   if (type == PACKET_TYPE_STATUS)
+   { // confirmacao da configuracao e canais: o resto do corpo
+      if (!(packet->hdr.flags & PACKET_FLAG_EVENTS))
+      {
+         packet->body.status.eventCount = 0;
+      }
+      packet->body.status.configAck = 0;
+      if (packet->hdr.flags & PACKET_FLAG_CONFIG)
+      {
+         if (bodyLen <= fixedLen)
+         {
+            return PACKET_TYPE_INVALID;
+         }
+         packet->body.status.configAck = frame[PACKET_HEADER_SIZE + fixedLen++];
+      }
+      packet->body.status.chanLen = 0;
+      if (packet->hdr.flags & PACKET_FLAG_CHANNELS)
+      {
+         if ((bodyLen - fixedLen) > PACKET_CHAN_SIZE)
+         {
+            return PACKET_TYPE_INVALID;
+         }
+         packet->body.status.chanLen = bodyLen - fixedLen;
+         packetCopy (&(frame[PACKET_HEADER_SIZE + fixedLen]), packet->body.status.chan, packet->body.status.chanLen);
+      }
+   }
+   
+   return (PACKET_TYPE)type;
+}
+
+/*! \brief Compara dois IDs de sensor.
+ *   \return 1 se sao iguais
+ */
+char packetIdMatch (const unsigned char * id1, const unsigned char * id2)
+{
+   for (unsigned char i = 0; i < PACKET_ID_SIZE; i++)
+   {
+      if (id1[i] != id2[i])
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+/*! \brief Calcula as chaves das redes e comeca uma nova epoca do contador de quadros (a cada
+ *   boot), para que nenhum valor do contador se repita com a mesma chave. epochSave grava a
+ *   epoca na flash; e chamada aqui e quando a contagem da epoca da a volta.
+ *   secret e o segredo da instalacao (AES_KEY_SIZE bytes, igual no AP e nos EDs), ou 0 se nao
+ *   foi gravado: a chave de cada rede e a de fabrica cifrada com o segredo. A rede de
+ *   pareamento fica sempre com a chave de fabrica, para parear qualquer produto.
+ */
+void packetSecurityInit (unsigned short epoch, void (* epochSave)(unsigned short epoch), const unsigned char * secret)
+{
+#ifdef PACKET_SECURITY
+   for (unsigned char n = 0; n < RADIO_NETWORK_COUNT; n++)
+   {
+      if ((secret != 0) && (n != RADIO_NETWORK_PAIRING))
+      {
+         aesEncrypt (secret, PACKET_NETWORK_KEYS[n], packetKeys[n]);
+      }
+      else
+      {
+         packetCopy ((unsigned char *)PACKET_NETWORK_KEYS[n], packetKeys[n], AES_KEY_SIZE);
+      }
+   }
+   packetEpoch = epoch;
+   packetEpochSave = epochSave;
+   packetEpochNext();
+#else
+   (void)epoch;
+   (void)epochSave;
+   (void)secret;
+#endif
+}
+
+/*! \brief Passa para a proxima epoca do contador de quadros e grava. O AP so aceita de um ED,
+ *   depois de reiniciar, epocas mais novas que a ultima que gravou; o ED chama quando a epoca
+ *   dos quadros do AP muda (o AP reiniciou).
+ */
+void packetEpochNext (void)
+{
+#ifdef PACKET_SECURITY
+   ++packetEpoch;
+   packetCount = 0;
+   packetEpochSave(packetEpoch);
+#endif
+}
+
+/*! \brief Escolhe a rede (e a chave) dos pacotes montados e lidos a seguir. Deve acompanhar
+ *   o setNetwork do radio.
+ */
+void packetSetNetwork (unsigned char netId)
+{
+#ifdef PACKET_SECURITY
+   if (netId < RADIO_NETWORK_COUNT)
+   {
+      packetNetId = netId;
+   }
+#else
+   (void)netId;
+#endif
+}
+
+/*! \brief Confere se o contador de um pacote recebido e mais novo que o ultimo aceito do
+ *   mesmo transmissor e, se for, guarda. Sem PACKET_SECURITY aceita sempre.
+ *   \return 1 se o pacote e novo, 0 se e repetido (reenvio de um pacote gravado)
+ */
+char packetCounterFresh (unsigned long counter, unsigned long * last)
+{
+#ifdef PACKET_SECURITY
+   if (counter <= *last)
+   {
+      return 0;
+   }
+   *last = counter;
+#else
+   (void)counter;
+   (void)last;
+#endif
+   return 1;
+}
+
+/*! \brief Confere se um sensor do tipo e da zona dados pertence ao grupo.
+ *   \return 1 se pertence
+ */
+char packetGroupMatch (unsigned char group, unsigned char sensorType, unsigned char zone)
+{
+   if (group == PACKET_GROUP_ALL)
+   {
+      return 1;
+   }
+   if (group & PACKET_GROUP_TYPE)
+   {
+      return (group & ~PACKET_GROUP_TYPE) == (sensorType & ~PACKET_GROUP_TYPE);
+   }
+   return (zone != 0) && (group == zone);
+}
+
+/*! \brief Acrescenta um registro de canal ao STATUS (PACKET_FLAG_CHANNELS): o valor absoluto,
+ *   ou a diferenca para o ultimo confirmado se delta.
+ *   \return 1 se coube, 0 se os registros ja estao cheios
+ */
+char packetChanPut (PACKET_STATUS * status, PACKET_CHAN chan, char delta, signed short value)
+{
+   unsigned short zigzag = ((unsigned short)value << 1) ^ (unsigned short)(value >> 15);
+   unsigned char tag = ((unsigned char)chan << 4) | (delta ? PACKET_CHAN_DELTA : 0);
+   unsigned char len = 1;
+   
+   if (zigzag >= PACKET_CHAN_INLINE)
+   { // tamanho do varint
+      for (unsigned short v = zigzag; v != 0; v >>= 7) ++len;
+   }
+   if (status->chanLen + len > PACKET_CHAN_SIZE)
+   {
+      return 0;
+   }
+   
+   if (zigzag < PACKET_CHAN_INLINE)
+   {
+      status->chan[status->chanLen++] = tag | (unsigned char)zigzag;
+      return 1;
+   }
+   status->chan[status->chanLen++] = tag | PACKET_CHAN_INLINE;
+   while (zigzag >= 0x80)
+   {
+      status->chan[status->chanLen++] = (unsigned char)zigzag | 0x80;
+      zigzag >>= 7;
+   }
+   status->chan[status->chanLen++] = (unsigned char)zigzag;
+   return 1;
+}
+
+/*! \brief Le o registro de canal na posicao pos dos registros do STATUS e avanca pos.
+ *   \return 1 se leu um registro, 0 no fim ou se o registro esta truncado
+ */
+char packetChanGet (PACKET_STATUS * status, unsigned char * pos, PACKET_CHAN * chan, char * delta, signed short * value)
+{
+   unsigned short zigzag;
+   unsigned char tag;
+   
+   if (*pos >= status->chanLen)
+   {
+      return 0;
+   }
+   tag = status->chan[(*pos)++];
+   *chan = (PACKET_CHAN)(tag >> 4);
+   *delta = (tag & PACKET_CHAN_DELTA) ? 1 : 0;
+   zigzag = tag & PACKET_CHAN_INLINE;
+   if (zigzag == PACKET_CHAN_INLINE)
+   {
+      unsigned char shift = 0;
+      unsigned char byte;
+      
+      zigzag = 0;
+      do
+      {
+         if ((*pos >= status->chanLen) || (shift > 14))
+         {
+            return 0;
+         }
+         byte = status->chan[(*pos)++];
+         zigzag |= (unsigned short)(byte & 0x7F) << shift;
+         shift += 7;
+      } while (byte & 0x80);
+   }
+   *value = (signed short)((zigzag >> 1) ^ (unsigned short)(-(signed short)(zigzag & 1)));
+   return 1;
+}
+
+/*! \brief Tamanho do corpo a transmitir: o do tipo, mais os eventos de um STATUS com
+ *   PACKET_FLAG_EVENTS ou os comandos de um SACK com PACKET_FLAG_CONFIG ou de um pacote de grupo
+ *   (o fim do STATUS e contado em packetTrailerLen).
+ */
+static unsigned char packetBodyLen (PACKET * packet)
+{
+   if (packet->hdr.type == PACKET_TYPE_GROUP)
+   {
+      if (packet->body.group.configCount > PACKET_CONFIG_COUNT)
+      {
+         packet->body.group.configCount = PACKET_CONFIG_COUNT;
+      }
+      return PACKET_GROUP_SIZE(packet->body.group.configCount);
+   }
+   if ((packet->hdr.type == PACKET_TYPE_SACK) && (packet->hdr.flags & PACKET_FLAG_CONFIG))
+   {
+      if (packet->body.sack.configCount > PACKET_CONFIG_COUNT)
+      {
+         packet->body.sack.configCount = PACKET_CONFIG_COUNT;
+      }
+      return PACKET_SACK_CONFIG_SIZE(packet->body.sack.configCount);
+   }
+   if ((packet->hdr.type == PACKET_TYPE_BEACON) && (packet->hdr.flags & PACKET_FLAG_CONFIG))
+   {
+      return sizeof(PACKET_BEACON);
+   }
+   if ((packet->hdr.type == PACKET_TYPE_STATUS) && (packet->hdr.flags & PACKET_FLAG_EVENTS))
+   {
+      if (packet->body.status.eventCount > PACKET_EVENTS_MAX)
+      {
+         packet->body.status.eventCount = PACKET_EVENTS_MAX;
+      }
+      return PACKET_STATUS_EVENTS_SIZE(packet->body.status.eventCount);
+   }
+   return PACKET_BODY_SIZE[packet->hdr.type];
+}
+
+/*! \brief Tamanho do fim de um STATUS, depois dos eventos: o configAck (PACKET_FLAG_CONFIG) e
+ *   os registros de canais (PACKET_FLAG_CHANNELS).
+ */
+static unsigned char packetTrailerLen (PACKET * packet)
+{
+   unsigned char len = 0;
+   
+   if (packet->hdr.type != PACKET_TYPE_STATUS)
+   {
+      return 0;
+   }
+   if (packet->hdr.flags & PACKET_FLAG_CONFIG)
+   {
+      ++len;
+   }
+   if (packet->hdr.flags & PACKET_FLAG_CHANNELS)
+   {
+      if (packet->body.status.chanLen > PACKET_CHAN_SIZE)
+      {
+         packet->body.status.chanLen = PACKET_CHAN_SIZE;
+      }
+      len += packet->body.status.chanLen;
+   }
+   return len;
+}
+
+/*! \brief Copia bytes do corpo entre o pacote e o quadro. */
+static void packetCopy (const unsigned char * dataIn, unsigned char * dataOut, unsigned char len)
+{
+   for (unsigned char i = 0; i < len; i++)
+   {
+      dataOut[i] = dataIn[i];
+   }
+}
+
+#ifdef PACKET_SECURITY
+/*! \brief Proximo valor do contador de quadros; passa para a proxima epoca (e grava) quando
+ *   a contagem da volta.
+ */
+static unsigned long packetNextCounter (void)
+{
+   if (++packetCount == 0)
+   {
+      ++packetEpoch;
+      packetEpochSave(packetEpoch);
+   }
+   return ((unsigned long)packetEpoch << 16) | packetCount;
+}
+
+/*! \brief Nonce do CCM: origem e contador do transmissor, o resto em zero. Os EDs ainda sem
+ *   endereco (pareamento) compartilham a origem 0 e tem contadores que se repetem entre eles;
+ *   nesse caso o ID do ED (id, aberto no inicio do corpo) completa o nonce.
+ */
+static void packetNonce (unsigned char src, unsigned long counter, const unsigned char * id, unsigned char * nonce)
+{
+   nonce[0] = src;
+   nonce[1] = (unsigned char)(counter >> 24);
+   nonce[2] = (unsigned char)(counter >> 16);
+   nonce[3] = (unsigned char)(counter >> 8);
+   nonce[4] = (unsigned char)counter;
+   for (unsigned char i = 5; i < AES_CCM_NONCE_SIZE; i++)
+   {
+      nonce[i] = 0;
+   }
+   if (src == RADIO_ADDR_BROADCAST)
+   {
+      for (unsigned char i = 0; i < PACKET_ID_SIZE; i++)
+      {
+         nonce[5 + i] = id[i];
+      }
+   }
+}
+#endif
+
+/*! \brief Embaralha (ou desembaralha) o corpo do pacote com a semente fixa. Com
+ *   PACKET_WHITENING_ONLY so copia: o whitening do radio ja espalha o espectro. Com
+ *   PACKET_SECURITY tambem so copia, o corpo cifrado ja e aleatorio.
+ */
+static void packetCodeBody (unsigned char * dataIn, unsigned char * dataOut, unsigned char len, char scramble)
+{
+#if defined(PACKET_WHITENING_ONLY) || defined(PACKET_SECURITY)
+   (void)scramble;
+   for (unsigned char i = 0; i < len; i++)
+   {
+      dataOut[i] = dataIn[i];
+   }
+#else
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   
+   if (scramble)
+   {
+      scrambler (dataIn, dataOut, len, seed);
+   }
+   else
+   {
+      descrambler (dataIn, dataOut, len, seed);
+   }
+#endif
+}
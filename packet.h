@@ -0,0 +1,226 @@
+/*! \file packet.h
+ *  \brief interface publica para o formato binario dos pacotes (versao 2), comum ao AP e aos EDs.
+ *
+ *  No ar: tamanho, destino, versao/tipo, flags, sequencia, origem e o corpo do tipo, embaralhado
+ *  com a semente fixa do scrambler. O destino fica no segundo byte por causa do filtro de
+ *  endereco do radio, e a integridade e garantida pelo CRC do radio.
+ *
+ *  Com PACKET_SECURITY o cabecalho ganha o contador de quadros do transmissor e o corpo e
+ *  cifrado com AES-CCM na chave da rede, seguido do MIC: tamanho, destino, versao/tipo,
+ *  flags, sequencia, origem, contador (4 bytes), corpo cifrado e MIC. O cabecalho inteiro
+ *  entra no MIC, e o nonce e a origem com o contador. Nos pacotes com origem 0 (ED sem
+ *  endereco: DISC e STATUS) o ID do ED no inicio do corpo vai aberto, entra no MIC com o
+ *  cabecalho e completa o nonce. A chave de cada rede vem do segredo da instalacao, gravado
+ *  no AP e nos EDs (packetSecurityInit).
+ */
+
+// defina PACKET_WHITENING_ONLY para nao usar o scrambler e contar so com o whitening do radio
+// (PKTCTRL0.WHITE_DATA); o AP e os EDs tem que usar a mesma opcao
+// defina PACKET_SECURITY para cifrar e autenticar os pacotes (AES-CCM, aes.c); tambem tem
+// que ser igual no AP e nos EDs
+
+#include "aes.h"
+
+#define PACKET_VERSION      2
+#ifdef PACKET_SECURITY
+#define PACKET_COUNTER_SIZE 4        // contador de quadros: epoca (boot) e quadro dentro da epoca
+#define PACKET_MIC_SIZE     AES_CCM_MIC_SIZE
+#else
+#define PACKET_COUNTER_SIZE 0
+#define PACKET_MIC_SIZE     0
+#endif
+#define PACKET_HEADER_SIZE  (6 + PACKET_COUNTER_SIZE) // tamanho, destino, versao/tipo, flags, sequencia, origem (e contador)
+#define PACKET_FRAME_SIZE(bodyLen) (PACKET_HEADER_SIZE + (bodyLen) + PACKET_MIC_SIZE) // pacote completo, como vai para a FIFO
+#define PACKET_SIZE(body)   PACKET_FRAME_SIZE(sizeof(body))
+#define PACKET_ID_SIZE      4        // ID do sensor
+#define PACKET_SLOT_COUNT   24       // slots de TDMA do beacon (um por endereco de ED)
+
+// flags
+#define PACKET_FLAG_RETRY   0x01     // enviado depois de um ACK perdido
+#define PACKET_FLAG_SLOTTED 0x02     // STATUS no slot de TDMA: confirmado pelo ackMap do proximo beacon, sem SACK
+#define PACKET_FLAG_EVENTS  0x04     // STATUS com os eventos guardados pelo ED (PACKET_STATUS_EVENTS_SIZE)
+#define PACKET_FLAG_CHANNELS 0x08    // STATUS: registros de canais no fim do corpo; SACK: o AP nao tem a base
+                                     // dos deltas, o ED deve mandar os valores absolutos
+#define PACKET_FLAG_CONFIG  0x10     // SACK: comandos de configuracao para o ED (PACKET_SACK_CONFIG_SIZE);
+                                     // STATUS: configAck depois dos eventos; BEACON: pendMap
+
+typedef enum
+{
+   PACKET_TYPE_INVALID = 0,
+   PACKET_TYPE_DISC,                 // ED -> AP: pareamento / procura do AP
+   PACKET_TYPE_DACK,                 // AP -> ED: resposta ao pareamento com rede, endereco e perfil
+   PACKET_TYPE_STATUS,               // ED -> AP: relatorio de status
+   PACKET_TYPE_SACK,                 // AP -> ED: confirmacao do STATUS ou do DISC
+   PACKET_TYPE_POLL,                 // AP -> ED: pedido de status (com preambulo longo, ED em WOR)
+   PACKET_TYPE_BEACON,               // AP -> todos: relogio, slots e ACK em grupo (preambulo longo so de tempos em tempos)
+   PACKET_TYPE_GROUP,                // AP -> grupo: pedido de status e/ou configuracao (com preambulo longo)
+   PACKET_TYPE_COUNT
+} PACKET_TYPE;
+
+typedef struct
+{
+   unsigned char  type;              // PACKET_TYPE
+   unsigned char  flags;
+   unsigned char  seq;               // numero de sequencia do transmissor
+   unsigned char  dst;               // endereco de destino (filtro do radio)
+   unsigned char  src;               // endereco de origem
+   unsigned long  counter;           // contador de quadros do transmissor (0 sem PACKET_SECURITY)
+} PACKET_HEADER;
+
+typedef struct
+{
+   unsigned char  id[PACKET_ID_SIZE];
+   unsigned char  sensorType;
+} PACKET_DISC;
+
+typedef struct
+{
+   unsigned char  id[PACKET_ID_SIZE];
+   unsigned char  netId;             // rede do AP
+   unsigned char  address;           // endereco atribuido ao sensor
+   unsigned char  phy;               // perfil de camada fisica da rede
+   unsigned char  sensorType;
+} PACKET_DACK;
+
+#define PACKET_EVENTS_MAX   8        // eventos em um STATUS
+
+typedef struct
+{
+   unsigned char  value;             // valor do sensor depois da mudanca ('F' normal, '0' alarme)
+   unsigned char  age[2];            // segundos antes da transmissao (byte mais significativo primeiro)
+} PACKET_EVENT;
+
+// canais de medida do STATUS (PACKET_FLAG_CHANNELS). Cada registro e uma etiqueta e, se o valor
+// nao couber nela, um varint: etiqueta = canal (4 bits), delta (1 bit) e valor (3 bits). O valor
+// vai em zigzag (0, -1, 1, -2, ...): 0 a 6 direto na etiqueta, 7 = varint de 7 bits por byte
+// (bit 7 = continua) em seguida. O delta e em relacao ao ultimo valor confirmado pelo SACK; canal
+// sem mudanca nao e enviado.
+#define PACKET_CHAN_SIZE     16      // bytes de registros em um STATUS
+#define PACKET_CHAN_DELTA    0x08
+#define PACKET_CHAN_INLINE   7       // valor no varint seguinte
+
+typedef enum
+{
+   PACKET_CHAN_CONTACT = 0,          // contato (0 normal, 1 alarme)
+   PACKET_CHAN_LEVEL,                // nivel analogico (contagem do A/D)
+   PACKET_CHAN_BATTERY,              // tensao da bateria (mV)
+   PACKET_CHAN_TEMPERATURE,          // temperatura (0,1 grau C)
+   PACKET_CHAN_COUNT
+} PACKET_CHAN;
+
+typedef struct
+{
+   unsigned char  id[PACKET_ID_SIZE];
+   unsigned char  sensorType;
+   unsigned char  value[2];          // valor do sensor ('F','F' normal, '0','0' alarme)
+   unsigned char  paLevel;           // nivel de potencia de transmissao do sensor
+   // so com PACKET_FLAG_EVENTS: mudancas de valor ainda nao confirmadas pelo AP, a mais antiga primeiro
+   unsigned char  eventSeq;          // numero do primeiro evento (os seguintes sao consecutivos)
+   unsigned char  eventCount;
+   PACKET_EVENT   events[PACKET_EVENTS_MAX];
+   // so com PACKET_FLAG_CONFIG: configSeq dos ultimos comandos aplicados (depois dos eventos)
+   unsigned char  configAck;
+   // so com PACKET_FLAG_CHANNELS: registros dos canais, ate o fim do corpo (chanLen nao vai no ar)
+   unsigned char  chanLen;
+   unsigned char  chan[PACKET_CHAN_SIZE];
+} PACKET_STATUS;
+
+#define PACKET_STATUS_BASE_SIZE       8   // STATUS sem eventos
+#define PACKET_STATUS_EVENTS_SIZE(n)  (PACKET_STATUS_BASE_SIZE + 2 + ((n) * sizeof(PACKET_EVENT)))
+
+// comandos de configuracao do SACK (PACKET_FLAG_CONFIG); cada um so define um valor, entao
+// repetir o mesmo comando nao muda nada
+typedef enum
+{
+   PACKET_CONFIG_INTERVAL = 0,       // intervalo entre relatorios (s, 0 = padrao do sensor)
+   PACKET_CONFIG_PA_MAX,             // nivel maximo do controle de potencia de transmissao
+   PACKET_CONFIG_CHANNEL,            // canal de radio (o AP muda depois, pelo comando da serial; o ED
+                                     // passa para o novo quando os ACKs param de chegar no atual)
+   PACKET_CONFIG_ZONE,               // zona do sensor para os pacotes de grupo (0 = sem zona)
+   PACKET_CONFIG_COUNT
+} PACKET_CONFIG;
+
+typedef struct
+{
+   unsigned char  type;              // PACKET_CONFIG
+   unsigned char  value[2];          // byte mais significativo primeiro
+} PACKET_CONFIG_ITEM;
+
+typedef struct
+{
+   unsigned char  ackSeq;            // sequencia do pacote confirmado
+   signed char    rssi;              // RSSI do pacote do sensor no AP (dBm)
+   unsigned char  phy;               // perfil de camada fisica que o sensor deve usar
+   // so com PACKET_FLAG_CONFIG: comandos pendentes para o sensor, confirmados pelo configAck do STATUS
+   unsigned char  configSeq;
+   unsigned char  configCount;
+   PACKET_CONFIG_ITEM config[PACKET_CONFIG_COUNT];
+} PACKET_SACK;
+
+#define PACKET_SACK_BASE_SIZE         3   // SACK sem comandos
+#define PACKET_SACK_CONFIG_SIZE(n)    (PACKET_SACK_BASE_SIZE + 2 + ((n) * sizeof(PACKET_CONFIG_ITEM)))
+
+typedef struct
+{
+   unsigned char  id[PACKET_ID_SIZE];
+} PACKET_POLL;
+
+// o slot n e o do endereco RADIO_ADDR_ED_FIRST + n; com cabecalho e MIC o beacon cabe no
+// quadro de 24 bytes do perfil com FEC
+typedef struct
+{
+   unsigned short time;              // relogio do AP na transmissao (ticks de 10 ms, 16 bits baixos)
+   unsigned char  period;            // intervalo entre beacons (100 ms)
+   unsigned char  slotLen;           // duracao de um slot (10 ms); o slot 0 comeca um slot depois do beacon
+   unsigned char  slots;             // slots na janela (ate o maior endereco atribuido)
+   unsigned char  phy;               // perfil de camada fisica que os sensores devem usar
+   unsigned char  ackMap[PACKET_SLOT_COUNT / 8]; // STATUS no slot recebidos na janela anterior: bit n = slot n
+   // so com PACKET_FLAG_CONFIG: sensores com comandos ou pedido de canais esperando um SACK; o
+   // proximo STATUS deles vai fora do slot (nao cabe no quadro do perfil com FEC e PACKET_SECURITY)
+   unsigned char  pendMap[PACKET_SLOT_COUNT / 8];
+} PACKET_BEACON;
+
+#define PACKET_BEACON_BASE_SIZE    (sizeof(PACKET_BEACON) - (PACKET_SLOT_COUNT / 8)) // beacon sem o pendMap
+
+// enderecos de grupo: o filtro do radio so aceita o endereco proprio e o broadcast, entao o
+// pacote de grupo vai para RADIO_ADDR_BROADCAST e o grupo e conferido pelo ED (packetGroupMatch)
+#define PACKET_GROUP_ALL       0xFF  // todos os sensores da rede
+#define PACKET_GROUP_TYPE      0x80  // 0x80 | tipo do sensor (7 bits baixos)
+#define PACKET_GROUP_ZONE_MAX  0x7F  // 0x01 a 0x7F: zona gravada no sensor (PACKET_CONFIG_ZONE)
+
+typedef struct
+{
+   unsigned char  group;             // endereco do grupo
+   unsigned char  poll;              // 1: os sensores do grupo mandam um STATUS
+   unsigned char  configCount;       // comandos de configuracao aplicados pelo grupo (sem confirmacao)
+   PACKET_CONFIG_ITEM config[PACKET_CONFIG_COUNT];
+} PACKET_GROUP;
+
+#define PACKET_GROUP_SIZE(n)   (3 + ((n) * sizeof(PACKET_CONFIG_ITEM)))
+
+typedef struct
+{
+   PACKET_HEADER  hdr;
+   union
+   {
+      PACKET_DISC    disc;
+      PACKET_DACK    dack;
+      PACKET_STATUS  status;
+      PACKET_SACK    sack;
+      PACKET_POLL    poll;
+      PACKET_BEACON  beacon;
+      PACKET_GROUP   group;
+   } body;
+} PACKET;
+
+void packetSetHeader (PACKET * packet, PACKET_TYPE type, unsigned char flags, unsigned char seq, unsigned char dst, unsigned char src);
+unsigned char packetBuild (PACKET * packet, unsigned char * frame);
+PACKET_TYPE packetParse (unsigned char * frame, unsigned char len, PACKET * packet);
+char packetIdMatch (const unsigned char * id1, const unsigned char * id2);
+void packetSecurityInit (unsigned short epoch, void (* epochSave)(unsigned short epoch), const unsigned char * secret);
+void packetEpochNext (void);
+void packetSetNetwork (unsigned char netId);
+char packetCounterFresh (unsigned long counter, unsigned long * last);
+char packetGroupMatch (unsigned char group, unsigned char sensorType, unsigned char zone);
+char packetChanPut (PACKET_STATUS * status, PACKET_CHAN chan, char delta, signed short value);
+char packetChanGet (PACKET_STATUS * status, unsigned char * pos, PACKET_CHAN * chan, char * delta, signed short * value);
@@ -4,100 +4,193 @@
 
 #include "cc430x513x.h"
 #include "radio.h"
+#include "rf1a.h"
 
 // MACROS
 #define ENTER_CRITICAL_SECTION(x)         { x = __get_interrupt_state(); __disable_interrupt(); }
 #define EXIT_CRITICAL_SECTION(x)          __set_interrupt_state(x)
-#define MRFI_RADIO_INST_WRITE_WAIT()      while( !(RF1AIFCTL1 & RFINSTRIFG));
-#define MRFI_RADIO_DATA_WRITE_WAIT()      while( !(RF1AIFCTL1 & RFDINIFG)  );
-#define MRFI_RADIO_STATUS_READ_CLEAR()    RF1AIFCTL1 &= ~(RFSTATIFG);
 
 // defines
-#define BSP_TIMER_CLK_MHZ   12       // 12 MHz MCLKC and SMCLK
 #define MAX_RXFIFO_SIZE     (64u)
-// PATABLE ANTIGO (Verificar por que funcionava) TODO
-//#define SETTING_PATABLE     0x8D
-// max dBm
-#define SETTING_PATABLE     0xC0
-// +10dBm
-//#define SETTING_PATABLE     0xC6
-// 0dB
-//#define SETTING_PATABLE     0x50
-// -6dBm
-//#define SETTING_PATABLE     0x2D
-
-// Configuracao do radio 
-const unsigned char RF1A_REG_SMARTRF_SETTING[][2] =
+#define MAX_TXFIFO_SIZE     (64u)
+#define RADIO_CCA_TIMEOUT_US 10000   // tempo maximo entre o STX e o inicio da transmissao
+#define RADIO_BACKOFF_MAX_US 40000   // limite da temporizacao do TA0
+#define RADIO_PREAMBLE_STEP_MS 40    // o preambulo longo e temporizado em passos que cabem no TA0
+#define RADIO_MCSM0_MANUAL_CAL 0x08  // PO_TIMEOUT = 2, FS_AUTOCAL = 0: a calibracao e feita pelo driver
+#define RADIO_WORCTRL_WOR    0x78    // RC_PD = 0 (oscilador RC ligado), EVENT1 = 7, RC_CAL = 1, WOR_RES = 0
+#define RADIO_REG_NOT_RETAINED FSTEST  // FSTEST, PTEST, AGCTEST e TEST2..0 se perdem no SLEEP
+#define RADIO_IFG_PA_PD     BIT0     // RFIFG0: GDO0 = PA_PD (IOCFG0 = 0x1B), desce quando a transmissao comeca
+#define RADIO_IN_RSSI_VALID BIT1     // RFIN1: GDO1 = RSSI valido (IOCFG1 = 0x1E)
+#define RADIO_IFG_END_OF_PACKET BIT9 // RFIFG9: sync word recebido / fim do pacote
+#define RADIO_IFG_SYNC          BIT2 // RFIFG2: GDO2 = palavra de sincronismo (IOCFG2 = 0x06)
+#define RADIO_IFG_RX_THRESHOLD  BIT3 // RFIFG3: FIFO de rx acima do limiar (FIFOTHR, 32 bytes)
+#define RADIO_IFG_TX_THRESHOLD  BIT5 // RFIFG5: FIFO de tx acima do limiar (FIFOTHR, 33 bytes)
+#define RADIO_TXBYTES_UNDERFLOW 0x80 // bit de underflow no registrador TXBYTES
+#define RADIO_RSSI_OFFSET   74       // offset do RSSI em 433 MHz (datasheet do CC1101)
+#define RADIO_LQI_CRC_OK    0x80     // bit CRC_OK no segundo byte de status
+// niveis de potencia de transmissao (valores do PATABLE em 433 MHz), do menor para o maior
+const unsigned char RADIO_PA_TABLE[RADIO_PA_LEVELS] = {0x12, 0x0E, 0x1D, 0x34, 0x2D, 0x50, 0x84, 0xC8, 0xC0};
+const signed char   RADIO_PA_DBM[RADIO_PA_LEVELS]   = { -30,  -20,  -15,  -10,   -6,    0,    5,    7,   10};
+// corrente de transmissao de cada nivel em 0,1 mA (aproximada do datasheet do CC1101 em 433 MHz)
+const unsigned short RADIO_PA_CURRENT[RADIO_PA_LEVELS] = {120, 128, 135, 141, 145, 159, 199, 258, 292};
+
+// registradores que mudam com o perfil de camada fisica (SmartRF Studio, 433 MHz, cristal de 26 MHz)
+typedef struct
+{
+   unsigned char  fsctrl1;
+   unsigned char  mdmcfg4;
+   unsigned char  mdmcfg3;
+   unsigned char  deviatn;
+   unsigned char  foccfg;
+   unsigned char  bscfg;
+   unsigned char  agcctrl2;
+   unsigned char  agcctrl1;          // so o nibble alto, o baixo e o limiar do carrier sense
+   unsigned char  agcctrl0;
+   unsigned char  frend1;
+   unsigned char  test2;
+   unsigned char  test1;
+   unsigned char  fec;               // FEC e interleaving (MDMCFG1.FEC_EN), exige pacote de tamanho fixo
+   unsigned short byteTime;          // duracao de um byte no ar em 1/8 us
+} RADIO_PHY_PROFILE;
+
+const RADIO_PHY_PROFILE RADIO_PHY_PROFILES[RADIO_PHY_COUNT] =
+{ //  FSCTRL1 MDMCFG4 MDMCFG3 DEVIATN FOCCFG BSCFG AGCCTRL2 AGCCTRL1 AGCCTRL0 FREND1 TEST2 TEST1 FEC  byte
+   {  0x0C,   0x2D,   0x3B,   0x62,   0x1D,  0x1C, 0xC7,    0x00,    0xB0,    0xB6,  0x88, 0x31, 0,   256}, // 250 kbps, desvio 127 kHz, filtro 541 kHz
+   {  0x06,   0xCA,   0x83,   0x35,   0x16,  0x6C, 0x43,    0x40,    0x91,    0x56,  0x81, 0x35, 0,  1667}, // 38,4 kbps, desvio 20 kHz, filtro 100 kHz
+   {  0x06,   0xF5,   0x83,   0x15,   0x16,  0x6C, 0x03,    0x40,    0x91,    0x56,  0x81, 0x35, 0, 53333}, // 1,2 kbps, desvio 5,2 kHz, filtro 58 kHz
+   {  0x06,   0xCA,   0x83,   0x35,   0x16,  0x6C, 0x43,    0x40,    0x91,    0x56,  0x81, 0x35, 1,  1667}  // 38,4 kbps com FEC (19,2 kbps de dados)
+};
+
+// bytes do pacote no ar alem dos escritos na FIFO: preambulo (MDMCFG1), sync word duplo (30/32) e CRC
+#define RADIO_FRAME_OVERHEAD (4 + 4 + 2)
+#define RADIO_FRAME_SYNC     (4 + 4)     // parte do pacote que nao passa pelo FEC
+#define RADIO_MDMCFG1_FEC_EN 0x80
+#define RADIO_PKTCTRL0_LENGTH 0x03       // LENGTH_CONFIG: 0 = tamanho fixo (PKTLEN), 1 = variavel
+#define RADIO_PKTCTRL1_ADR_CHK 0x03      // filtro de endereco do radio (no tamanho fixo olharia o byte de tamanho)
+
+// Palavras de sincronismo de cada rede: 8 bits em 1, sem sequencias longas, autocorrelacao
+// baixa e distancia de Hamming >= 6 entre si (>= 12 nos 32 bits do modo 30/32)
+const unsigned char RADIO_SYNC_WORDS[RADIO_NETWORK_COUNT][2] =
+{
+   {0xD3, 0x91},
+   {0x1D, 0x6C},
+   {0x25, 0x73},
+   {0x2E, 0x9C},
+   {0xE5, 0x4C},
+   {0x32, 0x57},
+   {0x35, 0xB8},
+   {0xCE, 0xA4}
+};
+
+// Configuracao do radio: imagem continua dos registradores IOCFG2 (0x00) ate TEST0 (0x2E),
+// escrita de uma vez so com acesso em burst
+const unsigned char RF1A_REG_SMARTRF_SETTING[RADIO_CONFIG_REG_COUNT] =
 { // internal radio configuration
-  {  IOCFG0,    0x1B  },
-  {  IOCFG1,    0x1E  },
-  {  IOCFG2,    0x29  },
-  {  MCSM2,     0x07  },  
-  {  MCSM1,     0x3C  },
-  {  MCSM0,     0x18  },
-  {  SYNC1,     0xD3  },
-  {  SYNC0,     0x91  },
-  {  PKTLEN,    0xFE  },
-  {  PKTCTRL1,  0x05  },
-  {  PKTCTRL0,  0x45  },
-  {  ADDR, 	0x00  },
-  {  FIFOTHR,   0x07  },
-  {  WOREVT1,   0x87  },  
-  {  WOREVT0,   0x6B  },   
-  {  WORCTRL,   0xF8  },
-  {  CHANNR,    0x00  },
-  {  FSCTRL1,   0x0C  },
-  {  FSCTRL0,   0x00  },
-  {  FREQ2,     0x10  },
-  {  FREQ1,     0xB0  },
-  {  FREQ0,     0x71  },
-  {  MDMCFG4,   0x2D  },
-  {  MDMCFG3,   0x3B  },
-  {  MDMCFG2,   0x13  },
-  {  MDMCFG1,   0x22  },
-  {  MDMCFG0,   0xF8  },
-  {  DEVIATN,   0x62  },
-  {  FOCCFG,    0x1D  },
-  {  BSCFG,     0x1C  },
-  {  AGCCTRL2,  0xC7  },
-  {  AGCCTRL1,  0x00  },
-  {  AGCCTRL0,  0xB0  },
-  {  FREND1,    0xB6  },
-  {  FREND0,    0x10  },
-  {  FSCAL3,    0xEA  },
-  {  FSCAL2,    0x2A  },
-  {  FSCAL1,    0x00  },
-  {  FSCAL0,    0x1F  },
-  {  AGCTEST,   0x88  },
-  {  PTEST,     0x7F  },
-  {  FSTEST,    0x59  },
-  {  TEST2,     0x88  },
-  {  TEST1,     0x31  },
-  {  TEST0,     0x09  },
+   0x06,  // IOCFG2 (palavra de sincronismo, para o timestamp)
+   0x1E,  // IOCFG1
+   0x1B,  // IOCFG0
+   0x07,  // FIFOTHR
+   0xD3,  // SYNC1
+   0x91,  // SYNC0
+   0xFE,  // PKTLEN
+   0x06,  // PKTCTRL1
+   0x45,  // PKTCTRL0
+   0x00,  // ADDR
+   0x00,  // CHANNR
+   0x0C,  // FSCTRL1
+   0x00,  // FSCTRL0
+   0x10,  // FREQ2
+   0xB0,  // FREQ1
+   0x71,  // FREQ0
+   0x2D,  // MDMCFG4
+   0x3B,  // MDMCFG3
+   0x13,  // MDMCFG2
+   0x22,  // MDMCFG1
+   0xF8,  // MDMCFG0
+   0x62,  // DEVIATN
+   0x07,  // MCSM2
+   0x3C,  // MCSM1
+   0x18,  // MCSM0
+   0x1D,  // FOCCFG
+   0x1C,  // BSCFG
+   0xC7,  // AGCCTRL2
+   0x00,  // AGCCTRL1
+   0xB0,  // AGCCTRL0
+   0x87,  // WOREVT1
+   0x6B,  // WOREVT0
+   0xF8,  // WORCTRL
+   0xB6,  // FREND1
+   0x10,  // FREND0
+   0xEA,  // FSCAL3
+   0x2A,  // FSCAL2
+   0x00,  // FSCAL1
+   0x1F,  // FSCAL0
+   0x41,  // RCCTRL1 (valor de reset)
+   0x00,  // RCCTRL0 (valor de reset)
+   0x59,  // FSTEST
+   0x7F,  // PTEST
+   0x88,  // AGCTEST
+   0x88,  // TEST2
+   0x31,  // TEST1
+   0x09,  // TEST0
 };
 
 
+// CSMA padrao, usado ate o dono do radio configurar o seu (setCsma)
+const RADIO_CSMA_CONFIG RADIO_CSMA_DEFAULT = {1, 5, 4, 320, 0};
+
 // Prototipos das funcoes de apoio para a interface com o radio
-void BSP_Delay(unsigned short usec);
-void radioWriteReg(unsigned char addr, unsigned char value);
-unsigned char radioReadReg(unsigned char addr);
-void radioReadRxFifo(unsigned char * pData, unsigned char len);
-void radioWriteTxFifo(unsigned char * pData, unsigned char len);
+static void radioTimerStart(unsigned short usec);
+static char radioTimerExpired(void);
+static void radioTransmitFinish(RADIO * radio, RADIO_TX_STATUS status);
+static void radioBackoffStart(RADIO * radio);
+static void radioPreambleStep(RADIO * radio);
+static unsigned short radioRandom(RADIO * radio);
+static unsigned char radioDesiredReg(RADIO * radio, unsigned char addr);
+static void radioSetReg(RADIO * radio, unsigned char addr, unsigned char value);
+static void radioWake(RADIO * radio);
+static void radioTransmitBegin(RADIO * radio, unsigned char rxOnDone);
+static void radioRxRestart(void);
+static void radioCalibrate(RADIO * radio);
+static void radioCalibrateCheck(RADIO * radio);
+static void radioTxFifoLoad(RADIO * radio, unsigned char * data, unsigned char len);
+static unsigned char radioRxBytes(void);
+static char radioRxHeader(RADIO_PACKET * packet);
+static unsigned char radioTxCopy(RADIO * radio, unsigned char * data, unsigned char len);
 
 // Prototipos dos metodos do objeto radio
 void radioInit       (void * pradio);
 void radioPowerOff   (void * pradio);
+void radioSleep      (void * pradio);
 void radioReset      (void * pradio);
 void radioConfig     (void * pradio);
 void radioReceiveOn  (void * pradio);
 void radioReceiveOff (void * pradio);
 char radioTransmit   (void * pradio, unsigned char * data,  unsigned char len);
+char radioTransmitStart (void * pradio, unsigned char * data, unsigned char len, unsigned char rxOnDone);
+char radioTransmitWakeup (void * pradio, unsigned char * data, unsigned char len, unsigned short preambleMs, unsigned char rxOnDone);
+void radioWorStart   (void * pradio, unsigned short event0, unsigned char rxTime);
+char radioSetChannel (void * pradio, unsigned char channel);
+char radioSetNetwork (void * pradio, unsigned char netId, unsigned char address);
+char radioSetTxPower (void * pradio, unsigned char level);
+char radioSetPhy     (void * pradio, RADIO_PHY phy);
+unsigned long radioAirtime  (void * pradio, unsigned char len);
+unsigned long radioTxCharge (void * pradio, unsigned char len);
+void radioRun        (void * pradio);
+void radioSetCsma    (void * pradio, const RADIO_CSMA_CONFIG * csma);
+void radioSeedRandom (void * pradio, unsigned short seed);
 char radioGetData    (void * pradio, unsigned char * buff, unsigned char * len);
 
-void radioIsr(void);
+static void radioIsr(void);
+static void radioIsrRxFifo(void);
+static void radioIsrTxFifo(void);
+static void radioIsrSync(void);
 
 // Instancia do objeto radio
 extern RADIO radio1 = {radioInit};
+#ifdef RADIO_BUS_STATS
+static unsigned short rxBusStart;      // busOps no inicio do pacote em recepcao
+#endif
 
 // Implementacao dos metodos
 void radioInit       (void * pradio)
@@ -105,34 +198,132 @@ void radioInit       (void * pradio)
    RADIO * radio = (RADIO *)pradio;
    
    radio->powerOff = radioPowerOff;
+   radio->sleep = radioSleep;
    radio->reset = radioReset;
    radio->config = radioConfig;
    radio->receiveOn = radioReceiveOn;
    radio->receiveOff = radioReceiveOff;
    radio->transmit = radioTransmit;
    radio->getData = radioGetData;
+   radio->transmitStart = radioTransmitStart;
+   radio->transmitWakeup = radioTransmitWakeup;
+   radio->worStart = radioWorStart;
+   radio->setChannel = radioSetChannel;
+   radio->setNetwork = radioSetNetwork;
+   radio->setTxPower = radioSetTxPower;
+   radio->setPhy = radioSetPhy;
+   radio->airtime = radioAirtime;
+   radio->txCharge = radioTxCharge;
+   radio->run = radioRun;
+   radio->setCsma = radioSetCsma;
+   radio->seedRandom = radioSeedRandom;
+   radio->txDone = 0;
    
-   radio->isr = radioIsr;
+   // o CSMA, a potencia e os contadores sao mantidos entre reinicializacoes do radio (o ED
+   // reinicializa a cada vez que acorda); so sao zerados na partida
+   if (radio->csma.slotUs == 0)
+   {
+      radio->csma = RADIO_CSMA_DEFAULT;
+      radio->randState = 0xACE1;
+      radio->paLevel = RADIO_PA_LEVEL_MAX;
+      radio->rxQueueOverflow = 0;
+      radio->rxFifoOverflow = 0;
+      radio->rxCrcError = 0;
+      radio->txFifoUnderflow = 0;
+   }
    
    radio->state = RADIO_STATE_OFF;
-   radio->rxLen = 0;
+   radio->txState = RADIO_TX_STATE_IDLE;
+   radio->txStatus = RADIO_TX_STATUS_IDLE;
+   radio->txPreambleMs = 0;
+   radio->worEvent0 = 0;                // o init sai do modo WOR
+   radio->worWake = 0;
+   radio->rxPtrIn = 0;
+   radio->rxPtrOut = 0;
+   radio->rxStreamLen = 0;
+   radio->rxSyncTime = 0;
+   radio->txStreamLeft = 0;
+   radio->txUnderflow = 0;
+#ifdef RADIO_BUS_STATS
+   radio->busOps = 0;
+   radio->rxBusOps = 0;
+   radio->txBusOps = 0;
+#endif
    
-   radio->reset(radio);
+   if (radio->retained)
+   { // registradores mantidos no SLEEP: so acorda e escreve o que mudou
+      radioWake(radio);
+   }
+   else
+   {
+      radio->reset(radio);
+   }
    radio->config(radio);
    
+   // calibra o sintetizador se o canal atual nao tem calibracao guardada ou ela ficou velha
+   radioCalibrateCheck(radio);
+   
    radio->timer = 0;
 }
 
 void radioPowerOff   (void * pradio)
 {
+   RADIO * radio = (RADIO *)pradio;
+   
    RF1AIFG = 0;                  // Clear any radio pending interrupt
    radioStrobe(RF_SRES);         // Reset radio core
+   
+   // o reset perde a configuracao
+   radio->shadowValid = 0;
+   radio->paTable = 0;
+   radio->retained = 0;
+}
+
+/*! \brief Coloca o radio em SLEEP mantendo a configuracao, para um init rapido ao acordar. */
+void radioSleep      (void * pradio)
+{
+   unsigned char x;
+   RADIO * radio = (RADIO *)pradio;
+   
+   RF1AIE = 0;
+   do 
+   {
+      x = radioStrobe(RF_SIDLE);
+   } 
+   while (x&0x70);
+   radioStrobe(RF_SPWD);         // SLEEP: mantem os registradores e o PATABLE[0]
+   RF1AIFG = 0;
+   
+   radio->state = RADIO_STATE_OFF;
+   radio->retained = radio->shadowValid;
+}
+
+/*! \brief Acorda o radio do SLEEP e restaura os registradores que nao sao mantidos. */
+static void radioWake(RADIO * radio)
+{
+   unsigned char x;
+   
+   RF1AIFG = 0;
+   do 
+   {
+      x = radioStrobe(RF_SIDLE); // o strobe espera o cristal estabilizar
+   } 
+   while (x&0x70);
+   RF1AIFERR = 0;
+   
+   radioWriteBurstReg(RADIO_REG_NOT_RETAINED, &(radio->regShadow[RADIO_REG_NOT_RETAINED]), RADIO_CONFIG_REG_COUNT - RADIO_REG_NOT_RETAINED);
+   radio->retained = 0;
 }
 
 void radioReset      (void * pradio)
 {
    volatile unsigned short i;
    unsigned char x;
+   RADIO * radio = (RADIO *)pradio;
+   
+   radio->shadowValid = 0;
+   radio->paTable = 0;
+   radio->retained = 0;
 
    RF1AIFG = 0;                  // Clear any radio pending interrupt
    radioStrobe(RF_SRES);         // Reset radio core
@@ -147,41 +338,159 @@ void radioReset      (void * pradio)
 
 void radioConfig     (void * pradio)
 {
-   // Escreve o PA Table
-   unsigned char readbackPATableValue = 0;
-   unsigned short int_state;
+   RADIO * radio = (RADIO *)pradio;
+   
+   unsigned char first;
+   unsigned char i;
+   
+   // Escreve o PA Table (o valor e mantido no SLEEP, so grava se mudou)
+   unsigned char paTable = RADIO_PA_TABLE[radio->paLevel];
+   unsigned char readbackPATableValue = radio->paTable;
 
-   ENTER_CRITICAL_SECTION(int_state);
-   while (readbackPATableValue != SETTING_PATABLE)
+   while (readbackPATableValue != paTable)
    {
-      while (!(RF1AIFCTL1 & RFINSTRIFG)) ;
-      RF1AINSTRW = 0x7E00 + SETTING_PATABLE; // PA Table write (burst)
-      while (!(RF1AIFCTL1 & RFINSTRIFG)) ;
-      RF1AINSTRB = RF_SNOP;        // reset pointer
-      while (!(RF1AIFCTL1 & RFINSTRIFG)) ;
-      RF1AINSTRB = 0xFE;           // PA Table read (burst)
-      while (!(RF1AIFCTL1 & RFDINIFG)) ;
-      RF1ADINB = 0x00;             //dummy write
-      while (!(RF1AIFCTL1 & RFDOUTIFG)) ;
-      readbackPATableValue = RF1ADOUT0B;
-      while (!(RF1AIFCTL1 & RFINSTRIFG)) ;
-      RF1AINSTRB = RF_SNOP;
+      readbackPATableValue = radioWritePaTable(paTable);
+   }
+   radio->paTable = paTable;
+   
+   if (!radio->shadowValid)
+   { // configuracao desconhecida: escreve todos os registradores em uma unica escrita em burst
+      for (i = 0; i < RADIO_CONFIG_REG_COUNT; i++)
+      {
+         radio->regShadow[i] = radioDesiredReg(radio, i);
+      }
+      radioWriteBurstReg(IOCFG2, radio->regShadow, RADIO_CONFIG_REG_COUNT);
+      radio->shadowValid = 1;
+      return;
    }
-   EXIT_CRITICAL_SECTION(int_state);
    
-   // Inicializa os registradores de configuracao do radio
-   for (unsigned char i=0; i < (sizeof(RF1A_REG_SMARTRF_SETTING)/2); i++)
+   // escreve em burst somente os trechos de registradores diferentes da copia em RAM
+   i = 0;
+   while (i < RADIO_CONFIG_REG_COUNT)
+   {
+      if (radio->regShadow[i] == radioDesiredReg(radio, i))
+      {
+         ++i;
+         continue;
+      }
+      first = i;
+      while ((i < RADIO_CONFIG_REG_COUNT) && (radio->regShadow[i] != radioDesiredReg(radio, i)))
+      {
+         radio->regShadow[i] = radioDesiredReg(radio, i);
+         ++i;
+      }
+      radioWriteBurstReg(first, &(radio->regShadow[first]), i - first);
+   }
+}
+
+/*! \brief Valor desejado de um registrador de configuracao: a tabela SmartRF mais os ajustes do objeto. */
+static unsigned char radioDesiredReg(RADIO * radio, unsigned char addr)
+{
+   switch(addr)
    {
-      radioWriteReg(RF1A_REG_SMARTRF_SETTING[i][0], RF1A_REG_SMARTRF_SETTING[i][1]);
+      case AGCCTRL1: // limiar do carrier sense usado no CCA
+         return (RADIO_PHY_PROFILES[radio->phy].agcctrl1 & 0xF0) | (radio->csma.csThreshold & 0x0F);
+      case FSCTRL1:
+         return RADIO_PHY_PROFILES[radio->phy].fsctrl1;
+      case MDMCFG4:
+         return RADIO_PHY_PROFILES[radio->phy].mdmcfg4;
+      case MDMCFG3:
+         return RADIO_PHY_PROFILES[radio->phy].mdmcfg3;
+      case DEVIATN:
+         return RADIO_PHY_PROFILES[radio->phy].deviatn;
+      case FOCCFG:
+         return RADIO_PHY_PROFILES[radio->phy].foccfg;
+      case BSCFG:
+         return RADIO_PHY_PROFILES[radio->phy].bscfg;
+      case AGCCTRL2:
+         return RADIO_PHY_PROFILES[radio->phy].agcctrl2;
+      case AGCCTRL0:
+         return RADIO_PHY_PROFILES[radio->phy].agcctrl0;
+      case FREND1:
+         return RADIO_PHY_PROFILES[radio->phy].frend1;
+      case TEST2:
+         return RADIO_PHY_PROFILES[radio->phy].test2;
+      case TEST1:
+         return RADIO_PHY_PROFILES[radio->phy].test1;
+      case MDMCFG1:
+         return (RADIO_PHY_PROFILES[radio->phy].fec) ? (RF1A_REG_SMARTRF_SETTING[MDMCFG1] | RADIO_MDMCFG1_FEC_EN) : RF1A_REG_SMARTRF_SETTING[MDMCFG1];
+      case PKTCTRL0: // o FEC so funciona com pacote de tamanho fixo
+         return (RADIO_PHY_PROFILES[radio->phy].fec) ? (RF1A_REG_SMARTRF_SETTING[PKTCTRL0] & ~RADIO_PKTCTRL0_LENGTH) : RF1A_REG_SMARTRF_SETTING[PKTCTRL0];
+      case PKTLEN:
+         return (RADIO_PHY_PROFILES[radio->phy].fec) ? RADIO_FEC_FRAME_LEN : RF1A_REG_SMARTRF_SETTING[PKTLEN];
+      case PKTCTRL1: // no tamanho fixo o primeiro byte e o de tamanho: o endereco e conferido no radioIsr
+         return (RADIO_PHY_PROFILES[radio->phy].fec) ? (RF1A_REG_SMARTRF_SETTING[PKTCTRL1] & ~RADIO_PKTCTRL1_ADR_CHK) : RF1A_REG_SMARTRF_SETTING[PKTCTRL1];
+      case CHANNR:
+         return radio->channel;
+      case SYNC1:
+         return RADIO_SYNC_WORDS[radio->netId][0];
+      case SYNC0:
+         return RADIO_SYNC_WORDS[radio->netId][1];
+      case ADDR:
+         return radio->address;
+      case MCSM0: // sem calibracao automatica a cada IDLE -> RX/TX, os valores guardados sao usados
+         return RADIO_MCSM0_MANUAL_CAL;
+      case FSCAL3:
+      case FSCAL2:
+      case FSCAL1:
+         if (radio->fscalValid & (1 << radio->channel))
+         {
+            return radio->fscalCache[radio->channel][addr - FSCAL3];
+         }
+         // mantem o resultado da ultima calibracao
+         return (radio->shadowValid) ? radio->regShadow[addr] : RF1A_REG_SMARTRF_SETTING[addr];
+      case WOREVT1:
+         return (radio->worEvent0) ? (radio->worEvent0 >> 8) : RF1A_REG_SMARTRF_SETTING[WOREVT1];
+      case WOREVT0:
+         return (radio->worEvent0) ? (radio->worEvent0 & 0xFF) : RF1A_REG_SMARTRF_SETTING[WOREVT0];
+      case WORCTRL:
+         return (radio->worEvent0) ? RADIO_WORCTRL_WOR : RF1A_REG_SMARTRF_SETTING[WORCTRL];
+      case MCSM2: // no WOR: timeout de rx, encerrado antes se nao tiver portadora (RX_TIME_RSSI),
+                  // ou sem timeout (e sem RX_TIME_RSSI, que encerraria antes do pacote comecar)
+         if (radio->worEvent0 && ((radio->worRxTime & 0x07) == RADIO_WOR_RX_UNTIL_PACKET))
+         {
+            return RADIO_WOR_RX_UNTIL_PACKET;
+         }
+         return (radio->worEvent0) ? (0x10 | (radio->worRxTime & 0x07)) : RF1A_REG_SMARTRF_SETTING[MCSM2];
+      case MCSM1: // no WOR: volta para IDLE depois de receber um pacote (RXOFF_MODE = 0)
+         return (radio->worEvent0) ? (RF1A_REG_SMARTRF_SETTING[MCSM1] & ~0x0C) : RF1A_REG_SMARTRF_SETTING[MCSM1];
+      default:
+         return RF1A_REG_SMARTRF_SETTING[addr];
    }
 }
 
+/*! \brief Escreve um registrador de configuracao somente se ele for diferente da copia em RAM. */
+static void radioSetReg(RADIO * radio, unsigned char addr, unsigned char value)
+{
+   if (radio->shadowValid && (radio->regShadow[addr] == value))
+   {
+      return;
+   }
+   radioWriteReg(addr, value);
+   radio->regShadow[addr] = value;
+}
+
 void radioReceiveOn  (void * pradio)
 {
    RADIO * radio = (RADIO *)pradio;
    
+   if (radio->txState != RADIO_TX_STATE_IDLE)
+   { // liga a recepcao so quando terminar a transmissao em andamento
+      radio->txRxOnDone = 1;
+      return;
+   }
+   
    RF1AIFG =0;                         // Clear a pending interrupt
    radio->state = RADIO_STATE_RX_MODE;
+   radio->rxStreamLen = 0;
+   
+   // habilita a interrupcao de fim de pacote (borda de descida do RFIFG9),
+   // a de limiar da FIFO de rx (borda de subida do RFIFG3) para pacotes longos
+   // e a de palavra de sincronismo (borda de subida do RFIFG2) para o timestamp
+   RF1AIES |= RADIO_IFG_END_OF_PACKET;
+   RF1AIES &= ~(RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC);
+   RF1AIE  |= RADIO_IFG_END_OF_PACKET | RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC;
+   
    radioStrobe( RF_SRX );             
 }
 
@@ -190,7 +499,15 @@ void radioReceiveOff (void * pradio)
    unsigned char  x;
    RADIO * radio = (RADIO *)pradio;
    
+   if (radio->txState != RADIO_TX_STATE_IDLE)
+   { // o radio ja fica em IDLE no fim da transmissao em andamento
+      radio->txRxOnDone = 0;
+      return;
+   }
+   
    radio->state = RADIO_STATE_IDLE_MODE;    // Update Mode Flag
+   RF1AIE &= ~(RADIO_IFG_END_OF_PACKET | RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC); // desabilita as interrupcoes de rx
+   radio->rxStreamLen = 0;
    
    do 
    {  // Wait for XOSC to be stable and radio in IDLE state
@@ -201,85 +518,587 @@ void radioReceiveOff (void * pradio)
    RF1AIFG =0;                         // Clear pending IFG
 }
 
+/*! \brief Transmite um pacote e espera o fim da transmissao.
+ *   \return 1 se transmitiu, 0 se falhou o CCA em todas as tentativas
+ */
 char radioTransmit   (void * pradio, unsigned char * data,  unsigned char len)
 {
-   unsigned char ccaRetries;
-   unsigned char x;
+   RADIO * radio = (RADIO *)pradio;
    
+   if (!radio->transmitStart(radio, data, len, 0))
+   {
+      return 0;
+   }
+   while (radio->txStatus == RADIO_TX_STATUS_BUSY)
+   {
+      radio->run(radio);
+   }
+   return (radio->txStatus == RADIO_TX_STATUS_DONE);
+}
+
+/*! \brief Inicia a transmissao de um pacote sem bloquear.
+ *   O pacote e copiado para a FIFO de tx (ou para txBuffer, se nao couber na FIFO), entao o
+ *   buffer pode ser reutilizado logo em seguida.
+ *   O andamento e feito pelo metodo run, e o resultado fica em txStatus (e no callback txDone).
+ *   \param rxOnDone se diferente de zero, volta para o modo de recepcao ao terminar
+ *   \return 0 se ja tem uma transmissao em andamento ou o pacote esta vazio ou nao cabe no buffer
+ */
+char radioTransmitStart (void * pradio, unsigned char * data, unsigned char len, unsigned char rxOnDone)
+{
    RADIO * radio = (RADIO *)pradio;
    
+   if ((radio->txState != RADIO_TX_STATE_IDLE) || ((unsigned char)(len - 1) >= RADIO_FRAME_MAX) ||
+       (RADIO_PHY_PROFILES[radio->phy].fec && (len > RADIO_FEC_FRAME_LEN)))
+   {
+      return 0;
+   }
+#ifdef RADIO_BUS_STATS
+   radio->txBusOps = radio->busOps;
+#endif
+   
    radio->receiveOff(radio);
+   radioCalibrateCheck(radio);
+   
+   if ((len > MAX_TXFIFO_SIZE) || RADIO_PHY_PROFILES[radio->phy].fec)
+   { // o resto do pacote e escrito durante a transmissao, ou o pacote precisa ser completado
+      len = radioTxCopy(radio, data, len);
+      data = radio->txBuffer;
+   }
+   radioTxFifoLoad(radio, data, len);
    
-   //radioWriteTxFifo(&len,1);
+   radio->txPreambleMs = 0;
+   radioTransmitBegin(radio, rxOnDone);
+   return 1;
+}
+
+/*! \brief Transmite um pacote precedido de um preambulo longo, para acordar EDs em WOR.
+ *   Com a FIFO de tx vazia o radio fica transmitindo preambulo; o pacote so e escrito
+ *   na FIFO depois de preambleMs, que deve ser maior que o periodo do WOR dos EDs.
+ *   \return 0 se ja tem uma transmissao em andamento ou o pacote esta vazio ou nao cabe no buffer
+ */
+char radioTransmitWakeup (void * pradio, unsigned char * data, unsigned char len, unsigned short preambleMs, unsigned char rxOnDone)
+{
+   RADIO * radio = (RADIO *)pradio;
    
-   radioWriteTxFifo(data,len);
-    
-   ccaRetries = 4;
-    
-   while(1)
+   if ((radio->txState != RADIO_TX_STATE_IDLE) || ((unsigned char)(len - 1) >= RADIO_FRAME_MAX) ||
+       (RADIO_PHY_PROFILES[radio->phy].fec && (len > RADIO_FEC_FRAME_LEN)))
    {
-      radioStrobe (RF_SRX);
-      while(!(RF1AIN & BIT1)); //Wait for valid RSSI
-      RF1AIFG &= ~BIT0;
-      radioStrobe( RF_STX );       // Strobe STX    to initiate transfer
-      x = 0;
-      while((!(RF1AIFG & BIT0)) && (++x < 100) )
-      {
-         BSP_Delay(100);
-      }
-      if(RF1AIFG & BIT0)
-      { // CCA PASSED
-         //Clear the PA_PD pin interrupt flag.
-         RF1AIFG &= ~BIT0;
-         while(!(RF1AIN & BIT0)); // wait for transmit to complete.
-         // Transmit done, break of loop
-         break;      
-      }
-      else
-      { // CCA FAILED
-        // Turn off radio to save power
-         do
+      return 0;
+   }
+#ifdef RADIO_BUS_STATS
+   radio->txBusOps = radio->busOps;
+#endif
+   
+   radio->receiveOff(radio);
+   radioCalibrateCheck(radio);
+   
+   radio->txLen = radioTxCopy(radio, data, len);
+   radio->txPreambleMs = preambleMs;
+   radioTransmitBegin(radio, rxOnDone);
+   return 1;
+}
+
+/*! \brief Parte comum do inicio da transmissao: prepara o CSMA e dispara a maquina de estados. */
+static void radioTransmitBegin(RADIO * radio, unsigned char rxOnDone)
+{
+   radio->ccaRetries = radio->csma.maxRetries;
+   radio->backoffExp = radio->csma.minBE;
+   radio->txRxOnDone = rxOnDone;
+   radio->txStatus = RADIO_TX_STATUS_BUSY;
+   
+   if (radio->backoffExp)
+   { // espera inicial aleatoria antes do primeiro CCA
+      radioBackoffStart(radio);
+   }
+   else
+   {
+      radioStrobe (RF_SRX);             // liga o rx para ter o RSSI valido para o CCA
+      radio->txState = RADIO_TX_STATE_WAIT_RSSI;
+   }
+}
+
+/*! \brief Maquina de estados da transmissao. Deve ser chamada no laco principal. */
+void radioRun        (void * pradio)
+{
+   unsigned char x;
+   RADIO * radio = (RADIO *)pradio;
+   
+   switch(radio->txState)
+   {
+      case RADIO_TX_STATE_IDLE:
+         break;
+      case RADIO_TX_STATE_WAIT_RSSI:
+         if (RF1AIN & RADIO_IN_RSSI_VALID)
          {
-            x = radioStrobe(RF_SIDLE);
-         }while(x & 0x70); // Wait for XOSC to be stable and radio in IDLE state.
-         radioStrobe (RF_SFRX ); // Flush receive FIFO of residual Data
-         if (ccaRetries != 0)
+            // os bits menos significativos do RSSI sao ruido, usados como entropia do gerador aleatorio
+            radio->randState ^= radioReadReg(RSSI);
+            RF1AIES |= RADIO_IFG_PA_PD;  // borda de descida: PA ligado, o CCA passou
+            RF1AIFG &= ~RADIO_IFG_PA_PD;
+            radioStrobe( RF_STX );       // Strobe STX    to initiate transfer
+            radioTimerStart(RADIO_CCA_TIMEOUT_US);
+            radio->txState = RADIO_TX_STATE_WAIT_CCA;
+         }
+         break;
+      case RADIO_TX_STATE_WAIT_CCA:
+         if (RF1AIFG & RADIO_IFG_PA_PD)
+         { // CCA PASSED
+            //Clear the PA_PD pin interrupt flag.
+            RF1AIFG &= ~RADIO_IFG_PA_PD;
+            if (radio->txPreambleMs)
+            { // FIFO vazia: o radio transmite preambulo ate o pacote ser escrito
+               radioPreambleStep(radio);
+               radio->txState = RADIO_TX_STATE_PREAMBLE;
+            }
+            else
+            {
+               radio->txState = RADIO_TX_STATE_WAIT_END;
+            }
+         }
+         else if (radioTimerExpired())
+         { // CCA FAILED
+            // Turn off radio to save power
+            do
+            {
+               x = radioStrobe(RF_SIDLE);
+            }while(x & 0x70); // Wait for XOSC to be stable and radio in IDLE state.
+            radioStrobe (RF_SFRX ); // Flush receive FIFO of residual Data
+            ++radio->ccaFailCount;
+            if (radio->ccaRetries != 0)
+            { // janela de backoff dobra a cada falha, ate o maximo configurado
+               radio->ccaRetries--;
+               ++radio->txRetryCount;
+               if (radio->backoffExp < radio->csma.maxBE) ++radio->backoffExp;
+               radioBackoffStart(radio);
+            }
+            else // No CCA retries are left, abort.
+            {
+               ++radio->txAbortCount;
+               radioTransmitFinish(radio, RADIO_TX_STATUS_CCA_FAIL);
+            }
+         }
+         break;
+      case RADIO_TX_STATE_BACKOFF:
+         if (radioTimerExpired())
          {
-            BSP_Delay(15); // delay for a number of us.
-            ccaRetries--;
+            radioStrobe (RF_SRX);
+            radio->txState = RADIO_TX_STATE_WAIT_RSSI;
          }
-         else // No CCA retries are left, abort.
+         break;
+      case RADIO_TX_STATE_PREAMBLE:
+         if (radioTimerExpired())
          {
-            return 0;
-         }   
-      }   
+            if (radio->txPreambleMs)
+            {
+               radioPreambleStep(radio);
+            }
+            else
+            {
+               radioTxFifoLoad(radio, radio->txBuffer, radio->txLen);
+               radio->txState = RADIO_TX_STATE_WAIT_END;
+            }
+         }
+         break;
+      case RADIO_TX_STATE_WAIT_END:
+         if (radio->txUnderflow)
+         { // a interrupcao nao reabasteceu a FIFO a tempo, o pacote saiu truncado
+            ++radio->txFifoUnderflow;
+            radioTransmitFinish(radio, RADIO_TX_STATUS_UNDERFLOW);
+         }
+         else if (RF1AIN & RADIO_IFG_PA_PD) // PA desligado, terminou a transmissao
+         { // ou parou com a FIFO vazia antes da interrupcao de limiar ser atendida
+            if (radioReadReg(TXBYTES) & RADIO_TXBYTES_UNDERFLOW)
+            {
+               ++radio->txFifoUnderflow;
+               radioTransmitFinish(radio, RADIO_TX_STATUS_UNDERFLOW);
+            }
+            else
+            {
+               radioTransmitFinish(radio, RADIO_TX_STATUS_DONE);
+            }
+         }
+         break;
+   }
+}
+
+/*! \brief Coloca o radio em Wake-on-Radio: o nucleo do radio dorme e acorda sozinho a cada
+ *   EVENT0 para escutar o canal por um curto periodo. Um pacote recebido acorda a CPU
+ *   (sai do LPM3) e sinaliza worWake. O proximo init volta para a configuracao normal.
+ *   \param event0 periodo em unidades de 750/26MHz (0x876B ~ 1s)
+ *   \param rxTime MCSM2.RX_TIME, fracao do periodo que o radio fica em rx (0 = 3,6% ... 6 = 0,06%,
+ *   RADIO_WOR_RX_UNTIL_PACKET = em rx desde o primeiro evento ate receber um pacote)
+ */
+void radioWorStart   (void * pradio, unsigned short event0, unsigned char rxTime)
+{
+   RADIO * radio = (RADIO *)pradio;
+   
+   radio->receiveOff(radio);
+   
+   radio->worEvent0 = event0;
+   radio->worRxTime = rxTime;
+   radio->config(radio);                // so escreve os registradores do WOR que mudaram
+   radio->worWake = 0;
+   
+   RF1AIFG = 0;
+   RF1AIES |= RADIO_IFG_END_OF_PACKET;
+   RF1AIES &= ~(RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC);
+   RF1AIE  |= RADIO_IFG_END_OF_PACKET | RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC;
+   radio->state = RADIO_STATE_WOR_MODE;
+   
+   radioStrobe(RF_SWORRST);
+   radioStrobe(RF_SWOR);
+   
+   // entre os eventos o nucleo fica em SLEEP com a configuracao mantida
+   radio->retained = radio->shadowValid;
+}
+
+/*! \brief Muda o canal do radio (CHANNR). Na primeira vez em cada canal o sintetizador e
+ *   calibrado e os valores de FSCAL3/2/1 sao guardados; nas proximas eles sao so escritos,
+ *   sem os ~720us da calibracao.
+ *   \return 0 se o canal e invalido ou tem uma transmissao em andamento
+ */
+char radioSetChannel (void * pradio, unsigned char channel)
+{
+   RADIO * radio = (RADIO *)pradio;
+   RADIO_STATE state = radio->state;
+   
+   if ((channel >= RADIO_MAX_CHANNELS) || (radio->txState != RADIO_TX_STATE_IDLE))
+   {
+      return 0;
+   }
+   
+   // descarta as calibracoes de tempos em tempos por causa da deriva com a temperatura
+   if (++radio->fscalUses >= RADIO_FSCAL_REFRESH)
+   {
+      radio->fscalUses = 0;
+      radio->fscalValid = 0;
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOff(radio);
+   }
+   
+   radio->channel = channel;
+   radio->config(radio);               // escreve o CHANNR (e o FSCAL guardado) se mudaram
+   if (!(radio->fscalValid & (1 << channel)))
+   {
+      radioCalibrate(radio);
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOn(radio);
    }
-   radioStrobe (RF_SFTX ); // Flush transmit FIFO, Radio is already in IDLE state due to Register configuration
    return 1;
 }
 
+/*! \brief Seleciona a rede (palavra de sincronismo) e o endereco deste dispositivo.
+ *   Os pacotes de outras redes e de outros enderecos sao descartados pelo proprio radio.
+ *   \return 0 se a rede e invalida ou tem uma transmissao em andamento
+ */
+char radioSetNetwork (void * pradio, unsigned char netId, unsigned char address)
+{
+   RADIO * radio = (RADIO *)pradio;
+   RADIO_STATE state = radio->state;
+   
+   if ((netId >= RADIO_NETWORK_COUNT) || (radio->txState != RADIO_TX_STATE_IDLE))
+   {
+      return 0;
+   }
+   if ((radio->netId == netId) && (radio->address == address))
+   {
+      return 1;
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOff(radio);
+   }
+   
+   radio->netId = netId;
+   radio->address = address;
+   radio->config(radio);               // escreve SYNC1, SYNC0 e ADDR
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOn(radio);
+   }
+   return 1;
+}
+
+/*! \brief Muda o nivel de potencia de transmissao (indice em RADIO_PA_TABLE).
+ *   \return 0 se o nivel e invalido ou tem uma transmissao em andamento
+ */
+char radioSetTxPower (void * pradio, unsigned char level)
+{
+   RADIO * radio = (RADIO *)pradio;
+   RADIO_STATE state = radio->state;
+   
+   if ((level >= RADIO_PA_LEVELS) || (radio->txState != RADIO_TX_STATE_IDLE))
+   {
+      return 0;
+   }
+   if (radio->paLevel == level)
+   {
+      return 1;
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOff(radio);
+   }
+   
+   radio->paLevel = level;
+   if (radio->shadowValid && !radio->retained)
+   { // desligado ou dormindo: o PATABLE e escrito no proximo init
+      radio->config(radio);
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOn(radio);
+   }
+   return 1;
+}
+
+/*! \brief Muda o perfil de camada fisica (taxa, desvio e filtro de recepcao). As calibracoes
+ *   guardadas sao descartadas e o canal atual e calibrado de novo.
+ *   \return 0 se o perfil e invalido ou tem uma transmissao em andamento
+ */
+char radioSetPhy     (void * pradio, RADIO_PHY phy)
+{
+   RADIO * radio = (RADIO *)pradio;
+   RADIO_STATE state = radio->state;
+   
+   if ((phy >= RADIO_PHY_COUNT) || (radio->txState != RADIO_TX_STATE_IDLE))
+   {
+      return 0;
+   }
+   if (radio->phy == phy)
+   {
+      return 1;
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOff(radio);
+   }
+   
+   radio->phy = phy;
+   radio->fscalValid = 0;
+   if (radio->shadowValid && !radio->retained)
+   { // desligado ou dormindo: o perfil e escrito (e calibrado) no proximo init
+      radio->config(radio);            // so escreve os registradores do perfil
+      radioCalibrate(radio);
+   }
+   
+   if (state == RADIO_STATE_RX_MODE)
+   {
+      radio->receiveOn(radio);
+   }
+   return 1;
+}
+
+/*! \brief Tempo no ar, em us, de um pacote de len bytes (tamanho + dados escritos na FIFO)
+ *   no perfil atual, incluindo preambulo, sync word e CRC. Com FEC o pacote tem sempre
+ *   RADIO_FEC_FRAME_LEN bytes; os dados, o CRC e o terminador da trelica (1 ou 2 bytes, ate
+ *   completar um numero par) sao codificados com taxa 1/2 (DN504).
+ */
+unsigned long radioAirtime  (void * pradio, unsigned char len)
+{
+   RADIO * radio = (RADIO *)pradio;
+   unsigned short bytes;
+   
+   if (RADIO_PHY_PROFILES[radio->phy].fec)
+   {
+      bytes = RADIO_FRAME_SYNC + ((RADIO_FEC_FRAME_LEN + 2) / 2) * 4 + 4;
+   }
+   else
+   {
+      bytes = len + RADIO_FRAME_OVERHEAD;
+   }
+   return ((unsigned long)bytes * RADIO_PHY_PROFILES[radio->phy].byteTime) >> 3;
+}
+
+/*! \brief Carga gasta na transmissao de um pacote de len bytes no perfil e na potencia atuais,
+ *   em nC (mA x us). Nao inclui o CCA nem o preambulo longo do WOR.
+ */
+unsigned long radioTxCharge (void * pradio, unsigned char len)
+{
+   RADIO * radio = (RADIO *)pradio;
+   
+   return (radioAirtime(radio, len) * RADIO_PA_CURRENT[radio->paLevel]) / 10;
+}
+
+/*! \brief Calibra o sintetizador no canal atual (radio em IDLE) e guarda o resultado. */
+static void radioCalibrate(RADIO * radio)
+{
+   unsigned char x;
+   
+   radioStrobe(RF_SCAL);
+   do
+   {
+      x = radioStrobe(RF_SNOP);
+   }
+   while (x & 0x70);                   // espera voltar para IDLE
+   
+   radioReadBurstReg(FSCAL3, radio->fscalCache[radio->channel], 3);
+   radio->regShadow[FSCAL3] = radio->fscalCache[radio->channel][0];
+   radio->regShadow[FSCAL2] = radio->fscalCache[radio->channel][1];
+   radio->regShadow[FSCAL1] = radio->fscalCache[radio->channel][2];
+   radio->fscalValid |= (1 << radio->channel);
+}
+
+/*! \brief Descarta as calibracoes guardadas depois de RADIO_FSCAL_MAX_AGE, por causa da deriva
+ *   com a temperatura (o AP nunca troca de canal), e calibra o canal atual se ele ficou sem
+ *   calibracao. O radio tem que estar em IDLE.
+ */
+static void radioCalibrateCheck(RADIO * radio)
+{
+   if ((radio->ticks - radio->fscalTick) >= RADIO_FSCAL_MAX_AGE)
+   {
+      radio->fscalTick = radio->ticks;
+      radio->fscalValid = 0;
+   }
+   if (!(radio->fscalValid & (1 << radio->channel)))
+   {
+      radioCalibrate(radio);
+   }
+}
+
+/*! \brief Configura o CSMA/CA (janela de backoff, tentativas e limiar do carrier sense).
+ *   Cada papel usa o seu: ACKs do AP com janela curta, relatorios do ED com janela longa.
+ */
+void radioSetCsma    (void * pradio, const RADIO_CSMA_CONFIG * csma)
+{
+   RADIO * radio = (RADIO *)pradio;
+   
+   radio->csma = *csma;
+   if (radio->csma.maxBE < radio->csma.minBE) radio->csma.maxBE = radio->csma.minBE;
+   radioSetReg(radio, AGCCTRL1, radioDesiredReg(radio, AGCCTRL1));
+}
+
+/*! \brief Semente do gerador aleatorio do backoff (ex.: ID do dispositivo),
+ *   para que dispositivos que acordam juntos nao escolham os mesmos slots.
+ */
+void radioSeedRandom (void * pradio, unsigned short seed)
+{
+   RADIO * radio = (RADIO *)pradio;
+   
+   radio->randState ^= seed;
+   if (radio->randState == 0) radio->randState = 0xACE1;
+}
+
+/*! \brief Sorteia um numero de slots em [0, 2^BE - 1] e inicia a espera com o radio em IDLE. */
+static void radioBackoffStart(RADIO * radio)
+{
+   unsigned long backoff;
+   
+   backoff = (unsigned long)(radioRandom(radio) & ((1u << radio->backoffExp) - 1)) * radio->csma.slotUs;
+   if (backoff > RADIO_BACKOFF_MAX_US) backoff = RADIO_BACKOFF_MAX_US;
+   radioTimerStart((unsigned short)backoff + 1);
+   radio->txState = RADIO_TX_STATE_BACKOFF;
+}
+
+/*! \brief Temporiza o proximo passo do preambulo longo (ate RADIO_PREAMBLE_STEP_MS) e desconta
+ *   exatamente o tempo do passo, para que a soma dos passos seja o preambulo pedido.
+ */
+static void radioPreambleStep(RADIO * radio)
+{
+   unsigned short step = (radio->txPreambleMs > RADIO_PREAMBLE_STEP_MS) ? RADIO_PREAMBLE_STEP_MS : radio->txPreambleMs;
+   
+   radio->txPreambleMs -= step;
+   radioTimerStart(step * 1000u);
+}
+
+/*! \brief Gerador pseudo-aleatorio (LFSR de Galois de 16 bits). */
+static unsigned short radioRandom(RADIO * radio)
+{
+   unsigned short lfsr = radio->randState;
+   
+   if (lfsr == 0) lfsr = 0xACE1;
+   for (unsigned char i = 0; i < 8; i++)
+   {
+      lfsr = (lfsr >> 1) ^ ((unsigned short)(-(short)(lfsr & 1u)) & 0xB400u);
+   }
+   radio->randState = lfsr;
+   return lfsr;
+}
+
+/*! \brief Encerra a transmissao, atualiza o status e avisa pelo callback. */
+static void radioTransmitFinish(RADIO * radio, RADIO_TX_STATUS status)
+{
+   RF1AIE &= ~RADIO_IFG_TX_THRESHOLD;
+   radio->txStreamLeft = 0;
+   radio->txUnderflow = 0;
+   radioStrobe (RF_SFTX ); // Flush transmit FIFO, Radio is already in IDLE state due to Register configuration
+#ifdef RADIO_BUS_STATS
+   radio->txBusOps = radio->busOps - radio->txBusOps;
+#endif
+   radio->txState = RADIO_TX_STATE_IDLE;
+   radio->txStatus = status;
+   if (radio->txRxOnDone)
+   {
+      radio->receiveOn(radio);
+   }
+   if (radio->txDone)
+   {
+      radio->txDone(radio, status);
+   }
+}
+
+/*! \brief Escreve o pacote na FIFO de tx. O que nao cabe na FIFO fica apontado por
+ *   txStreamPtr e e escrito pela interrupcao de limiar da FIFO de tx, a medida que ela esvazia.
+ *   O buffer apontado por data tem que continuar valido ate o fim da transmissao.
+ */
+static void radioTxFifoLoad(RADIO * radio, unsigned char * data, unsigned char len)
+{
+   unsigned char first = (len > MAX_TXFIFO_SIZE) ? MAX_TXFIFO_SIZE : len;
+   
+   radioWriteTxFifo(data, first);
+   radio->txStreamPtr = data + first;
+   radio->txStreamLeft = len - first;
+   radio->txUnderflow = 0;
+   if (radio->txStreamLeft)
+   { // borda de descida do RFIFG5: a FIFO ficou abaixo do limiar e tem espaco para mais 32 bytes
+      RF1AIES |= RADIO_IFG_TX_THRESHOLD;
+      RF1AIFG &= ~RADIO_IFG_TX_THRESHOLD;
+      RF1AIE  |= RADIO_IFG_TX_THRESHOLD;
+   }
+}
+
+/*! \brief Copia o pacote para txBuffer; com FEC completa com zeros ate o tamanho fixo.
+ *   \return numero de bytes a escrever na FIFO
+ */
+static unsigned char radioTxCopy(RADIO * radio, unsigned char * data, unsigned char len)
+{
+   unsigned char frameLen = (RADIO_PHY_PROFILES[radio->phy].fec) ? RADIO_FEC_FRAME_LEN : len;
+   
+   for (unsigned char i = 0; i < frameLen; i++)
+   {
+      radio->txBuffer[i] = (i < len) ? data[i] : 0;
+   }
+   return frameLen;
+}
+
 char radioGetData    (void * pradio, unsigned char * buff, unsigned char * len)
 {
    RADIO * radio = (RADIO *)pradio;
-   if (radio->rxLen)
+   if (radio->rxPtrIn != radio->rxPtrOut)
    {
+      RADIO_PACKET * packet = &(radio->rxQueue[radio->rxPtrOut]);
       istate_t s;
       ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
       
-      if (radio->rxLen > 20) radio->rxLen = 20;
-      for(unsigned char i = 0; i < radio->rxLen; i++)
+      for(unsigned char i = 0; i < packet->len; i++)
       {
-         buff[i] = radio->rxBuffer[i];
+         buff[i] = packet->data[i];
       }
-      *len = radio->rxLen;
-      radio->rxLen = 0;
+      *len = packet->len;
+      radio->rxLink = packet->link;
+      radio->rxPtrOut++;
+      radio->rxPtrOut &= (RADIO_RX_QUEUE_SIZE-1);
       EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
-      
-      if (*len > 16)
-      {
-         *len = 0;
-         return 0;
-      }
    }
    else
    {
@@ -289,73 +1108,80 @@ char radioGetData    (void * pradio, unsigned char * buff, unsigned char * len)
    return 1;
 }
 
-
-
-void radioIsr(void)
+/*! \brief Trata o fim de pacote: copia o pacote da FIFO do radio para a fila de recepcao.
+ *   Chamada somente pela interrupcao do radio.
+ */
+static void radioIsr(void)
 {
    unsigned char rxBytes;
-   unsigned char tL;
    unsigned char *tmpRxBuffer;
-   unsigned short coreIntSource = RF1AIV;
-   unsigned char tempRxBufferLength, RxBufferLength;
+   unsigned short tempRxBufferLength, RxBufferLength;
+   unsigned char nextPtrIn;
+   RADIO_PACKET * packet;
 
-   RF1AIFG &= ~BIT9; // Clear RX Interrupt Flag
-	
-   if(radio1.state != RADIO_STATE_RX_MODE)
+   if((radio1.state != RADIO_STATE_RX_MODE) && (radio1.state != RADIO_STATE_WOR_MODE))
    { // We should only be here in RX mode, not in TX mode, nor if RX mode was turned on during CCA
       return;
    }
+#ifdef RADIO_BUS_STATS
+   if (radio1.rxStreamLen == 0)
+   { // pacote curto: comeca a contar agora; o longo ja foi contado desde o primeiro limiar
+      rxBusStart = radio1.busOps;
+   }
+#endif
    
-   for(int i=0; i < sizeof(radio1.rxBuffer); i++) radio1.rxBuffer[i] = 0; // Clean Buffer to help protect against spurious frames
-
-   tmpRxBuffer = radio1.rxBuffer; // Use a pointer to move through the Buffer
-
-   rxBytes = radioReadReg( RXBYTES ); // Read the number of bytes ready on the FIFO
-	
-   do
-   {
-      tL = rxBytes;
-      rxBytes = radioReadReg( RXBYTES );
+   nextPtrIn = (radio1.rxPtrIn + 1) & (RADIO_RX_QUEUE_SIZE-1);
+   if (nextPtrIn == radio1.rxPtrOut)
+   { // fila cheia, descarta o pacote que esta na FIFO
+      ++radio1.rxQueueOverflow;
+      radioRxRestart();
+      return;
    }
-   while(tL != rxBytes);   // Due to a chip bug, the RXBYTES has to read the same value twice for it to be correct
+   
+   packet = &(radio1.rxQueue[radio1.rxPtrIn]);
+
+   rxBytes = radioRxBytes(); // Read the number of bytes ready on the FIFO
 	
    if(rxBytes == 0)   // Check if the RX FIFO is empty, this may happen if address check is enabled and the FIFO is flushed when address doesn't match
    {
       return;
    }
-	
-   radioReadRxFifo(tmpRxBuffer, 1);
-   RxBufferLength = *(tmpRxBuffer) + 2; // Add 2 for the status bytes which are appended by the Radio    
-   ++tmpRxBuffer;
    
-   tempRxBufferLength = RxBufferLength;
-    
    // Check if number of bytes in Fifo exceed the FIFO Size, if so, assume FIFO overflow due to something
    // gone wrong with radio, and the only way to fix it, is to force IDLE mode and then back to RX Mode  
    if(rxBytes > MAX_RXFIFO_SIZE)
    {
-      radio1.receiveOff(&radio1);
-      radio1.receiveOn(&radio1);
+      ++radio1.rxFifoOverflow;
+      radioRxRestart();
       return;
    }
-   // else: everything matches continue
+	
+   if (radio1.rxStreamLen == 0)
+   { // pacote curto: a interrupcao de limiar nao leu nada ainda
+      if (!radioRxHeader(packet))
+      {
+         return;
+      }
+   }
+   
+   tmpRxBuffer = packet->data + radio1.rxStreamLen; // Use a pointer to move through the Buffer
+   RxBufferLength = radio1.rxStreamTotal - radio1.rxStreamLen;
+   tempRxBufferLength = radio1.rxStreamTotal - 2;
       
    //Copy Rest of packet
    while(RxBufferLength > 1)
    {	
-      rxBytes = radioReadReg( RXBYTES );
-      do
-      {
-         tL = rxBytes;
-         rxBytes= radioReadReg( RXBYTES );
-      }
-      while(tL != rxBytes);   // Due to a chip bug, the RXBYTES has to read the same value twice for it to be correct
+      rxBytes = radioRxBytes();
       if((rxBytes > MAX_RXFIFO_SIZE))
       {
-         radio1.receiveOff(&radio1);
-         radio1.receiveOn(&radio1);
+         ++radio1.rxFifoOverflow;
+         radioRxRestart();
          return;
       }
+      if (rxBytes > (RxBufferLength - 1))
+      { // deixa o ultimo byte de status para a leitura final
+         rxBytes = RxBufferLength - 1;
+      }
       if (rxBytes)
       {
          radioReadRxFifo(tmpRxBuffer, rxBytes);
@@ -364,141 +1190,280 @@ void radioIsr(void)
       }
    }
    radioReadRxFifo(tmpRxBuffer, 1);
-   // Signal main program that packet has been received and ready in RxBuffer
-   radio1.rxLen = tempRxBufferLength;
-   //radioStrobe( RF_SFRX);              // Limpa a FIFO de rx
-}
-
-
-// FUNCOES DE APOIO DO WBSL
-
-void BSP_Delay(unsigned short usec)
-{
-  TA0R = 0; /* initial count  */
-  TA0CCR0 = BSP_TIMER_CLK_MHZ*usec; /* compare count. (delay in ticks) */
-
-  /* Start the timer in UP mode */
-  TA0CTL |= MC_1 | TASSEL_2;
-
-  /* Loop till compare interrupt flag is set */
-  while(!(TA0CCTL0 & CCIFG));
-
-  /* Stop the timer */
-  TA0CTL &= ~(MC_1);
-
-  /* Clear the interrupt flag */
-   TA0CCTL0 &= ~CCIFG;
+   radio1.rxStreamLen = 0;
+   
+   // com FEC o filtro de endereco do radio esta desligado: confere o destino (data[1]) aqui
+   if (RADIO_PHY_PROFILES[radio1.phy].fec &&
+       (packet->data[1] != radio1.address) && (packet->data[1] != RADIO_ADDR_BROADCAST))
+   {
+      if (radio1.state == RADIO_STATE_WOR_MODE)
+      { // o radio foi para IDLE depois do pacote, volta para o WOR sem acordar a CPU
+         radioRxRestart();
+      }
+      return;
+   }
+   
+   // decodifica os bytes de status (RSSI, LQI/CRC_OK) e os retira do pacote
+   packet->link.rssi = ((signed char)packet->data[tempRxBufferLength] / 2) - RADIO_RSSI_OFFSET;
+   packet->link.lqi = packet->data[tempRxBufferLength + 1] & ~RADIO_LQI_CRC_OK;
+   packet->link.crcOk = (packet->data[tempRxBufferLength + 1] & RADIO_LQI_CRC_OK) ? 1 : 0;
+   packet->link.timestamp = radio1.rxSyncTime;
+   if (!packet->link.crcOk)
+   {
+      ++radio1.rxCrcError;
+   }
+   
+   // Sinaliza para o programa principal que tem um pacote novo na fila
+   // (com FEC o pacote no ar tem tamanho fixo, o tamanho real continua no primeiro byte)
+   packet->len = packet->data[0] + 1;
+   radio1.rxPtrIn = nextPtrIn;
+   
+   if (radio1.state == RADIO_STATE_WOR_MODE)
+   { // o radio voltou para IDLE depois do pacote (RXOFF_MODE), acorda a CPU
+      radio1.state = RADIO_STATE_IDLE_MODE;
+      RF1AIE &= ~(RADIO_IFG_END_OF_PACKET | RADIO_IFG_RX_THRESHOLD | RADIO_IFG_SYNC);
+      radio1.worWake = 1;
+   }
+#ifdef RADIO_BUS_STATS
+   radio1.rxBusOps = radio1.busOps - rxBusStart;
+#endif
 }
 
-unsigned char radioStrobe(unsigned char addr)
+/*! \brief Trata o limiar da FIFO de rx: esvazia a FIFO durante a recepcao de um pacote que
+ *   nao cabe nela. O resto do pacote e lido no fim do pacote por radioIsr.
+ *   Chamada somente pela interrupcao do radio.
+ */
+static void radioIsrRxFifo(void)
 {
-   unsigned char statusByte, gdoState;
-   istate_t s;
-
-   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
-
-   MRFI_RADIO_STATUS_READ_CLEAR(); // Lock out access to Radio IF
-
-   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+   unsigned char rxBytes;
+   unsigned short rxLeft;
+   unsigned char nextPtrIn;
+   RADIO_PACKET * packet;
 
-   if ((addr > RF_SRES) && (addr < RF_SNOP))
+   if((radio1.state != RADIO_STATE_RX_MODE) && (radio1.state != RADIO_STATE_WOR_MODE))
    {
-      gdoState = radioReadReg(IOCFG2); // buffer IOCFG2 state
-      radioWriteReg(IOCFG2, 0x29); // c-ready to GDO2
-
-      RF1AINSTRB = addr;
-
-      if ((RF1AIN & 0x04) == 0x04) // chip at sleep mode
+      return;
+   }
+#ifdef RADIO_BUS_STATS
+   if (radio1.rxStreamLen == 0)
+   {
+      rxBusStart = radio1.busOps;
+   }
+#endif
+   
+   nextPtrIn = (radio1.rxPtrIn + 1) & (RADIO_RX_QUEUE_SIZE-1);
+   if (nextPtrIn == radio1.rxPtrOut)
+   { // fila cheia, descarta o pacote antes que a FIFO estoure
+      ++radio1.rxQueueOverflow;
+      radioRxRestart();
+      return;
+   }
+   
+   packet = &(radio1.rxQueue[radio1.rxPtrIn]);
+   
+   rxBytes = radioRxBytes();
+   if(rxBytes > MAX_RXFIFO_SIZE)
+   {
+      ++radio1.rxFifoOverflow;
+      radioRxRestart();
+      return;
+   }
+   
+   if (radio1.rxStreamLen == 0)
+   { // primeiro limiar do pacote: le o byte de tamanho
+      if (!radioRxHeader(packet))
       {
-         if ( (addr == RF_SXOFF) || (addr == RF_SPWD) || (addr == RF_SWOR) )
-         {
-            // Do nothing
-         }
-         else
-         {
-            while ((RF1AIN & 0x04) == 0x04); // c-ready
-            BSP_Delay(760); // Delay should be 760us
-         }
+         return;
       }
-      radioWriteReg(IOCFG2, gdoState); // restore IOCFG2 setting
+      --rxBytes;
    }
-   else
+   
+   // a FIFO nao pode ser esvaziada durante a recepcao (errata do CC1101), e o ultimo
+   // byte de status fica para radioIsr
+   rxLeft = radio1.rxStreamTotal - radio1.rxStreamLen - 1;
+   if (rxBytes)
+   {
+      --rxBytes;
+   }
+   if (rxBytes > rxLeft)
    {
-      RF1AINSTRB = addr; // chip active mode
+      rxBytes = rxLeft;
+   }
+   if (rxBytes)
+   {
+      radioReadRxFifo(packet->data + radio1.rxStreamLen, rxBytes);
+      radio1.rxStreamLen += rxBytes;
    }
-   statusByte = RF1ASTAT0B; // Read status byte
-   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
-   return statusByte;
 }
 
-void radioWriteReg(unsigned char addr, unsigned char value)
+/*! \brief Trata o limiar da FIFO de tx: escreve mais um trecho do pacote longo enquanto ele
+ *   e transmitido. Chamada somente pela interrupcao do radio.
+ */
+static void radioIsrTxFifo(void)
 {
-   istate_t s;
-   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
-   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
-   RF1AINSTRB = (0x00 | addr); // Write cmd: 'write to register'
-   MRFI_RADIO_DATA_WRITE_WAIT(); // Wait for radio to be ready to accept the data
-   RF1ADINB   = value; // value to be written to the radio register
-   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+   unsigned char txBytes;
+   unsigned char txFree;
+   
+   if (radio1.txStreamLeft == 0)
+   {
+      RF1AIE &= ~RADIO_IFG_TX_THRESHOLD;
+      return;
+   }
+   
+   txBytes = radioReadReg(TXBYTES);
+   if (txBytes & RADIO_TXBYTES_UNDERFLOW)
+   { // chegou tarde, o radio ja parou; radioRun encerra a transmissao
+      RF1AIE &= ~RADIO_IFG_TX_THRESHOLD;
+      radio1.txStreamLeft = 0;
+      radio1.txUnderflow = 1;
+      return;
+   }
+   
+   txFree = MAX_TXFIFO_SIZE - txBytes;
+   if (txFree > radio1.txStreamLeft)
+   {
+      txFree = radio1.txStreamLeft;
+   }
+   radioWriteTxFifo(radio1.txStreamPtr, txFree);
+   radio1.txStreamPtr += txFree;
+   radio1.txStreamLeft -= txFree;
+   if (radio1.txStreamLeft == 0)
+   { // o resto ja esta na FIFO, que pode nem voltar a passar do limiar
+      RF1AIE &= ~RADIO_IFG_TX_THRESHOLD;
+   }
 }
 
-unsigned char radioReadReg(unsigned char addr)
+/*! \brief Trata a palavra de sincronismo: le o TA1 no inicio da recepcao do pacote, logo na
+ *   entrada da interrupcao, entao o erro e so a latencia da interrupcao, poucos us. O TA1R e lido
+ *   ate repetir o valor, porque no sono do ED o TA1 roda no ACLK, assincrono com a CPU.
+ *   Chamada somente pela interrupcao do radio.
+ */
+static void radioIsrSync(void)
 {
-   istate_t s;
-   unsigned char regValue;
+   unsigned short count;
+   unsigned short last;
+   unsigned long ticks;
+   
+   count = TA1R;
+   do
+   {
+      last = count;
+      count = TA1R;
+   }
+   while (count != last);
+   ticks = radio1.ticks;
+   if ((TA1CCTL0 & CCIFG) && (count < (TA1CCR0 >> 1)))
+   { // o TA1 ja virou mas a interrupcao do tick ainda nao foi atendida
+      ++ticks;
+   }
+   
+   // TA1 em SMCLK/8: cada tick tem (TA1CCR0 + 1) contagens
+   radio1.rxSyncTime = (ticks * (TA1CCR0 + 1ul) + count) * 8 / BSP_TIMER_CLK_MHZ;
+}
 
-   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+/*! \brief Le o byte de tamanho do pacote e calcula quantos bytes ele ocupa na FIFO.
+ *   \return 0 se o pacote nao cabe na fila; nesse caso a recepcao ja foi reiniciada
+ */
+static char radioRxHeader(RADIO_PACKET * packet)
+{
+   unsigned char frameLen;
+   
+   radioReadRxFifo(packet->data, 1);
+   
+   // o pacote completo (tamanho + dados + status) tem que caber na posicao da fila
+   frameLen = (RADIO_PHY_PROFILES[radio1.phy].fec) ? (RADIO_FEC_FRAME_LEN - 1) : (RADIO_RX_BUFFER_SIZE - 3);
+   if (packet->data[0] > frameLen)
+   {
+      ++radio1.rxFifoOverflow;
+      radioRxRestart();
+      return 0;
+   }
+   if (!RADIO_PHY_PROFILES[radio1.phy].fec)
+   {
+      frameLen = packet->data[0];
+   }
+   radio1.rxStreamTotal = frameLen + 3; // Add 2 for the status bytes which are appended by the Radio
+   radio1.rxStreamLen = 1;
+   return 1;
+}
 
-   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+/*! \brief Le o numero de bytes na FIFO de rx. */
+static unsigned char radioRxBytes(void)
+{
+   unsigned char rxBytes;
+   unsigned char tL;
+   
+   rxBytes = radioReadReg( RXBYTES );
+   do
+   {
+      tL = rxBytes;
+      rxBytes = radioReadReg( RXBYTES );
+   }
+   while(tL != rxBytes);   // Due to a chip bug, the RXBYTES has to read the same value twice for it to be correct
+   return rxBytes;
+}
 
-   if( (addr <= 0x2E) || (addr == 0x3E))
+/*! \brief Descarta o conteudo da FIFO de rx e volta a escutar (em rx ou em WOR). */
+static void radioRxRestart(void)
+{
+   RADIO_STATE state = radio1.state;
+   
+   radio1.receiveOff(&radio1);
+   if (state == RADIO_STATE_WOR_MODE)
    {
-      RF1AINSTR1B = (0x80 | addr); // Write cmd: read the Configuration register
+      radio1.worStart(&radio1, radio1.worEvent0, radio1.worRxTime);
    }
    else
    {
-      RF1AINSTR1B = (0xC0 | addr); // Write cmd: read the Status register
+      radio1.receiveOn(&radio1);
    }
-   // Read out the register value
-   regValue   = RF1ADOUT1B; //auto read
-   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
-
-   return( regValue);
 }
 
-
-void radioReadRxFifo(unsigned char * pData, unsigned char len)
+// Radio core interrupt service routine
+#pragma vector=CC1101_VECTOR
+__interrupt void CC1101_ISR(void)
 {
-   istate_t s;
-
-   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
-
-   do
+   switch(__even_in_range(RF1AIV, 32))
    {
-      MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
-      RF1AINSTR1B = 0xBF; // Write cmd: SNGLRXRD
-      *pData  = RF1ADOUT1B; //auto read register
-      pData++;
-      len--;
-   }while(len);
-   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+      case RF1AIV_RFIFG2:
+         radioIsrSync();
+         break;
+      case RF1AIV_RFIFG3:
+         radioIsrRxFifo();
+         break;
+      case RF1AIV_RFIFG5:
+         radioIsrTxFifo();
+         break;
+      case RF1AIV_RFIFG9:
+         radioIsr();
+         if (radio1.worWake)
+         {
+            __bic_SR_register_on_exit(LPM3_bits);
+         }
+         break;
+      default:
+         break;
+   }
 }
 
-void radioWriteTxFifo(unsigned char * pData, unsigned char len)
-{
-   istate_t s;
 
-   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
-   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
-   RF1AINSTRB = 0x7F; // Write cmd: TXFIFOWR
+/*! \brief Dispara o TA0 para uma temporizacao sem bloqueio (SMCLK/8, ate ~43ms). */
+static void radioTimerStart(unsigned short usec)
+{
+   TA0CTL = TASSEL_2 + ID_3 + TACLR;   // para e zera o timer
+   TA0CCTL0 &= ~CCIFG;
+   TA0CCR0 = (unsigned short)(((unsigned long)usec * BSP_TIMER_CLK_MHZ) / 8);
+   TA0CTL = TASSEL_2 + ID_3 + MC_1;    // up mode
+}
 
-   do
+/*! \brief Verifica se a temporizacao iniciada por radioTimerStart terminou. */
+static char radioTimerExpired(void)
+{
+   if (TA0CCTL0 & CCIFG)
    {
-      MRFI_RADIO_DATA_WRITE_WAIT(); // Wait for radio to be ready to accept the data
-      RF1ADINB   = *pData; //Write one byte to FIFO
-      pData++;
-      len--;
-   }while(len);
-
-   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+      TA0CTL = TASSEL_2 + ID_3;        // para o timer
+      TA0CCTL0 &= ~CCIFG;
+      return 1;
+   }
+   return 0;
 }
@@ -2,36 +2,178 @@
  *  \brief interface publica para o objeto radio.
  */
 
-#define RADIO_RX_BUFFER_SIZE 258
+#ifdef RADIO_LONG_PACKETS
+#define RADIO_RX_BUFFER_SIZE 257     // pacote de ate 255 bytes (PKTLEN) + 2 bytes de status
+#define RADIO_RX_QUEUE_SIZE  2       // numero de pacotes na fila de recepcao (potencia de 2)
+#else
+#define RADIO_RX_BUFFER_SIZE 64      // tamanho de cada posicao da fila (FIFO do radio)
+#define RADIO_RX_QUEUE_SIZE  4       // numero de pacotes na fila de recepcao (potencia de 2)
+#endif
+#define RADIO_FRAME_MAX (RADIO_RX_BUFFER_SIZE - 2) // maior quadro (byte de tamanho + payload): 255 ou 62
+#define RADIO_CONFIG_REG_COUNT 0x2F  // registradores de configuracao IOCFG2 (0x00) ate TEST0 (0x2E)
+#define RADIO_MAX_CHANNELS   8       // canais com calibracao guardada (mascara de 8 bits)
+#define RADIO_FSCAL_REFRESH  200     // trocas de canal ate descartar as calibracoes (deriva de temperatura)
+#define RADIO_FSCAL_MAX_AGE  30000ul // ticks (5 min) ate descartar as calibracoes mesmo sem trocar de canal
+#define RADIO_NETWORK_COUNT  8       // redes separadas pela palavra de sincronismo
+#define RADIO_NETWORK_PAIRING 0      // rede do pareamento (palavra de sincronismo original 0xD391)
+#define RADIO_PHY_PAIRING    RADIO_PHY_250K  // perfil usado no pareamento
+#define RADIO_FEC_FRAME_LEN  24      // tamanho fixo do pacote (tamanho + dados) nos perfis com FEC
+#define RADIO_PA_LEVELS      9       // niveis de potencia de transmissao (RADIO_PA_TABLE)
+#define RADIO_PA_LEVEL_MAX   (RADIO_PA_LEVELS - 1)
+#define RADIO_WOR_RX_UNTIL_PACKET 7  // rxTime do worStart: cada evento fica em rx ate chegar um pacote
+
+// enderecos do filtro de hardware (ADR_CHK com 0x00 como broadcast)
+#define RADIO_ADDR_BROADCAST 0x00    // aceito por todos os dispositivos da rede
+#define RADIO_ADDR_AP        0x01    // endereco do AP
+#define RADIO_ADDR_ED_FIRST  0x02    // primeiro endereco distribuido aos EDs
+
+// defina RADIO_BUS_STATS para contar as transacoes no barramento do RF1A
+// defina RADIO_DMA_RX para esvaziar a FIFO de rx por DMA
+// defina RADIO_LONG_PACKETS para pacotes maiores que a FIFO (ate 255 bytes, ~1 KB a mais de RAM)
 
 typedef enum
 {
    RADIO_STATE_OFF = 0,
    RADIO_STATE_RX_MODE,
-   RADIO_STATE_IDLE_MODE
+   RADIO_STATE_IDLE_MODE,
+   RADIO_STATE_WOR_MODE
 } RADIO_STATE;
 
+// perfis de camada fisica (taxa, desvio e filtro), do mais rapido para o de maior alcance
+typedef enum
+{
+   RADIO_PHY_250K = 0,               // 250 kbps GFSK (configuracao original, usada no pareamento)
+   RADIO_PHY_38K4,                   // 38,4 kbps GFSK
+   RADIO_PHY_1K2,                    // 1,2 kbps GFSK
+   RADIO_PHY_38K4_FEC,               // 38,4 kbps GFSK com FEC e interleaving (pacote de tamanho fixo)
+   RADIO_PHY_COUNT
+} RADIO_PHY;
+
+typedef enum
+{
+   RADIO_TX_STATE_IDLE = 0,
+   RADIO_TX_STATE_WAIT_RSSI,
+   RADIO_TX_STATE_WAIT_CCA,
+   RADIO_TX_STATE_WAIT_END,
+   RADIO_TX_STATE_BACKOFF,
+   RADIO_TX_STATE_PREAMBLE
+} RADIO_TX_STATE;
+
+typedef enum
+{
+   RADIO_TX_STATUS_IDLE = 0,
+   RADIO_TX_STATUS_BUSY,
+   RADIO_TX_STATUS_DONE,
+   RADIO_TX_STATUS_CCA_FAIL,
+   RADIO_TX_STATUS_UNDERFLOW
+} RADIO_TX_STATUS;
+
+typedef struct
+{
+   unsigned char  minBE;             // expoente inicial da janela de backoff (0 = sem espera inicial)
+   unsigned char  maxBE;             // expoente maximo da janela de backoff
+   unsigned char  maxRetries;        // falhas de CCA antes de desistir
+   unsigned short slotUs;            // duracao de um slot de backoff em us
+   signed char    csThreshold;       // limiar absoluto do carrier sense em dB relativo ao MAGN_TARGET (-7..7, -8 desliga)
+} RADIO_CSMA_CONFIG;
+
+typedef struct
+{
+   signed char    rssi;              // RSSI do pacote em dBm
+   unsigned char  lqi;               // indicador de qualidade do enlace (0..127, menor e melhor)
+   unsigned char  crcOk;             // 1 se o CRC do pacote confere
+   unsigned long  timestamp;         // instante da palavra de sincronismo em us (base de ticks)
+} RADIO_LINK_INFO;
+
+typedef struct
+{
+   unsigned char   len;
+   unsigned char   data[RADIO_RX_BUFFER_SIZE];
+   RADIO_LINK_INFO link;
+} RADIO_PACKET;
+
 typedef struct RADIO_STRUCT
 {
    void (* init)              (void * pradio);
    void (* powerOff)          (void * pradio);
+   void (* sleep)             (void * pradio);
    void (* reset)             (void * pradio);
    void (* config)            (void * pradio);
    void (* receiveOn)         (void * pradio);
    void (* receiveOff)        (void * pradio);
    char (* transmit)          (void * pradio, unsigned char * data, unsigned char len);
+   char (* transmitStart)     (void * pradio, unsigned char * data, unsigned char len, unsigned char rxOnDone);
+   char (* transmitWakeup)    (void * pradio, unsigned char * data, unsigned char len, unsigned short preambleMs, unsigned char rxOnDone);
+   void (* worStart)          (void * pradio, unsigned short event0, unsigned char rxTime);
+   char (* setChannel)        (void * pradio, unsigned char channel);
+   char (* setNetwork)        (void * pradio, unsigned char netId, unsigned char address);
+   char (* setTxPower)        (void * pradio, unsigned char level);
+   char (* setPhy)            (void * pradio, RADIO_PHY phy);
+   unsigned long (* airtime)  (void * pradio, unsigned char len);
+   unsigned long (* txCharge) (void * pradio, unsigned char len);
+   void (* run)               (void * pradio);
+   void (* setCsma)           (void * pradio, const RADIO_CSMA_CONFIG * csma);
+   void (* seedRandom)        (void * pradio, unsigned short seed);
    char (* getData)           (void * pradio, unsigned char * buff, unsigned char * len);
-   
-   void (* isr)               (void);
+
+   void (* txDone)            (void * pradio, RADIO_TX_STATUS status); // callback opcional de fim de transmissao
 
    RADIO_STATE    state;
-   unsigned char  rxBuffer[RADIO_RX_BUFFER_SIZE];
-   unsigned char  rxLen;
+   unsigned char  regShadow[RADIO_CONFIG_REG_COUNT]; // copia em RAM dos registradores de configuracao do radio
+   unsigned char  shadowValid;       // regShadow reflete o conteudo do radio
+   unsigned char  retained;          // radio em SLEEP com os registradores mantidos
+   unsigned char  paTable;           // valor gravado no PATABLE (0 = desconhecido)
+   unsigned char  paLevel;           // nivel de potencia de transmissao (indice em RADIO_PA_TABLE)
+   unsigned char  channel;
+   unsigned char  fscalCache[RADIO_MAX_CHANNELS][3]; // FSCAL3, FSCAL2 e FSCAL1 de cada canal
+   unsigned char  fscalValid;        // mascara dos canais com calibracao guardada
+   unsigned char  fscalUses;         // trocas de canal desde a ultima limpeza das calibracoes
+   unsigned long  fscalTick;         // ticks da ultima limpeza das calibracoes
+   unsigned char  netId;             // rede (palavra de sincronismo) em uso
+   RADIO_PHY      phy;               // perfil de camada fisica em uso
+   unsigned char  address;           // endereco deste dispositivo no filtro do radio
+   unsigned short worEvent0;         // periodo do WOR em unidades de 750/fxosc (0 = WOR desligado)
+   unsigned char  worRxTime;         // timeout de rx a cada evento do WOR (MCSM2.RX_TIME)
+   unsigned char  worWake;           // pacote recebido em WOR acordou a CPU
+   RADIO_TX_STATE txState;
+   RADIO_TX_STATUS txStatus;
+   unsigned char  txRxOnDone;        // liga a recepcao quando a transmissao terminar
+   unsigned char  ccaRetries;
+   unsigned char  txBuffer[RADIO_RX_BUFFER_SIZE]; // pacote guardado durante o preambulo longo
+   unsigned char  txLen;
+   unsigned char *txStreamPtr;       // resto do pacote que ainda nao coube na FIFO de tx
+   unsigned char  txStreamLeft;      // bytes que faltam escrever na FIFO de tx
+   unsigned char  txUnderflow;       // a FIFO de tx esvaziou antes do fim do pacote
+   unsigned short txPreambleMs;      // preambulo que ainda falta transmitir (acordar EDs em WOR)
+   unsigned char  backoffExp;        // expoente atual da janela de backoff
+   RADIO_CSMA_CONFIG csma;
+   unsigned short randState;
+   unsigned short ccaFailCount;      // CCAs que encontraram o canal ocupado
+   unsigned short txRetryCount;      // novas tentativas depois de um CCA ocupado
+   unsigned short txAbortCount;      // transmissoes abortadas por falta de canal livre
+   RADIO_PACKET   rxQueue[RADIO_RX_QUEUE_SIZE];
+   unsigned char  rxPtrIn;
+   unsigned char  rxPtrOut;
+   unsigned short rxQueueOverflow;   // pacotes descartados por fila cheia
+   unsigned short rxFifoOverflow;    // estouros da FIFO de rx do radio
+   unsigned short rxCrcError;        // pacotes recebidos com CRC errado
+   unsigned short rxStreamLen;       // bytes do pacote atual ja lidos da FIFO de rx
+   unsigned short rxStreamTotal;     // tamanho total do pacote atual (tamanho + dados + status)
+   unsigned short txFifoUnderflow;   // transmissoes perdidas por FIFO de tx vazia
+   RADIO_LINK_INFO rxLink;           // qualidade do ultimo pacote entregue por getData
+#ifdef RADIO_BUS_STATS
+   unsigned short busOps;            // total de transacoes no barramento do RF1A
+   unsigned short rxBusOps;          // transacoes usadas no ultimo pacote recebido
+   unsigned short txBusOps;          // transacoes usadas no ultimo pacote transmitido
+#endif
    
    unsigned char  timer;
+   unsigned long  ticks;             // ticks do TA1 (100 Hz), nunca zerado; base do timestamp
+   unsigned long  rxSyncTime;        // timestamp da ultima palavra de sincronismo recebida
 } RADIO;
 
 extern RADIO radio1;
+extern const signed char RADIO_PA_DBM[RADIO_PA_LEVELS]; // potencia em dBm de cada nivel
 
 void radio_reset(void);
 void config_radio(void);
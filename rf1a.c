@@ -0,0 +1,240 @@
+/* \file rf1a.c
+ * \brief Acesso de baixo nivel a interface RF1A: instrucoes, registradores e FIFOs do
+ * nucleo CC1101. Todo o trafego no barramento do radio passa por estas funcoes.
+ */
+
+#include "cc430x513x.h"
+#include "radio.h"
+#include "rf1a.h"
+
+// MACROS
+#define ENTER_CRITICAL_SECTION(x)         { x = __get_interrupt_state(); __disable_interrupt(); }
+#define EXIT_CRITICAL_SECTION(x)          __set_interrupt_state(x)
+#define MRFI_RADIO_INST_WRITE_WAIT()      while( !(RF1AIFCTL1 & RFINSTRIFG));
+#define MRFI_RADIO_DATA_WRITE_WAIT()      while( !(RF1AIFCTL1 & RFDINIFG)  );
+#define MRFI_RADIO_STATUS_READ_CLEAR()    RF1AIFCTL1 &= ~(RFSTATIFG);
+#define MRFI_RADIO_DATA_READ_WAIT()       while( !(RF1AIFCTL1 & RFDOUTIFG) );
+
+// contagem das transacoes no barramento do RF1A (instrucoes + bytes de dados)
+#ifdef RADIO_BUS_STATS
+#define RADIO_BUS_COUNT(n)                (radio1.busOps += (n))
+#else
+#define RADIO_BUS_COUNT(n)
+#endif
+
+// defines
+#define RADIO_DMA_MIN_LEN   8        // abaixo disso a leitura em burst pela CPU e mais rapida
+#define RADIO_STATUS_CHIP_RDYN 0x80  // byte de status: cristal ainda nao estabilizou (nucleo acordando)
+
+// FUNCOES DE APOIO DO WBSL
+
+void BSP_Delay(unsigned short usec)
+{
+  TA0R = 0; /* initial count  */
+  TA0CCR0 = BSP_TIMER_CLK_MHZ*usec; /* compare count. (delay in ticks) */
+
+  /* Start the timer in UP mode */
+  TA0CTL = MC_1 | TASSEL_2;
+
+  /* Loop till compare interrupt flag is set */
+  while(!(TA0CCTL0 & CCIFG));
+
+  /* Stop the timer */
+  TA0CTL &= ~(MC_1);
+
+  /* Clear the interrupt flag */
+   TA0CCTL0 &= ~CCIFG;
+}
+
+/*! \brief Envia uma instrucao (strobe) ao nucleo do radio.
+ *   Se o nucleo estava em SLEEP, espera o cristal estabilizar pelo bit CHIP_RDYn do byte de status
+ *   (com SNOPs), sem mexer no IOCFG2: o GDO2 fica com a palavra de sincronismo do timestamp.
+ *   \return byte de status do radio
+ */
+unsigned char radioStrobe(unsigned char addr)
+{
+   unsigned char statusByte;
+   istate_t s;
+
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+
+   MRFI_RADIO_STATUS_READ_CLEAR(); // Lock out access to Radio IF
+
+   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+
+   RF1AINSTRB = addr;
+   RADIO_BUS_COUNT(1);
+   statusByte = RF1ASTAT0B; // Read status byte
+
+   if ((addr > RF_SRES) && (addr < RF_SNOP) && (statusByte & RADIO_STATUS_CHIP_RDYN) &&
+       (addr != RF_SXOFF) && (addr != RF_SPWD) && (addr != RF_SWOR))
+   { // chip at sleep mode: espera o c-ready
+      do
+      {
+         MRFI_RADIO_INST_WRITE_WAIT();
+         RF1AINSTRB = RF_SNOP;
+         RADIO_BUS_COUNT(1);
+         statusByte = RF1ASTAT0B;
+      }
+      while (statusByte & RADIO_STATUS_CHIP_RDYN);
+      BSP_Delay(760); // Delay should be 760us
+   }
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+   return statusByte;
+}
+
+/*! \brief Grava a primeira posicao do PATABLE (a unica usada) e le de volta para conferir.
+ *   \return valor lido do PATABLE depois da escrita
+ */
+unsigned char radioWritePaTable(unsigned char value)
+{
+   unsigned char readback;
+   istate_t s;
+
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+   MRFI_RADIO_INST_WRITE_WAIT();
+   RF1AINSTRW = 0x7E00 + value;  // PA Table write (burst)
+   MRFI_RADIO_INST_WRITE_WAIT();
+   RF1AINSTRB = RF_SNOP;         // reset pointer
+   MRFI_RADIO_INST_WRITE_WAIT();
+   RF1AINSTRB = 0xFE;            // PA Table read (burst)
+   MRFI_RADIO_DATA_WRITE_WAIT();
+   RF1ADINB = 0x00;              // dummy write
+   MRFI_RADIO_DATA_READ_WAIT();
+   readback = RF1ADOUT0B;
+   MRFI_RADIO_INST_WRITE_WAIT();
+   RF1AINSTRB = RF_SNOP;
+   RADIO_BUS_COUNT(6);
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+   return readback;
+}
+
+void radioWriteReg(unsigned char addr, unsigned char value)
+{
+   istate_t s;
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+   RF1AINSTRB = (0x00 | addr); // Write cmd: 'write to register'
+   MRFI_RADIO_DATA_WRITE_WAIT(); // Wait for radio to be ready to accept the data
+   RF1ADINB   = value; // value to be written to the radio register
+   RADIO_BUS_COUNT(2);
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+}
+
+unsigned char radioReadReg(unsigned char addr)
+{
+   istate_t s;
+   unsigned char regValue;
+
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+
+   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+
+   if( (addr <= 0x2E) || (addr == 0x3E))
+   {
+      RF1AINSTR1B = (0x80 | addr); // Write cmd: read the Configuration register
+   }
+   else
+   {
+      RF1AINSTR1B = (0xC0 | addr); // Write cmd: read the Status register
+   }
+   // Read out the register value
+   regValue   = RF1ADOUT1B; //auto read
+   RADIO_BUS_COUNT(2);
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+
+   return( regValue);
+}
+
+
+/*! \brief Escreve um bloco de registradores consecutivos com uma unica instrucao de burst.
+ *   \param addr endereco do primeiro registrador
+ *   \param pData valores a serem escritos
+ *   \param len numero de registradores
+ */
+void radioWriteBurstReg(unsigned char addr, const unsigned char * pData, unsigned char len)
+{
+   istate_t s;
+
+   if (len == 0) return;
+   
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+   RF1AINSTRW = ((unsigned short)(RF_REGWR | addr) << 8) + pData[0]; // instrucao + primeiro dado
+   RADIO_BUS_COUNT(1);
+   ++pData;
+   --len;
+   while(len)
+   {
+      MRFI_RADIO_DATA_WRITE_WAIT(); // Wait for radio to be ready to accept the data
+      RF1ADINB = *pData;
+      RADIO_BUS_COUNT(1);
+      ++pData;
+      --len;
+   }
+   MRFI_RADIO_DATA_WRITE_WAIT(); // espera o ultimo byte ser aceito
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+}
+
+/*! \brief Le um bloco de registradores consecutivos (ou a FIFO de rx) com auto-read.
+ *   \param addr endereco do primeiro registrador (RXFIFO para a FIFO de rx)
+ *   \param pData buffer de destino
+ *   \param len numero de bytes
+ */
+void radioReadBurstReg(unsigned char addr, unsigned char * pData, unsigned char len)
+{
+   istate_t s;
+
+   if (len == 0) return;
+   
+   ENTER_CRITICAL_SECTION(s); // Lock out access to Radio IF
+   MRFI_RADIO_INST_WRITE_WAIT(); // Wait for radio to be ready for next instruction
+   RF1AINSTR1B = (RF_REGRD | addr); // instrucao de leitura em burst com auto-read
+   RADIO_BUS_COUNT(1);
+   while(--len)
+   {
+      MRFI_RADIO_DATA_READ_WAIT(); // espera o radio atualizar o RF1ADOUT
+      *pData = RF1ADOUT1B;         // le e dispara o auto-read do proximo byte
+      RADIO_BUS_COUNT(1);
+      ++pData;
+   }
+   MRFI_RADIO_DATA_READ_WAIT();
+   *pData = RF1ADOUT0B;            // ultimo byte sem disparar nova leitura
+   RADIO_BUS_COUNT(1);
+   EXIT_CRITICAL_SECTION(s); // Allow access to Radio IF
+}
+
+#ifdef RADIO_DMA_RX
+/*! \brief Esvazia a FIFO de rx usando o canal 0 do DMA.
+ *   O DMA e disparado pelo RFRXIFG e le o registrador de acesso direto RF1ARXFIFO,
+ *   sem instrucoes por byte no barramento do RF1A.
+ */
+static void radioDmaReadRxFifo(unsigned char * pData, unsigned char len)
+{
+   DMACTL0 = (DMACTL0 & 0xFF00) | DMA0TSEL__RFRXIFG;
+   DMA0SAL = (unsigned short)&RF1ARXFIFO;
+   DMA0DAL = (unsigned short)pData;
+   DMA0SZ  = len;
+   DMA0CTL = DMADT_0 + DMASRCINCR_0 + DMADSTINCR_3 + DMASBDB + DMALEVEL + DMAEN; // single, byte, destino incrementa
+   RADIO_BUS_COUNT(1);
+   while(!(DMA0CTL & DMAIFG));
+   DMA0CTL &= ~(DMAIFG + DMAEN);
+}
+#endif
+
+void radioReadRxFifo(unsigned char * pData, unsigned char len)
+{
+#ifdef RADIO_DMA_RX
+   if (len >= RADIO_DMA_MIN_LEN)
+   {
+      radioDmaReadRxFifo(pData, len);
+      return;
+   }
+#endif
+   radioReadBurstReg(RXFIFO, pData, len);
+}
+
+void radioWriteTxFifo(unsigned char * pData, unsigned char len)
+{
+   radioWriteBurstReg(TXFIFO, pData, len);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+/*! \file rf1a.h
+ *  \brief interface de baixo nivel com o nucleo de radio (RF1A).
+ *
+ *  Instrucoes, registradores e FIFOs do CC1101 so sao acessados por estas funcoes
+ *  (rf1a.c). Para rodar o driver do radio fora da placa basta ligar no lugar de rf1a.c
+ *  uma implementacao que emule o nucleo (test/rf1aEmu.c); o resto do radio.c so usa os
+ *  registradores de interrupcao (RF1AIFG, RF1AIE, RF1AIES, RF1AIN, RF1AIV, RF1AIFERR) e os timers.
+ */
+
+#define BSP_TIMER_CLK_MHZ   12       // 12 MHz MCLKC and SMCLK
+
+void BSP_Delay(unsigned short usec);
+unsigned char radioStrobe(unsigned char addr);
+unsigned char radioWritePaTable(unsigned char value);
+void radioWriteReg(unsigned char addr, unsigned char value);
+unsigned char radioReadReg(unsigned char addr);
+void radioWriteBurstReg(unsigned char addr, const unsigned char * pData, unsigned char len);
+void radioReadBurstReg(unsigned char addr, unsigned char * pData, unsigned char len);
+void radioReadRxFifo(unsigned char * pData, unsigned char len);
+void radioWriteTxFifo(unsigned char * pData, unsigned char len);
@@ -1,31 +1,31 @@
 /*! \file scrambler.c
  *  \brief implementacao do scrambler.
+ *
+ *  Scrambler multiplicativo de 23 bits (x^23 + x^18 + 1), bit mais significativo primeiro.
+ *  Os bits 18 e 23 do registrador usados nos 8 passos de um byte sao os bits 11..23 do
+ *  registrador no inicio do byte (os bits novos so chegam ate a posicao 7), entao a mascara
+ *  do byte inteiro sai de uma vez: (S >> 11) ^ (S >> 16). O resultado e identico ao da
+ *  versao bit a bit, com um XOR e dois deslocamentos por byte em vez de 8 iteracoes.
  */
 
 #include "scrambler.h"
 
+// mascara do proximo byte a partir dos dois bytes mais altos do registrador
+#define SCRAMBLER_MASK(s2, s1) ((unsigned char)((s2) ^ (unsigned char)(((s2) << 5) | ((s1) >> 3))))
+
 void scrambler (unsigned char * dataIn, unsigned char * dataOut, unsigned char len, unsigned char seed[3])
 {
    unsigned char shifter[3] = {seed[0], seed[1], seed[2]};
    
    for( unsigned char i = 0; i < len; i++)
    {
-      dataOut[i] = 0;
-      for (unsigned char j = 0; j < 8; j++)
-      {
-         unsigned char bitIn = ((dataIn[i] >> (7 - j)) & 0x01);
-         unsigned char bit18 = (shifter[2] >> 2) & 0x01;
-         unsigned char bit23 = (shifter[2] >> 7) & 0x01;
-         unsigned char bitOut = (bitIn ^ (bit18 ^ bit23));
-         dataOut[i] = dataOut[i] | (bitOut << (7 - j));
-         
-         shifter[2] <<= 1;
-         shifter[2] |= (shifter[1] >> 7);
-         shifter[1] <<= 1;
-         shifter[1] |= (shifter[0] >> 7);
-         shifter[0] <<= 1;
-         shifter[0] |= bitOut;
-      }
+      unsigned char byteOut = dataIn[i] ^ SCRAMBLER_MASK(shifter[2], shifter[1]);
+      dataOut[i] = byteOut;
+      
+      // o registrador anda 8 bits, realimentado pela saida
+      shifter[2] = shifter[1];
+      shifter[1] = shifter[0];
+      shifter[0] = byteOut;
    }
 }
 
@@ -35,21 +35,12 @@ void descrambler (unsigned char * dataIn, unsigned char * dataOut, unsigned char
    
    for( unsigned char i = 0; i < len; i++)
    {
-      dataOut[i] = 0;
-      for (unsigned char j = 0; j < 8; j++)
-      {
-         unsigned char bitIn = ((dataIn[i] >> (7 - j)) & 0x01);
-         unsigned char bit18 = (shifter[2] >> 2) & 0x01;
-         unsigned char bit23 = (shifter[2] >> 7) & 0x01;
-         unsigned char bitOut = (bitIn ^ (bit18 ^ bit23));
-         dataOut[i] = dataOut[i] | (bitOut << (7 - j));
-         
-         shifter[2] <<= 1;
-         shifter[2] |= (shifter[1] >> 7);
-         shifter[1] <<= 1;
-         shifter[1] |= (shifter[0] >> 7);
-         shifter[0] <<= 1;
-         shifter[0] |= bitIn;
-      }
+      unsigned char byteIn = dataIn[i];
+      dataOut[i] = byteIn ^ SCRAMBLER_MASK(shifter[2], shifter[1]);
+      
+      // o registrador anda 8 bits, realimentado pela entrada
+      shifter[2] = shifter[1];
+      shifter[1] = shifter[0];
+      shifter[0] = byteIn;
    }
-}
\ No newline at end of file
+}
@@ -16,6 +16,7 @@ void serialClearMessages (void * pserial);
 void serialReset (void * pserial);
 
 void IDtoASCII(unsigned char * input, unsigned char * output);
+unsigned char intToStr(int value, unsigned char * output);
 
 // instancias das maquinas seriais
 SERIAL serial1 = {serialInit};
@@ -74,7 +75,7 @@ void serialTransmit (void * pserial, unsigned char * data,...)
                break;
             case 'd':
             case 'i':
-               charCount = 0;//intToStr( va_arg ( arguments, int ), (unsigned char *)charBuff);
+               charCount = intToStr( va_arg ( arguments, int ), (unsigned char *)charBuff);
                for (i = 0; i < charCount; i++)
                {
                   serial->uart->putBuffTx(serial->uart,charBuff[i]);
@@ -128,6 +129,12 @@ void serialProcessBuffRx (void * pserial)
                case 'C':
                   serial->state = SERIAL_STATE_CHANNEL;
                   break;
+               case 'N':
+                  serial->state = SERIAL_STATE_NETWORK;
+                  break;
+               case 'P':
+                  serial->state = SERIAL_STATE_PHY;
+                  break;
                case 'M':
                   serial->state = SERIAL_STATE_MODE;
                   break;
@@ -151,6 +158,26 @@ void serialProcessBuffRx (void * pserial)
                   serial->state = SERIAL_STATE_IDLE;
                   serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_LIST);
                   break;
+               case 'Q':
+                  serial->state = SERIAL_STATE_IDLE;
+                  serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_QUALITY);
+                  break;
+               case 'D':
+                  serial->state = SERIAL_STATE_IDLE;
+                  serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_DATA);
+                  break;
+               case 'C':
+                  serial->state = SERIAL_STATE_SENSOR_CONFIG;
+                  serial->var1Len = 0;
+                  break;
+               case 'G':
+                  serial->state = SERIAL_STATE_SENSOR_GROUP;
+                  serial->var1Len = 0;
+                  break;
+               case 'P':
+                  serial->state = SERIAL_STATE_SENSOR_POLL;
+                  serial->var1Len = 0;
+                  break;
                default:
                   serial->state = SERIAL_STATE_IDLE;
             }
@@ -171,6 +198,32 @@ void serialProcessBuffRx (void * pserial)
                serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_ERASE);
             }
             break;
+         case SERIAL_STATE_SENSOR_POLL:
+            serial->var1[serial->var1Len++] = tempByte;
+            if (serial->var1Len >= 4)
+            {
+               serial->state = SERIAL_STATE_IDLE;
+               serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_POLL);
+            }
+            break;
+         case SERIAL_STATE_SENSOR_CONFIG:
+            // ID, tipo e valor com 4 digitos decimais
+            serial->var1[serial->var1Len++] = tempByte;
+            if (serial->var1Len >= 9)
+            {
+               serial->state = SERIAL_STATE_IDLE;
+               serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_CONFIG);
+            }
+            break;
+         case SERIAL_STATE_SENSOR_GROUP:
+            // grupo (2 digitos hexa), tipo e valor com 4 digitos decimais
+            serial->var1[serial->var1Len++] = tempByte;
+            if (serial->var1Len >= 7)
+            {
+               serial->state = SERIAL_STATE_IDLE;
+               serial->putMessage(serial, SERIAL_MESSAGE_SENSOR_GROUP);
+            }
+            break;
          case SERIAL_STATE_CHANNEL:
             switch(tempByte)
             {
@@ -193,6 +246,52 @@ void serialProcessBuffRx (void * pserial)
                serial->putMessage(serial, SERIAL_MESSAGE_CHANNEL_SET);
             }
             break;
+         case SERIAL_STATE_NETWORK:
+            switch(tempByte)
+            {
+               case 'S':
+                  serial->state = SERIAL_STATE_NETWORK_SET;
+                  serial->var1Len = 0;
+                  break;
+               case 'R':
+                  serial->state = SERIAL_STATE_IDLE;
+                  serial->putMessage(serial, SERIAL_MESSAGE_NETWORK_READ);
+                  break;
+               default:
+                  serial->state = SERIAL_STATE_IDLE;
+            }
+            break;
+         case SERIAL_STATE_NETWORK_SET:
+            serial->var1[serial->var1Len++] = tempByte;
+            if (serial->var1Len >= 1)
+            {
+               serial->state = SERIAL_STATE_IDLE;
+               serial->putMessage(serial, SERIAL_MESSAGE_NETWORK_SET);
+            }
+            break;
+         case SERIAL_STATE_PHY:
+            switch(tempByte)
+            {
+               case 'S':
+                  serial->state = SERIAL_STATE_PHY_SET;
+                  serial->var1Len = 0;
+                  break;
+               case 'R':
+                  serial->state = SERIAL_STATE_IDLE;
+                  serial->putMessage(serial, SERIAL_MESSAGE_PHY_READ);
+                  break;
+               default:
+                  serial->state = SERIAL_STATE_IDLE;
+            }
+            break;
+         case SERIAL_STATE_PHY_SET:
+            serial->var1[serial->var1Len++] = tempByte;
+            if (serial->var1Len >= 1)
+            {
+               serial->state = SERIAL_STATE_IDLE;
+               serial->putMessage(serial, SERIAL_MESSAGE_PHY_SET);
+            }
+            break;
          case SERIAL_STATE_MODE:
             switch(tempByte)
             {
@@ -300,4 +399,29 @@ void IDtoASCII(unsigned char * input, unsigned char * output)
       ++output;
       ++input;
    }
-}
\ No newline at end of file
+}
+
+/* \brief Converte um inteiro com sinal para decimal em ASCII. Retorna o numero de caracteres.*/
+unsigned char intToStr(int value, unsigned char * output)
+{
+   unsigned char digits[5];
+   unsigned char count = 0;
+   unsigned char len = 0;
+   unsigned int absValue = (value < 0) ? -(unsigned int)value : value;
+   
+   if (value < 0)
+   {
+      output[len++] = '-';
+   }
+   do
+   {
+      digits[count++] = (absValue % 10) + '0';
+      absValue /= 10;
+   }
+   while (absValue);
+   while (count)
+   {
+      output[len++] = digits[--count];
+   }
+   return len;
+}
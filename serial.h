@@ -14,8 +14,15 @@ typedef enum
    SERIAL_STATE_SENSOR,
    SERIAL_STATE_SENSOR_WRITE,
    SERIAL_STATE_SENSOR_ERASE,
+   SERIAL_STATE_SENSOR_POLL,
+   SERIAL_STATE_SENSOR_CONFIG,
+   SERIAL_STATE_SENSOR_GROUP,
    SERIAL_STATE_CHANNEL,
    SERIAL_STATE_CHANNEL_SET,
+   SERIAL_STATE_NETWORK,
+   SERIAL_STATE_NETWORK_SET,
+   SERIAL_STATE_PHY,
+   SERIAL_STATE_PHY_SET,
    SERIAL_STATE_MODE,
    SERIAL_STATE_TIMEOUT,
    SERIAL_STATE_TIMEOUT_WRITE
@@ -27,8 +34,17 @@ typedef enum
    SERIAL_MESSAGE_SENSOR_WRITE,
    SERIAL_MESSAGE_SENSOR_ERASE,
    SERIAL_MESSAGE_SENSOR_LIST,
+   SERIAL_MESSAGE_SENSOR_POLL,
+   SERIAL_MESSAGE_SENSOR_QUALITY,
+   SERIAL_MESSAGE_SENSOR_DATA,
+   SERIAL_MESSAGE_SENSOR_CONFIG,
+   SERIAL_MESSAGE_SENSOR_GROUP,
    SERIAL_MESSAGE_CHANNEL_SET,
    SERIAL_MESSAGE_CHANNEL_READ,
+   SERIAL_MESSAGE_NETWORK_SET,
+   SERIAL_MESSAGE_NETWORK_READ,
+   SERIAL_MESSAGE_PHY_SET,
+   SERIAL_MESSAGE_PHY_READ,
    SERIAL_MESSAGE_MODE_SEARCH,
    SERIAL_MESSAGE_MODE_RECEIVE,
    SERIAL_MESSAGE_MODE_RECEIVE_INIT,
@@ -0,0 +1,86 @@
+/* \file ccmBench.c
+ * \brief Custo por pacote do AES-CCM (PACKET_SECURITY) contra o scrambler bit a bit da
+ *  versao original e o scrambler.c (um byte por passo), no PC.
+ *
+ *  O CCM usa a implementacao em C do aes.c (AES_SOFTWARE). No alvo o bloco e cifrado pelo
+ *  modulo AES do CC430 e o custo vem quase todo do numero de blocos por pacote, que tambem e
+ *  mostrado: B0, os blocos do cabecalho e do corpo no CBC-MAC, A0 e os blocos do corpo no modo
+ *  contador.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "aes.h"
+#include "packet.h"
+#include "scrambler.h"
+#include "scramblerRef.h"
+
+#define BENCH_ROUNDS   100000
+#define BENCH_BLOCKS(n) (((n) + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE)
+
+static unsigned char sink;
+
+static double benchSeconds(clock_t start)
+{
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+   // corpo do STATUS sem extras, com todos os eventos e o maior que cabe no quadro longo
+   static const unsigned char BODY[] = {PACKET_STATUS_BASE_SIZE, PACKET_STATUS_EVENTS_SIZE(PACKET_EVENTS_MAX), 48};
+   static const unsigned char key[AES_KEY_SIZE] = {0x3A, 0x91, 0x5C, 0x07, 0xE2, 0x48, 0xB6, 0x1D,
+                                                   0x74, 0xC9, 0x20, 0x8F, 0x53, 0xAE, 0x16, 0xF0};
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   unsigned char nonce[AES_CCM_NONCE_SIZE] = {0};
+   unsigned char frame[PACKET_HEADER_SIZE + 64 + AES_CCM_MIC_SIZE];
+   unsigned char out[64];
+
+   for (unsigned char i = 0; i < sizeof(frame); i++)
+   {
+      frame[i] = (unsigned char)(i * 37 + 11);
+   }
+
+   printf("%d pacotes por ponto, cabecalho de %d bytes (entra no MIC)\n\n", BENCH_ROUNDS, PACKET_HEADER_SIZE);
+   printf("corpo  blocos AES   bit a bit   byte a byte   CCM (AES em C)   CCM/bit a bit\n");
+   for (unsigned char k = 0; k < sizeof(BODY); k++)
+   {
+      unsigned char len = BODY[k];
+      unsigned short blocks = 1 + BENCH_BLOCKS(2 + PACKET_HEADER_SIZE) + BENCH_BLOCKS(len) + 1 + BENCH_BLOCKS(len);
+      double tRef, tByte, tCcm;
+      clock_t start;
+
+      start = clock();
+      for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+      {
+         frame[PACKET_HEADER_SIZE] = (unsigned char)n;
+         scramblerRef(&frame[PACKET_HEADER_SIZE], out, len, seed, 1);
+         sink ^= out[len - 1];
+      }
+      tRef = benchSeconds(start);
+
+      start = clock();
+      for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+      {
+         frame[PACKET_HEADER_SIZE] = (unsigned char)n;
+         scrambler(&frame[PACKET_HEADER_SIZE], out, len, seed);
+         sink ^= out[len - 1];
+      }
+      tByte = benchSeconds(start);
+
+      start = clock();
+      for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+      {
+         nonce[4] = (unsigned char)n;
+         aesCcmEncrypt(key, nonce, frame, PACKET_HEADER_SIZE, &frame[PACKET_HEADER_SIZE], len,
+                       &frame[PACKET_HEADER_SIZE + len]);
+         sink ^= frame[PACKET_HEADER_SIZE + len];
+      }
+      tCcm = benchSeconds(start);
+
+      printf("%5d  %10d   %6.0f ns   %8.0f ns   %11.0f ns   %12.1fx\n", len, blocks,
+             tRef * 1e9 / BENCH_ROUNDS, tByte * 1e9 / BENCH_ROUNDS, tCcm * 1e9 / BENCH_ROUNDS, tCcm / tRef);
+   }
+   printf("(%u)\n", sink);
+   return 0;
+}
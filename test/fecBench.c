@@ -0,0 +1,276 @@
+/* \file fecBench.c
+ * \brief Comparacao do perfil com FEC (RADIO_PHY_38K4_FEC) com o sem FEC (RADIO_PHY_38K4):
+ *  taxa de perda de pacotes (PER) num canal com erros de bit independentes e tempo no ar.
+ *
+ *  O FEC do CC1101 e modelado como na DN504: codigo convolucional de taxa 1/2 e comprimento
+ *  de restricao 4, terminador da trelica, interleaving em blocos de 4x4 simbolos de 2 bits e
+ *  decodificacao de Viterbi (aqui com decisao dura; o radio usa decisao suave e se sai um
+ *  pouco melhor). O pacote e o do perfil com FEC: RADIO_FEC_FRAME_LEN bytes + CRC16. Erros
+ *  no preambulo e na palavra de sincronismo nao sao simulados.
+ *
+ *  O tempo no ar vem do proprio radio.c (radio1.airtime); o tempo por pacote entregue conta
+ *  as retransmissoes ate passar (airtime / (1 - PER)).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "cc430x513x.h"
+#include "radio.h"
+#include "rf1aEmu.h"
+
+#define BENCH_FRAMES      4000
+#define BENCH_LEN         RADIO_FEC_FRAME_LEN                  // tamanho + dados
+#define BENCH_CRC_LEN     (BENCH_LEN + 2)
+#define BENCH_FEC_LEN     (((BENCH_CRC_LEN / 2) * 4) + 4)     // bytes codificados (DN504)
+#define BENCH_FEC_BITS    ((BENCH_FEC_LEN / 2) * 8)           // bits de entrada do codificador
+
+void radioInit(void * pradio);
+
+// saida do codificador (2 bits) para os 3 bits anteriores e o bit atual (DN504)
+static const unsigned char FEC_ENCODE_TABLE[16] = {0, 3, 1, 2, 3, 0, 2, 1, 3, 0, 2, 1, 0, 3, 1, 2};
+
+static unsigned long randState = 0x2545F491;
+
+/*! \brief Gerador pseudo-aleatorio (xorshift32), para a simulacao ser repetivel. */
+static unsigned long benchRandom(void)
+{
+   randState ^= (randState << 13) & 0xFFFFFFFF;
+   randState ^= randState >> 17;
+   randState ^= (randState << 5) & 0xFFFFFFFF;
+   return randState;
+}
+
+/*! \brief CRC16 do CC1101 (polinomio 0x8005, inicio 0xFFFF). */
+static unsigned short crc16(const unsigned char * data, unsigned char len)
+{
+   unsigned short crc = 0xFFFF;
+
+   while (len--)
+   {
+      crc ^= (unsigned short)(*data++) << 8;
+      for (unsigned char i = 0; i < 8; i++)
+      {
+         crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x8005) : (unsigned short)(crc << 1);
+      }
+   }
+   return crc;
+}
+
+/*! \brief Codificacao convolucional e interleaving de dados + CRC, como o radio faz no tx. */
+static void fecEncode(const unsigned char * input, unsigned char * out)
+{
+   unsigned char buff[BENCH_FEC_LEN / 2];
+   unsigned char fec[BENCH_FEC_LEN];
+   unsigned short reg = 0;
+
+   memcpy(buff, input, BENCH_CRC_LEN);
+   buff[BENCH_CRC_LEN] = 0x0B;          // terminador da trelica
+   buff[BENCH_CRC_LEN + 1] = 0x0B;
+   for (unsigned short i = 0; i < BENCH_FEC_LEN / 2; i++)
+   {
+      unsigned short word = 0;
+
+      reg = (reg & 0x700) | buff[i];
+      for (unsigned char j = 0; j < 8; j++)
+      {
+         word = (unsigned short)((word << 2) | FEC_ENCODE_TABLE[reg >> 7]);
+         reg = (reg << 1) & 0x7FF;
+      }
+      fec[2 * i] = word >> 8;
+      fec[2 * i + 1] = word & 0xFF;
+   }
+   for (unsigned short i = 0; i < BENCH_FEC_LEN; i += 4)
+   {
+      unsigned long word = 0;
+
+      for (unsigned char j = 0; j < 16; j++)
+      {
+         word = (word << 2) | ((fec[i + (~j & 0x03)] >> (2 * ((j & 0x0C) >> 2))) & 0x03);
+      }
+      out[i] = (unsigned char)(word >> 24);
+      out[i + 1] = (unsigned char)(word >> 16);
+      out[i + 2] = (unsigned char)(word >> 8);
+      out[i + 3] = (unsigned char)word;
+   }
+}
+
+/*! \brief Desfaz o interleaving e decodifica (Viterbi) dados + CRC, como o radio faz no rx. */
+static void fecDecode(const unsigned char * in, unsigned char * output)
+{
+   static unsigned char decision[BENCH_FEC_BITS][8];
+   unsigned char fec[BENCH_FEC_LEN];
+   unsigned short metric[8];
+   unsigned char state;
+
+   memset(fec, 0, sizeof(fec));
+   for (unsigned short i = 0; i < BENCH_FEC_LEN; i += 4)
+   {
+      unsigned long word = ((unsigned long)in[i] << 24) | ((unsigned long)in[i + 1] << 16) |
+                           ((unsigned long)in[i + 2] << 8) | in[i + 3];
+
+      for (unsigned char j = 0; j < 16; j++)
+      {
+         unsigned char sym = (word >> (30 - 2 * j)) & 0x03;
+
+         fec[i + (~j & 0x03)] |= (unsigned char)(sym << (2 * ((j & 0x0C) >> 2)));
+      }
+   }
+
+   // estado: os 3 bits anteriores, o mais recente no bit 0; o codificador comeca em 0
+   for (state = 0; state < 8; state++)
+   {
+      metric[state] = (state == 0) ? 0 : 0x3FFF;
+   }
+   for (unsigned short n = 0; n < BENCH_FEC_BITS; n++)
+   {
+      unsigned char sym = (fec[n / 4] >> (6 - 2 * (n % 4))) & 0x03;
+      unsigned short next[8];
+
+      for (state = 0; state < 8; state++)
+      {
+         next[state] = 0xFFFF;
+      }
+      for (state = 0; state < 8; state++)
+      {
+         for (unsigned char bit = 0; bit < 2; bit++)
+         {
+            unsigned char idx = (unsigned char)((state << 1) | bit);
+            unsigned char diff = FEC_ENCODE_TABLE[idx] ^ sym;
+            unsigned short m = metric[state] + (diff & 1) + (diff >> 1);
+
+            if (m < next[idx & 7])
+            {
+               next[idx & 7] = m;
+               decision[n][idx & 7] = state;
+            }
+         }
+      }
+      memcpy(metric, next, sizeof(metric));
+   }
+
+   // volta pelo melhor caminho a partir do melhor estado final
+   state = 0;
+   for (unsigned char s = 1; s < 8; s++)
+   {
+      if (metric[s] < metric[state])
+      {
+         state = s;
+      }
+   }
+   memset(output, 0, BENCH_CRC_LEN);
+   for (unsigned short n = BENCH_FEC_BITS; n-- > 0;)
+   {
+      if ((n / 8) < BENCH_CRC_LEN)
+      {
+         output[n / 8] |= (unsigned char)((state & 1) << (7 - (n % 8)));
+      }
+      state = decision[n][state];
+   }
+}
+
+/*! \brief Troca cada bit com probabilidade ber. */
+static void channel(unsigned char * data, unsigned short len, double ber)
+{
+   unsigned long limit = (unsigned long)(ber * 4294967296.0);
+
+   for (unsigned short i = 0; i < len; i++)
+   {
+      for (unsigned char b = 0; b < 8; b++)
+      {
+         if (benchRandom() < limit)
+         {
+            data[i] ^= (unsigned char)(1 << b);
+         }
+      }
+   }
+}
+
+/*! \brief Pacote aleatorio de BENCH_LEN bytes com o CRC no fim. */
+static void frameMake(unsigned char * frame)
+{
+   unsigned short crc;
+
+   frame[0] = BENCH_LEN - 1;
+   for (unsigned char i = 1; i < BENCH_LEN; i++)
+   {
+      frame[i] = (unsigned char)benchRandom();
+   }
+   crc = crc16(frame, BENCH_LEN);
+   frame[BENCH_LEN] = crc >> 8;
+   frame[BENCH_LEN + 1] = crc & 0xFF;
+}
+
+/*! \brief Pacote aceito pelo radio: CRC certo. Conta a parte os aceitos com dados errados. */
+static unsigned char frameOk(const unsigned char * rx, const unsigned char * tx, unsigned long * undetected)
+{
+   unsigned short crc = crc16(rx, BENCH_LEN);
+
+   if ((rx[BENCH_LEN] != (crc >> 8)) || (rx[BENCH_LEN + 1] != (crc & 0xFF)))
+   {
+      return 0;
+   }
+   if (memcmp(rx, tx, BENCH_CRC_LEN) != 0)
+   {
+      ++*undetected;
+   }
+   return 1;
+}
+
+int main(void)
+{
+   static const double BER[] = {0, 1e-4, 5e-4, 1e-3, 2e-3, 5e-3, 1e-2, 2e-2};
+   unsigned char frame[BENCH_CRC_LEN];
+   unsigned char rx[BENCH_CRC_LEN];
+   unsigned char coded[BENCH_FEC_LEN];
+   unsigned long airPlain, airFec;
+   int fail = 0;
+
+   rf1aEmuReset();
+   memset(&radio1, 0, sizeof(radio1));
+   radio1.init = radioInit;
+   radio1.init(&radio1);
+   radio1.setPhy(&radio1, RADIO_PHY_38K4);
+   airPlain = radio1.airtime(&radio1, BENCH_LEN);
+   radio1.setPhy(&radio1, RADIO_PHY_38K4_FEC);
+   airFec = radio1.airtime(&radio1, BENCH_LEN);
+
+   printf("pacote de %d bytes + CRC, %d pacotes por ponto\n", BENCH_LEN, BENCH_FRAMES);
+   printf("tempo no ar: sem FEC %lu us, com FEC %lu us\n\n", airPlain, airFec);
+   printf("     BER   PER sem FEC   PER com FEC   us/entregue sem FEC   com FEC\n");
+
+   for (unsigned char k = 0; k < sizeof(BER) / sizeof(BER[0]); k++)
+   {
+      unsigned long lostPlain = 0, lostFec = 0, undetected = 0;
+      double perPlain, perFec;
+
+      for (unsigned short n = 0; n < BENCH_FRAMES; n++)
+      {
+         frameMake(frame);
+
+         memcpy(rx, frame, sizeof(rx));
+         channel(rx, sizeof(rx), BER[k]);
+         lostPlain += !frameOk(rx, frame, &undetected);
+
+         fecEncode(frame, coded);
+         channel(coded, sizeof(coded), BER[k]);
+         fecDecode(coded, rx);
+         lostFec += !frameOk(rx, frame, &undetected);
+      }
+      perPlain = (double)lostPlain / BENCH_FRAMES;
+      perFec = (double)lostFec / BENCH_FRAMES;
+      printf("%8.0e   %11.4f   %11.4f   %19.0f   %7.0f\n", BER[k], perPlain, perFec,
+             (perPlain < 1) ? airPlain / (1 - perPlain) : 0, (perFec < 1) ? airFec / (1 - perFec) : 0);
+
+      // sem erros no canal o decodificador tem que devolver o pacote original
+      if ((BER[k] == 0) && (lostPlain || lostFec))
+      {
+         printf("falhou: perda sem erros no canal\n");
+         fail = 1;
+      }
+      if (undetected)
+      {
+         printf("  %lu pacotes errados passaram pelo CRC\n", undetected);
+      }
+   }
+   return fail;
+}
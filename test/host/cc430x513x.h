@@ -0,0 +1,208 @@
+/*! \file cc430x513x.h
+ *  \brief cabecalho do CC430F5137 para compilar o driver do radio no PC (testes).
+ *
+ *  Tem so o que o radio.c usa. Os registradores de interrupcao do RF1A e os timers sao
+ *  variaveis do emulador (rf1aEmu.c): cada acesso passa por hostReg, que avanca o tempo do
+ *  emulador e atende as interrupcoes pendentes. Os registradores de instrucao e de dados do
+ *  RF1A nao existem aqui de proposito: o acesso ao nucleo tem que passar por rf1a.h.
+ */
+
+#ifndef CC430X513X_HOST_H
+#define CC430X513X_HOST_H
+
+// intrinsecos do compilador
+typedef unsigned short istate_t;
+
+istate_t __get_interrupt_state(void);
+void __disable_interrupt(void);
+void __enable_interrupt(void);
+void __set_interrupt_state(istate_t state);
+void __bic_SR_register_on_exit(unsigned short bits);
+
+#define __even_in_range(x, max)   (x)
+#define __no_operation()
+#define __interrupt
+#define __no_init
+#define __ramfunc
+
+// registrador de status
+#define CPUOFF     0x0010
+#define GIE        0x0008
+#define SCG0       0x0040
+#define SCG1       0x0080
+#define LPM3_bits  (SCG1 + SCG0 + CPUOFF)
+
+#define BIT0  0x0001
+#define BIT1  0x0002
+#define BIT2  0x0004
+#define BIT3  0x0008
+#define BIT4  0x0010
+#define BIT5  0x0020
+#define BIT6  0x0040
+#define BIT7  0x0080
+#define BIT8  0x0100
+#define BIT9  0x0200
+#define BITA  0x0400
+#define BITB  0x0800
+#define BITC  0x1000
+#define BITD  0x2000
+#define BITE  0x4000
+#define BITF  0x8000
+
+// registradores emulados: cada acesso avanca o emulador
+volatile unsigned short * hostReg(volatile unsigned short * reg);
+#define HOST_REG(name)  (*hostReg(&host##name))
+
+extern volatile unsigned short hostRF1AIFG;
+extern volatile unsigned short hostRF1AIE;
+extern volatile unsigned short hostRF1AIES;
+extern volatile unsigned short hostRF1AIN;
+extern volatile unsigned short hostRF1AIV;
+extern volatile unsigned short hostRF1AIFERR;
+extern volatile unsigned short hostTA0CTL;
+extern volatile unsigned short hostTA0CCTL0;
+extern volatile unsigned short hostTA0CCR0;
+extern volatile unsigned short hostTA0R;
+extern volatile unsigned short hostTA1CTL;
+extern volatile unsigned short hostTA1CCTL0;
+extern volatile unsigned short hostTA1CCR0;
+extern volatile unsigned short hostTA1R;
+
+#define RF1AIFG   HOST_REG(RF1AIFG)
+#define RF1AIE    HOST_REG(RF1AIE)
+#define RF1AIES   HOST_REG(RF1AIES)
+#define RF1AIN    HOST_REG(RF1AIN)
+#define RF1AIV    HOST_REG(RF1AIV)
+#define RF1AIFERR HOST_REG(RF1AIFERR)
+#define TA0CTL    HOST_REG(TA0CTL)
+#define TA0CCTL0  HOST_REG(TA0CCTL0)
+#define TA0CCR0   HOST_REG(TA0CCR0)
+#define TA0R      HOST_REG(TA0R)
+#define TA1CTL    HOST_REG(TA1CTL)
+#define TA1CCTL0  HOST_REG(TA1CCTL0)
+#define TA1CCR0   HOST_REG(TA1CCR0)
+#define TA1R      HOST_REG(TA1R)
+
+// Timer_A
+#define TASSEL_1  0x0100         // ACLK
+#define TASSEL_2  0x0200         // SMCLK
+#define ID_0      0x0000
+#define ID_1      0x0040
+#define ID_2      0x0080
+#define ID_3      0x00C0
+#define MC_0      0x0000
+#define MC_1      0x0010         // up mode
+#define MC_2      0x0020
+#define MC_3      0x0030
+#define TACLR     0x0004
+#define CCIE      0x0010
+#define CCIFG     0x0001
+
+// vetor de interrupcao do RF1A
+#define CC1101_VECTOR    (27 * 2)
+#define RF1AIV_NONE      0x0000
+#define RF1AIV_RFIFG0    0x0002
+#define RF1AIV_RFIFG1    0x0004
+#define RF1AIV_RFIFG2    0x0006
+#define RF1AIV_RFIFG3    0x0008
+#define RF1AIV_RFIFG4    0x000A
+#define RF1AIV_RFIFG5    0x000C
+#define RF1AIV_RFIFG6    0x000E
+#define RF1AIV_RFIFG7    0x0010
+#define RF1AIV_RFIFG8    0x0012
+#define RF1AIV_RFIFG9    0x0014
+#define RF1AIV_RFIFG10   0x0016
+#define RF1AIV_RFIFG11   0x0018
+#define RF1AIV_RFIFG12   0x001A
+#define RF1AIV_RFIFG13   0x001C
+#define RF1AIV_RFIFG14   0x001E
+#define RF1AIV_RFIFG15   0x0020
+
+// registradores de configuracao do nucleo de radio
+#define IOCFG2    0x00
+#define IOCFG1    0x01
+#define IOCFG0    0x02
+#define FIFOTHR   0x03
+#define SYNC1     0x04
+#define SYNC0     0x05
+#define PKTLEN    0x06
+#define PKTCTRL1  0x07
+#define PKTCTRL0  0x08
+#define ADDR      0x09
+#define CHANNR    0x0A
+#define FSCTRL1   0x0B
+#define FSCTRL0   0x0C
+#define FREQ2     0x0D
+#define FREQ1     0x0E
+#define FREQ0     0x0F
+#define MDMCFG4   0x10
+#define MDMCFG3   0x11
+#define MDMCFG2   0x12
+#define MDMCFG1   0x13
+#define MDMCFG0   0x14
+#define DEVIATN   0x15
+#define MCSM2     0x16
+#define MCSM1     0x17
+#define MCSM0     0x18
+#define FOCCFG    0x19
+#define BSCFG     0x1A
+#define AGCCTRL2  0x1B
+#define AGCCTRL1  0x1C
+#define AGCCTRL0  0x1D
+#define WOREVT1   0x1E
+#define WOREVT0   0x1F
+#define WORCTRL   0x20
+#define FREND1    0x21
+#define FREND0    0x22
+#define FSCAL3    0x23
+#define FSCAL2    0x24
+#define FSCAL1    0x25
+#define FSCAL0    0x26
+#define RCCTRL1   0x27
+#define RCCTRL0   0x28
+#define FSTEST    0x29
+#define PTEST     0x2A
+#define AGCTEST   0x2B
+#define TEST2     0x2C
+#define TEST1     0x2D
+#define TEST0     0x2E
+
+// registradores de status
+#define PARTNUM        0x30
+#define VERSION        0x31
+#define FREQEST        0x32
+#define LQI            0x33
+#define RSSI           0x34
+#define MARCSTATE      0x35
+#define WORTIME1       0x36
+#define WORTIME0       0x37
+#define PKTSTATUS      0x38
+#define VCO_VC_DAC     0x39
+#define TXBYTES        0x3A
+#define RXBYTES        0x3B
+#define RCCTRL1_STATUS 0x3C
+#define RCCTRL0_STATUS 0x3D
+
+#define PATABLE   0x3E
+#define TXFIFO    0x3F
+#define RXFIFO    0x3F
+
+// strobes
+#define RF_SRES     0x30
+#define RF_SFSTXON  0x31
+#define RF_SXOFF    0x32
+#define RF_SCAL     0x33
+#define RF_SRX      0x34
+#define RF_STX      0x35
+#define RF_SIDLE    0x36
+#define RF_SWOR     0x38
+#define RF_SPWD     0x39
+#define RF_SFRX     0x3A
+#define RF_SFTX     0x3B
+#define RF_SWORRST  0x3C
+#define RF_SNOP     0x3D
+
+#define RF_REGWR    0x40
+#define RF_REGRD    0xC0
+
+#endif
@@ -0,0 +1,292 @@
+/* \file packetTest.c
+ * \brief Testes do formato dos pacotes no PC na compilacao padrao (sem PACKET_SECURITY, corpo
+ *  embaralhado pelo scrambler): ida e volta pelo packetBuild/packetParse de cada tipo, o corpo
+ *  no ar conferido com o scrambler bit a bit e a rejeicao de tamanhos e contagens invalidos.
+ */
+
+#include <string.h>
+#include "packet.h"
+#include "radio.h"
+#include "scrambler.h"
+#include "scramblerRef.h"
+#include "test.h"
+
+static const unsigned char ID[PACKET_ID_SIZE] = {0x12, 0x34, 0x56, 0x78};
+
+/*! \brief O corpo no ar e o corpo dado embaralhado com a semente fixa (versao bit a bit). */
+static int testScrambled(const unsigned char * frame, const unsigned char * body, unsigned char len)
+{
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   unsigned char ref[64];
+
+   scramblerRef((unsigned char *)body, ref, len, seed, 1);
+   return memcmp(&frame[PACKET_HEADER_SIZE], ref, len) == 0;
+}
+
+/*! \brief Troca um byte do corpo ja embaralhado de um quadro (desembaralha, troca e embaralha
+ *   de novo), para montar contagens que o packetBuild nao deixa passar.
+ */
+static void testBodyPatch(unsigned char * frame, unsigned char len, unsigned char pos, unsigned char value)
+{
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   unsigned char body[64];
+   unsigned char bodyLen = len - PACKET_HEADER_SIZE;
+
+   descrambler(&frame[PACKET_HEADER_SIZE], body, bodyLen, seed);
+   body[pos] = value;
+   scrambler(body, &frame[PACKET_HEADER_SIZE], bodyLen, seed);
+}
+
+/*! \brief DISC: cabecalho, tamanho e corpo embaralhado. */
+static void testDisc(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_DISC, 0, 9, RADIO_ADDR_AP, RADIO_ADDR_BROADCAST);
+   memcpy(tx.body.disc.id, ID, PACKET_ID_SIZE);
+   tx.body.disc.sensorType = 0x31;
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_SIZE(PACKET_DISC));
+   CHECK(frame[0] == len - 1);
+   CHECK(frame[1] == RADIO_ADDR_AP && frame[2] == ((PACKET_VERSION << 4) | PACKET_TYPE_DISC));
+   CHECK(frame[4] == 9 && frame[5] == RADIO_ADDR_BROADCAST);
+   CHECK(tx.hdr.counter == 0);
+   CHECK(testScrambled(frame, (unsigned char *)&tx.body.disc, sizeof(PACKET_DISC)));
+   CHECK(memcmp(&frame[PACKET_HEADER_SIZE], ID, PACKET_ID_SIZE) != 0);
+
+   memset(&rx, 0xAA, sizeof(rx));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_DISC);
+   CHECK(rx.hdr.seq == 9 && rx.hdr.dst == RADIO_ADDR_AP && rx.hdr.src == RADIO_ADDR_BROADCAST);
+   CHECK(rx.hdr.counter == 0);
+   CHECK(packetIdMatch(rx.body.disc.id, ID) && rx.body.disc.sensorType == 0x31);
+}
+
+/*! \brief STATUS basico e com eventos, configAck e canais no fim do corpo. */
+static void testStatus(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   unsigned char pos = 0;
+   PACKET_CHAN chan;
+   char delta;
+   signed short value;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_STATUS, 0, 3, RADIO_ADDR_AP, RADIO_ADDR_ED_FIRST);
+   memcpy(tx.body.status.id, ID, PACKET_ID_SIZE);
+   tx.body.status.sensorType = 0x31;
+   tx.body.status.value[0] = '0';
+   tx.body.status.value[1] = '0';
+   tx.body.status.paLevel = 5;
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_STATUS_BASE_SIZE));
+   CHECK(testScrambled(frame, (unsigned char *)&tx.body.status, PACKET_STATUS_BASE_SIZE));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(packetIdMatch(rx.body.status.id, ID) && rx.body.status.value[0] == '0' && rx.body.status.paLevel == 5);
+   CHECK(rx.body.status.eventCount == 0 && rx.body.status.configAck == 0 && rx.body.status.chanLen == 0);
+
+   packetSetHeader(&tx, PACKET_TYPE_STATUS, PACKET_FLAG_EVENTS | PACKET_FLAG_CONFIG | PACKET_FLAG_CHANNELS,
+                   4, RADIO_ADDR_AP, RADIO_ADDR_ED_FIRST);
+   tx.body.status.eventSeq = 17;
+   tx.body.status.eventCount = 2;
+   tx.body.status.events[0].value = '0';
+   tx.body.status.events[0].age[1] = 30;
+   tx.body.status.events[1].value = 'F';
+   tx.body.status.events[1].age[1] = 2;
+   tx.body.status.configAck = 0x5A;
+   CHECK(packetChanPut(&tx.body.status, PACKET_CHAN_BATTERY, 0, 2950));
+   CHECK(packetChanPut(&tx.body.status, PACKET_CHAN_TEMPERATURE, 1, -3));
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_STATUS_EVENTS_SIZE(2) + 1 + tx.body.status.chanLen));
+   memset(&rx, 0, sizeof(rx));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(rx.body.status.eventSeq == 17 && rx.body.status.eventCount == 2);
+   CHECK(rx.body.status.events[0].value == '0' && rx.body.status.events[0].age[1] == 30);
+   CHECK(rx.body.status.events[1].value == 'F' && rx.body.status.events[1].age[1] == 2);
+   CHECK(rx.body.status.configAck == 0x5A);
+   CHECK(rx.body.status.chanLen == tx.body.status.chanLen);
+   CHECK(packetChanGet(&rx.body.status, &pos, &chan, &delta, &value));
+   CHECK(chan == PACKET_CHAN_BATTERY && !delta && value == 2950);
+   CHECK(packetChanGet(&rx.body.status, &pos, &chan, &delta, &value));
+   CHECK(chan == PACKET_CHAN_TEMPERATURE && delta && value == -3);
+   CHECK(!packetChanGet(&rx.body.status, &pos, &chan, &delta, &value));
+}
+
+/*! \brief SACK sem comandos (configCount zerado na leitura) e com comandos. */
+static void testSack(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_SACK, 0, 1, RADIO_ADDR_ED_FIRST, RADIO_ADDR_AP);
+   tx.body.sack.ackSeq = 4;
+   tx.body.sack.rssi = -71;
+   tx.body.sack.phy = 1;
+   tx.body.sack.configCount = 2;                 // sem PACKET_FLAG_CONFIG nao vai no ar
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_SACK_BASE_SIZE));
+   memset(&rx, 0xAA, sizeof(rx));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_SACK);
+   CHECK(rx.body.sack.ackSeq == 4 && rx.body.sack.rssi == -71 && rx.body.sack.phy == 1);
+   CHECK(rx.body.sack.configCount == 0);
+
+   packetSetHeader(&tx, PACKET_TYPE_SACK, PACKET_FLAG_CONFIG, 2, RADIO_ADDR_ED_FIRST, RADIO_ADDR_AP);
+   tx.body.sack.configSeq = 6;
+   tx.body.sack.config[0].type = PACKET_CONFIG_INTERVAL;
+   tx.body.sack.config[0].value[0] = 0x01;
+   tx.body.sack.config[0].value[1] = 0x2C;
+   tx.body.sack.config[1].type = PACKET_CONFIG_ZONE;
+   tx.body.sack.config[1].value[1] = 3;
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_SACK_CONFIG_SIZE(2)));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_SACK);
+   CHECK(rx.body.sack.configSeq == 6 && rx.body.sack.configCount == 2);
+   CHECK(rx.body.sack.config[0].type == PACKET_CONFIG_INTERVAL && rx.body.sack.config[0].value[1] == 0x2C);
+   CHECK(rx.body.sack.config[1].type == PACKET_CONFIG_ZONE && rx.body.sack.config[1].value[1] == 3);
+}
+
+/*! \brief BEACON sem pendMap (zerado na leitura) e com pendMap. */
+static void testBeacon(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_BEACON, 0, 8, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   tx.body.beacon.time = 0xBEEF;
+   tx.body.beacon.period = 50;
+   tx.body.beacon.slotLen = 4;
+   tx.body.beacon.slots = 3;
+   tx.body.beacon.ackMap[0] = 0x05;
+   tx.body.beacon.pendMap[0] = 0x02;              // sem PACKET_FLAG_CONFIG nao vai no ar
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_BEACON_BASE_SIZE));
+   CHECK(testScrambled(frame, (unsigned char *)&tx.body.beacon, PACKET_BEACON_BASE_SIZE));
+   memset(&rx, 0xAA, sizeof(rx));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_BEACON);
+   CHECK(rx.body.beacon.time == 0xBEEF && rx.body.beacon.period == 50 && rx.body.beacon.slots == 3);
+   CHECK(rx.body.beacon.ackMap[0] == 0x05 && rx.body.beacon.pendMap[0] == 0);
+
+   packetSetHeader(&tx, PACKET_TYPE_BEACON, PACKET_FLAG_CONFIG, 9, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_SIZE(PACKET_BEACON));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_BEACON);
+   CHECK(rx.body.beacon.pendMap[0] == 0x02);
+}
+
+/*! \brief GROUP com comandos. */
+static void testGroup(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_GROUP, 0, 5, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   tx.body.group.group = PACKET_GROUP_TYPE | 0x31;
+   tx.body.group.poll = 1;
+   tx.body.group.configCount = 1;
+   tx.body.group.config[0].type = PACKET_CONFIG_PA_MAX;
+   tx.body.group.config[0].value[1] = 6;
+   len = packetBuild(&tx, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_GROUP_SIZE(1)));
+   memset(&rx, 0, sizeof(rx));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_GROUP);
+   CHECK(rx.body.group.group == (PACKET_GROUP_TYPE | 0x31) && rx.body.group.poll == 1);
+   CHECK(rx.body.group.configCount == 1);
+   CHECK(rx.body.group.config[0].type == PACKET_CONFIG_PA_MAX && rx.body.group.config[0].value[1] == 6);
+   CHECK(packetGroupMatch(rx.body.group.group, 0x31, 0));
+   CHECK(!packetGroupMatch(rx.body.group.group, 0x32, 0));
+}
+
+/*! \brief Quadros curtos, tamanho maior que o recebido, corpo menor que o do tipo, versao
+ *   errada e contagens de eventos ou comandos acima do maximo: descartados.
+ */
+static void testBadLength(void)
+{
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET tx, rx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_DISC, 0, 1, RADIO_ADDR_AP, RADIO_ADDR_BROADCAST);
+   len = packetBuild(&tx, frame);
+   CHECK(packetParse(frame, PACKET_HEADER_SIZE - 1, &rx) == PACKET_TYPE_INVALID);
+   CHECK(packetParse(frame, len - 1, &rx) == PACKET_TYPE_INVALID);   // tamanho maior que o recebido
+   frame[0] = PACKET_HEADER_SIZE - 1 + sizeof(PACKET_DISC) - 1;       // corpo menor que o do DISC
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   len = packetBuild(&tx, frame);
+   frame[2] = ((PACKET_VERSION + 1) << 4) | PACKET_TYPE_DISC;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   len = packetBuild(&tx, frame);
+   frame[2] = (PACKET_VERSION << 4) | PACKET_TYPE_COUNT;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   // quadro completado (como no FEC): os bytes alem do tamanho sao ignorados
+   len = packetBuild(&tx, frame);
+   CHECK(packetParse(frame, len + 4, &rx) == PACKET_TYPE_DISC);
+
+   // STATUS com menos eventos no corpo que a contagem, ou contagem acima do maximo
+   packetSetHeader(&tx, PACKET_TYPE_STATUS, PACKET_FLAG_EVENTS, 2, RADIO_ADDR_AP, RADIO_ADDR_ED_FIRST);
+   tx.body.status.eventCount = 1;
+   len = packetBuild(&tx, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   len = packetBuild(&tx, frame);
+   frame[0] -= 1;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   tx.body.status.eventCount = PACKET_EVENTS_MAX + 1;  // a montagem limita ao maximo
+   len = packetBuild(&tx, frame);
+   CHECK(tx.body.status.eventCount == PACKET_EVENTS_MAX);
+   testBodyPatch(frame, len, PACKET_STATUS_BASE_SIZE + 1, PACKET_EVENTS_MAX + 1);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   // SACK e GROUP com menos comandos no corpo que a contagem, ou contagem acima do maximo
+   packetSetHeader(&tx, PACKET_TYPE_SACK, PACKET_FLAG_CONFIG, 3, RADIO_ADDR_ED_FIRST, RADIO_ADDR_AP);
+   tx.body.sack.configCount = PACKET_CONFIG_COUNT + 1;
+   len = packetBuild(&tx, frame);
+   CHECK(tx.body.sack.configCount == PACKET_CONFIG_COUNT);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_SACK_CONFIG_SIZE(PACKET_CONFIG_COUNT)));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_SACK);
+   len = packetBuild(&tx, frame);
+   testBodyPatch(frame, len, PACKET_SACK_BASE_SIZE + 1, PACKET_CONFIG_COUNT + 1);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   len = packetBuild(&tx, frame);
+   frame[0] -= 1;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   packetSetHeader(&tx, PACKET_TYPE_GROUP, 0, 4, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   tx.body.group.configCount = 2;
+   len = packetBuild(&tx, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_GROUP);
+   len = packetBuild(&tx, frame);
+   testBodyPatch(frame, len, 2, PACKET_CONFIG_COUNT + 1);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   len = packetBuild(&tx, frame);
+   frame[0] -= 1;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   // BEACON com pendMap anunciado e corpo sem ele
+   packetSetHeader(&tx, PACKET_TYPE_BEACON, PACKET_FLAG_CONFIG, 5, RADIO_ADDR_BROADCAST, RADIO_ADDR_AP);
+   len = packetBuild(&tx, frame);
+   frame[0] -= PACKET_SLOT_COUNT / 8;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+}
+
+int main(void)
+{
+   testDisc();
+   testStatus();
+   testSack();
+   testBeacon();
+   testGroup();
+   testBadLength();
+   return testSummary("packetTest");
+}
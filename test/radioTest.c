@@ -0,0 +1,561 @@
+/* \file radioTest.c
+ * \brief Testes do driver do radio (radio.c) sobre o emulador do nucleo RF1A (rf1aEmu.c).
+ */
+
+#include <string.h>
+#include "cc430x513x.h"
+#include "radio.h"
+#include "rf1a.h"
+#include "rf1aEmu.h"
+#include "test.h"
+
+#define TEST_TA1_CCR0   (15000 - 1)   // tick de 10 ms com o TA1 em SMCLK/8, como nos papeis
+#define TEST_BYTE_OPS   2             // acesso byte a byte: uma instrucao e um dado por byte
+
+void radioInit(void * pradio);
+extern const unsigned char RADIO_PA_TABLE[RADIO_PA_LEVELS];
+
+static unsigned long long ta1StartNs;
+static RADIO_TX_STATUS txDoneStatus;
+static unsigned char txDoneCount;
+
+static const unsigned char FRAME[] = {10, RADIO_ADDR_BROADCAST, 0x21, 0x00, 0x05, 0x02, 'a', 'b', 'c', 'd', 'e'};
+
+// Funcoes de apoio
+
+/*! \brief Interrupcao do tick (TA1 CCR0), como no incTimer dos papeis. */
+static void tick(void)
+{
+   ++radio1.ticks;
+}
+
+/*! \brief Callback de fim de transmissao. */
+static void txDone(void * pradio, RADIO_TX_STATUS status)
+{
+   txDoneStatus = status;
+   ++txDoneCount;
+}
+
+/*! \brief Emulador e radio na partida: TA1 com o tick, interrupcoes habilitadas e init. */
+static void setup(void)
+{
+   rf1aEmuReset();
+   memset(&radio1, 0, sizeof(radio1));
+   radio1.init = radioInit;
+
+   rf1aEmu.tick = tick;
+   TA1CCR0 = TEST_TA1_CCR0;
+   TA1CCTL0 = CCIE;
+   TA1CTL = TASSEL_2 + ID_3 + MC_1;
+   ta1StartNs = rf1aEmu.nowNs;
+   __enable_interrupt();
+
+   radio1.init(&radio1);
+}
+
+/*! \brief Deixa o tempo passar ate chegar um pacote na fila de recepcao.
+ *   \return 1 se chegou antes do timeout
+ */
+static int waitRx(unsigned long us)
+{
+   while (us--)
+   {
+      if (radio1.rxPtrIn != radio1.rxPtrOut) return 1;
+      rf1aEmuRun(1);
+   }
+   return radio1.rxPtrIn != radio1.rxPtrOut;
+}
+
+/*! \brief Roda a maquina de estados da transmissao ate terminar. */
+static void runTx(void)
+{
+   while (radio1.txStatus == RADIO_TX_STATUS_BUSY)
+   {
+      radio1.run(&radio1);
+   }
+}
+
+/*! \brief Configuracao do emulador igual a copia em RAM do driver. */
+static int regsMatchShadow(void)
+{
+   return memcmp(rf1aEmu.reg, radio1.regShadow, RADIO_CONFIG_REG_COUNT) == 0;
+}
+
+// Testes
+
+static void testInit(void)
+{
+   setup();
+   CHECK(radio1.shadowValid);
+   CHECK(regsMatchShadow());
+   CHECK(rf1aEmu.paTable == RADIO_PA_TABLE[radio1.paLevel]);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+   CHECK(rf1aEmu.calibrations == 1);
+   CHECK(rf1aEmu.regWrites[IOCFG2] == 1);
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testTransmit(void)
+{
+   setup();
+   CHECK(radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_DONE);
+   CHECK(rf1aEmu.txFrames == 1);
+   CHECK(rf1aEmu.txFrameLen == sizeof(FRAME));
+   CHECK(memcmp(rf1aEmu.txFrame, FRAME, sizeof(FRAME)) == 0);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+   CHECK(rf1aEmu.errors == 0);
+
+   // perfil lento: a transmissao dura mais que o timeout do CCA e nao pode ser confundida com CCA ocupado
+   CHECK(radio1.setPhy(&radio1, RADIO_PHY_1K2));
+   CHECK(radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_DONE);
+   CHECK(rf1aEmu.txFrames == 2);
+   CHECK(radio1.ccaFailCount == 0);
+}
+
+static void testReceive(void)
+{
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   radio1.receiveOn(&radio1);
+   rf1aEmuSend(FRAME, sizeof(FRAME), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len));
+   CHECK(len == sizeof(FRAME));
+   CHECK(memcmp(buff, FRAME, sizeof(FRAME)) == 0);
+   CHECK(radio1.rxLink.rssi == -60);
+   CHECK(radio1.rxLink.crcOk == 1);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_RX);
+   CHECK(rf1aEmu.errors == 0);
+
+   // CRC errado: entregue com crcOk = 0 e contado
+   {
+      RF1A_EMU_FRAME frame = {FRAME, sizeof(FRAME), 0, 0, -70, 0};
+
+      frame.sync = rf1aEmuSync();
+      rf1aEmuAir(&frame);
+      CHECK(waitRx(5000));
+      CHECK(radio1.getData(&radio1, buff, &len));
+      CHECK(radio1.rxLink.crcOk == 0);
+      CHECK(radio1.rxCrcError == 1);
+
+      // outra rede (palavra de sincronismo) e outro canal: o radio nem ve o pacote
+      frame.crcOk = 1;
+      frame.sync = rf1aEmuSync() ^ 0x0101;
+      rf1aEmuAir(&frame);
+      CHECK(!waitRx(5000));
+      frame.sync = rf1aEmuSync();
+      frame.channel = 3;
+      rf1aEmuAir(&frame);
+      CHECK(!waitRx(5000));
+   }
+}
+
+static void testAddressFilter(void)
+{
+   unsigned char frame[sizeof(FRAME)];
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   CHECK(radio1.setNetwork(&radio1, 2, 5));
+   CHECK(rf1aEmu.reg[ADDR] == 5);
+   radio1.receiveOn(&radio1);
+   memcpy(frame, FRAME, sizeof(FRAME));
+
+   frame[1] = 7;                       // outro endereco: descartado pelo radio
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(!waitRx(5000));
+   frame[1] = 5;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len) && (buff[1] == 5));
+   frame[1] = RADIO_ADDR_BROADCAST;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len) && (buff[1] == RADIO_ADDR_BROADCAST));
+   CHECK(rf1aEmu.errors == 0);
+}
+
+/*! \brief Com FEC o pacote tem tamanho fixo e o primeiro byte e o de tamanho: o filtro de
+ *   endereco do radio fica desligado e o driver confere o destino em software.
+ */
+static void testFecAddress(void)
+{
+   unsigned char frame[sizeof(FRAME)];
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   CHECK(radio1.setPhy(&radio1, RADIO_PHY_38K4_FEC));
+   CHECK(radio1.setNetwork(&radio1, 2, 5));
+   CHECK((rf1aEmu.reg[PKTCTRL1] & 0x03) == 0);
+   CHECK((rf1aEmu.reg[PKTCTRL0] & 0x03) == 0);
+   radio1.receiveOn(&radio1);
+   memcpy(frame, FRAME, sizeof(FRAME));
+
+   frame[1] = 7;                       // outro endereco: descartado pelo driver
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(!waitRx(30000));
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_RX);
+   frame[1] = 5;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(30000));
+   CHECK(radio1.getData(&radio1, buff, &len) && (len == sizeof(FRAME)) && (buff[1] == 5));
+   CHECK(memcmp(buff, frame, sizeof(frame)) == 0);
+   frame[1] = RADIO_ADDR_BROADCAST;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(30000));
+   CHECK(radio1.getData(&radio1, buff, &len) && (buff[1] == RADIO_ADDR_BROADCAST));
+
+   // no WOR o pacote de outro endereco nao acorda a CPU e o radio continua no WOR
+   radio1.worStart(&radio1, 0x876B, 6);
+   frame[1] = 7;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(!waitRx(30000));
+   CHECK(!radio1.worWake);
+   CHECK(radio1.state == RADIO_STATE_WOR_MODE);
+   CHECK(rf1aEmu.wor);
+   frame[1] = 5;
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(30000));
+   CHECK(radio1.worWake);
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testRxOverflow(void)
+{
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   radio1.receiveOn(&radio1);
+   rf1aEmuRxOverflow();
+   rf1aEmuRun(100);
+   CHECK(radio1.rxFifoOverflow == 1);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_RX);
+   CHECK(rf1aEmu.rxCount == 0);
+
+   // o radio volta a receber
+   rf1aEmuSend(FRAME, sizeof(FRAME), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len) && (len == sizeof(FRAME)));
+}
+
+static void testCcaBusy(void)
+{
+   setup();
+   rf1aEmu.channelBusy = 1;
+   CHECK(!radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_CCA_FAIL);
+   CHECK(radio1.ccaFailCount == radio1.csma.maxRetries + 1);
+   CHECK(radio1.txAbortCount == 1);
+   CHECK(rf1aEmu.txFrames == 0);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+
+   rf1aEmu.channelBusy = 0;
+   CHECK(radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   CHECK(rf1aEmu.txFrames == 1);
+}
+
+static void testLongPreamble(void)
+{
+   setup();
+   CHECK(radio1.transmitWakeup(&radio1, (unsigned char *)FRAME, sizeof(FRAME), 100, 0));
+   runTx();
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_DONE);
+   CHECK(rf1aEmu.txFrames == 1);
+   CHECK(memcmp(rf1aEmu.txFrame, FRAME, sizeof(FRAME)) == 0);
+   // o preambulo dura o pedido, com a folga de escrever a FIFO depois do ultimo passo
+   CHECK(rf1aEmu.txPreambleNs >= 100000000ull);
+   CHECK(rf1aEmu.txPreambleNs < 101000000ull);
+}
+
+static void testSleepWake(void)
+{
+   unsigned short resets;
+
+   setup();
+   radio1.receiveOn(&radio1);
+   radio1.sleep(&radio1);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP);
+   CHECK(radio1.retained);
+   CHECK(!regsMatchShadow());          // os registradores de teste se perdem no SLEEP
+
+   resets = rf1aEmu.strobes[RF_SRES - RF_SRES];
+   radio1.init(&radio1);
+   CHECK(rf1aEmu.strobes[RF_SRES - RF_SRES] == resets); // acordou sem reset
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+   CHECK(regsMatchShadow());
+   CHECK(rf1aEmu.regWrites[IOCFG2] == 1); // o strobe nao mexe no GDO2
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testCountersKept(void)
+{
+   RF1A_EMU_FRAME frame = {FRAME, sizeof(FRAME), 0, 0, -70, 0};
+
+   setup();
+   radio1.receiveOn(&radio1);
+   frame.sync = rf1aEmuSync();
+   rf1aEmuAir(&frame);
+   CHECK(waitRx(5000));
+   CHECK(radio1.rxCrcError == 1);
+   radio1.sleep(&radio1);
+   radio1.init(&radio1);
+   CHECK(radio1.rxCrcError == 1);
+}
+
+static void testTimestamp(void)
+{
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+   unsigned long expected;
+
+   setup();
+   rf1aEmuRun(123456);
+   radio1.receiveOn(&radio1);
+   rf1aEmuSend(FRAME, sizeof(FRAME), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len));
+   expected = (unsigned long)((rf1aEmu.rxSyncNs - ta1StartNs) / 1000);
+   CHECK(radio1.rxLink.timestamp + 20 >= expected);
+   CHECK(radio1.rxLink.timestamp <= expected + 20);
+}
+
+static void testCalibration(void)
+{
+   setup();
+   CHECK(radio1.setChannel(&radio1, 1));
+   CHECK(rf1aEmu.calibrations == 2);
+   CHECK(rf1aEmu.reg[FSCAL1] == 0x11);
+   CHECK(radio1.setChannel(&radio1, 0));
+   CHECK(radio1.setChannel(&radio1, 1));
+   CHECK(rf1aEmu.calibrations == 2);   // os dois canais usam a calibracao guardada
+   CHECK(rf1aEmu.reg[FSCAL1] == 0x11);
+
+   // depois de RADIO_FSCAL_MAX_AGE a proxima transmissao calibra de novo
+   radio1.ticks += RADIO_FSCAL_MAX_AGE;
+   CHECK(radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   CHECK(rf1aEmu.calibrations == 3);
+}
+
+static void testWor(void)
+{
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   radio1.worStart(&radio1, 0x876B, 6);
+   CHECK(rf1aEmu.wor);
+   CHECK(rf1aEmu.reg[MCSM2] == 0x16);
+   // escuta continua (janela do beacon): sem timeout e sem RX_TIME_RSSI
+   radio1.worStart(&radio1, 0x876B, RADIO_WOR_RX_UNTIL_PACKET);
+   CHECK(rf1aEmu.reg[MCSM2] == 0x07);
+   rf1aEmuSend(FRAME, sizeof(FRAME), -80);
+   CHECK(waitRx(5000));
+   CHECK(radio1.worWake);
+   CHECK(rf1aEmu.lpmExit == 1);
+   CHECK(radio1.state == RADIO_STATE_IDLE_MODE);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+   CHECK(radio1.getData(&radio1, buff, &len) && (len == sizeof(FRAME)));
+
+   radio1.init(&radio1);               // volta para a configuracao normal
+   CHECK(regsMatchShadow());
+   CHECK(rf1aEmu.reg[MCSM1] == 0x3C);
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testRxQueue(void)
+{
+   unsigned char frame[sizeof(FRAME)];
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   setup();
+   radio1.receiveOn(&radio1);
+   memcpy(frame, FRAME, sizeof(FRAME));
+
+   // a fila guarda RADIO_RX_QUEUE_SIZE - 1 pacotes, o seguinte e descartado e contado
+   for (unsigned char i = 0; i < RADIO_RX_QUEUE_SIZE; i++)
+   {
+      frame[4] = i;
+      rf1aEmuSend(frame, sizeof(frame), -60);
+      rf1aEmuRun(5000);
+   }
+   CHECK(radio1.rxQueueOverflow == 1);
+   for (unsigned char i = 0; i < RADIO_RX_QUEUE_SIZE - 1; i++)
+   {
+      CHECK(radio1.getData(&radio1, buff, &len) && (buff[4] == i));
+   }
+   CHECK(!radio1.getData(&radio1, buff, &len));
+   CHECK(len == 0);
+
+   // com a fila livre volta a receber
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(5000));
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testTxStateMachine(void)
+{
+   setup();
+   radio1.txDone = txDone;
+   txDoneCount = 0;
+
+   // canal ocupado no primeiro CCA e livre depois: transmite no backoff seguinte
+   rf1aEmu.channelBusy = 1;
+   CHECK(!radio1.transmitStart(&radio1, (unsigned char *)FRAME, 0, 1)); // quadro vazio
+#ifndef RADIO_LONG_PACKETS
+   CHECK(!radio1.transmitStart(&radio1, (unsigned char *)FRAME, RADIO_FRAME_MAX + 1, 1)); // maior que a FIFO
+#endif
+   CHECK(radio1.transmitStart(&radio1, (unsigned char *)FRAME, sizeof(FRAME), 1));
+   CHECK(!radio1.transmitStart(&radio1, (unsigned char *)FRAME, sizeof(FRAME), 1)); // ja tem uma em andamento
+   while (radio1.ccaFailCount == 0)
+   {
+      radio1.run(&radio1);
+   }
+   CHECK(radio1.txState == RADIO_TX_STATE_BACKOFF);
+   rf1aEmu.channelBusy = 0;
+   runTx();
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_DONE);
+   CHECK(radio1.txRetryCount == 1);
+   CHECK(txDoneCount == 1);
+   CHECK(txDoneStatus == RADIO_TX_STATUS_DONE);
+   CHECK(rf1aEmu.txFrames == 1);
+
+   // rxOnDone: volta para o rx no fim
+   CHECK(radio1.state == RADIO_STATE_RX_MODE);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_RX);
+
+   // receiveOn durante a transmissao fica para o fim dela
+   radio1.receiveOff(&radio1);
+   CHECK(radio1.transmitStart(&radio1, (unsigned char *)FRAME, sizeof(FRAME), 0));
+   radio1.receiveOn(&radio1);
+   CHECK(radio1.state == RADIO_STATE_IDLE_MODE);
+   runTx();
+   CHECK(radio1.state == RADIO_STATE_RX_MODE);
+   CHECK(txDoneCount == 2);
+   CHECK(rf1aEmu.errors == 0);
+}
+
+static void testBusOps(void)
+{
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+   unsigned long ops;
+
+   // configuracao completa (radio depois do reset) em uma escrita em burst
+   setup();
+   radio1.reset(&radio1);
+   ops = rf1aEmu.busOps;
+   radio1.config(&radio1);
+   ops = rf1aEmu.busOps - ops;
+   printf("  config: %lu transacoes (registrador a registrador: %u)\n", ops, RADIO_CONFIG_REG_COUNT * TEST_BYTE_OPS + 6);
+   CHECK(ops < RADIO_CONFIG_REG_COUNT + 8);
+
+   // config de novo sem mudancas: nada no barramento
+   ops = rf1aEmu.busOps;
+   radio1.config(&radio1);
+   CHECK(rf1aEmu.busOps == ops);
+
+   setup();
+   radio1.receiveOn(&radio1);
+   rf1aEmuSend(FRAME, sizeof(FRAME), -60);
+   CHECK(waitRx(5000));
+   CHECK(radio1.getData(&radio1, buff, &len));
+   printf("  rx de %u bytes: %u transacoes (byte a byte: %u)\n", (unsigned)sizeof(FRAME), radio1.rxBusOps,
+          (unsigned)((sizeof(FRAME) + 2) * TEST_BYTE_OPS));
+   CHECK(radio1.rxBusOps < (sizeof(FRAME) + 2) * TEST_BYTE_OPS);
+
+   CHECK(radio1.transmit(&radio1, (unsigned char *)FRAME, sizeof(FRAME)));
+   printf("  tx de %u bytes: %u transacoes\n", (unsigned)sizeof(FRAME), radio1.txBusOps);
+   CHECK(radio1.txBusOps < sizeof(FRAME) + 40);
+}
+
+#ifdef RADIO_LONG_PACKETS
+static void testLongPackets(void)
+{
+   unsigned char frame[201];
+   unsigned char buff[RADIO_RX_BUFFER_SIZE];
+   unsigned char len;
+
+   frame[0] = sizeof(frame) - 1;
+   frame[1] = RADIO_ADDR_BROADCAST;
+   for (unsigned short i = 2; i < sizeof(frame); i++)
+   {
+      frame[i] = (unsigned char)(i * 7);
+   }
+
+   // rx maior que a FIFO: esvaziada pela interrupcao de limiar, sem ler o ultimo byte (errata)
+   setup();
+   radio1.receiveOn(&radio1);
+   rf1aEmuSend(frame, sizeof(frame), -60);
+   CHECK(waitRx(20000));
+   CHECK(radio1.getData(&radio1, buff, &len));
+   CHECK(len == sizeof(frame));
+   CHECK(memcmp(buff, frame, sizeof(frame)) == 0);
+   CHECK(radio1.rxFifoOverflow == 0);
+   printf("  rx de %u bytes: %u transacoes (byte a byte: %u)\n", (unsigned)sizeof(frame), radio1.rxBusOps,
+          (unsigned)((sizeof(frame) + 2) * TEST_BYTE_OPS));
+   CHECK(radio1.rxBusOps < (sizeof(frame) + 2) * TEST_BYTE_OPS);
+
+   // tx maior que a FIFO: completada pela interrupcao de limiar da FIFO de tx
+   CHECK(radio1.transmit(&radio1, frame, sizeof(frame)));
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_DONE);
+   CHECK(rf1aEmu.txFrameLen == sizeof(frame));
+   CHECK(memcmp(rf1aEmu.txFrame, frame, sizeof(frame)) == 0);
+   CHECK(radio1.txFifoUnderflow == 0);
+
+   // CPU ocupada: a FIFO de tx esvazia antes da interrupcao de limiar, que so e atendida
+   // depois do PA desligar; a transmissao tem que terminar com underflow, nao com DONE
+   rf1aEmu.irqHold = 1;
+   CHECK(radio1.transmitStart(&radio1, frame, sizeof(frame), 0));
+   while ((rf1aEmu.marcState != RF1A_EMU_MARC_TX_UNF) && (radio1.txStatus == RADIO_TX_STATUS_BUSY))
+   {
+      radio1.run(&radio1);
+   }
+   rf1aEmu.irqHold = 0;
+   runTx();
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_UNDERFLOW);
+   CHECK(radio1.txFifoUnderflow == 1);
+
+   // sem a interrupcao nenhuma: o underflow e visto no TXBYTES
+   rf1aEmu.irqHold = 1;
+   CHECK(!radio1.transmit(&radio1, frame, sizeof(frame)));
+   rf1aEmu.irqHold = 0;
+   CHECK(radio1.txStatus == RADIO_TX_STATUS_UNDERFLOW);
+   CHECK(radio1.txFifoUnderflow == 2);
+   CHECK(rf1aEmu.marcState == RF1A_EMU_MARC_IDLE);
+   CHECK(rf1aEmu.errors == 0);
+}
+#endif
+
+int main(void)
+{
+   testInit();
+   testTransmit();
+   testReceive();
+   testAddressFilter();
+   testFecAddress();
+   testRxOverflow();
+   testCcaBusy();
+   testLongPreamble();
+   testSleepWake();
+   testCountersKept();
+   testTimestamp();
+   testCalibration();
+   testWor();
+   testRxQueue();
+   testTxStateMachine();
+   testBusOps();
+#ifdef RADIO_LONG_PACKETS
+   testLongPackets();
+   return testSummary("radioLongTest");
+#else
+   return testSummary("radioTest");
+#endif
+}
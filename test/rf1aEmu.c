@@ -0,0 +1,978 @@
+/* \file rf1aEmu.c
+ * \brief Emulador do nucleo de radio (RF1A/CC1101) e dos registradores do CC430 usados pelo
+ * radio.c, para os testes no PC. Substitui o rf1a.c na ligacao.
+ */
+
+#include <string.h>
+#include "cc430x513x.h"
+#include "radio.h"
+#include "rf1a.h"
+#include "rf1aEmu.h"
+
+// defines
+#define EMU_ACCESS_NS      250ul      // acesso da CPU a um registrador (3 ciclos a 12 MHz)
+#define EMU_STEP_NS        1000ul     // passo maximo da simulacao
+#define EMU_SMCLK_HZ       12000000ull
+#define EMU_ACLK_HZ        32768ull
+#define EMU_FXOSC_HZ       26000000.0
+#define EMU_RSSI_VALID_NS  100000ull  // do SRX ate o RSSI valido
+#define EMU_CAL_NS         720000ull  // calibracao do sintetizador (SCAL)
+#define EMU_WAKE_NOPS      3          // strobes com CHIP_RDYn depois do SLEEP
+#define EMU_STATUS_CHIP_RDYN 0x80
+#define EMU_REG_NOT_RETAINED FSTEST   // FSTEST, PTEST, AGCTEST e TEST2..0 se perdem no SLEEP
+#define EMU_RSSI_OFFSET    74
+
+RF1A_EMU rf1aEmu;
+
+// registradores do CC430 acessados pelo radio.c
+volatile unsigned short hostRF1AIFG;
+volatile unsigned short hostRF1AIE;
+volatile unsigned short hostRF1AIES;
+volatile unsigned short hostRF1AIN;
+volatile unsigned short hostRF1AIV;
+volatile unsigned short hostRF1AIFERR;
+volatile unsigned short hostTA0CTL;
+volatile unsigned short hostTA0CCTL0;
+volatile unsigned short hostTA0CCR0;
+volatile unsigned short hostTA0R;
+volatile unsigned short hostTA1CTL;
+volatile unsigned short hostTA1CCTL0;
+volatile unsigned short hostTA1CCR0;
+volatile unsigned short hostTA1R;
+
+// valores de reset dos registradores de configuracao (datasheet do CC1101)
+static const unsigned char EMU_REG_RESET[0x2F] =
+{
+   0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, 0x45, 0x00, 0x00, 0x0F, 0x00, 0x1E, 0xC4, 0xEC,
+   0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30, 0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B,
+   0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41, 0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B
+};
+
+static const unsigned char EMU_PREAMBLE_BYTES[8] = {2, 3, 4, 6, 8, 12, 16, 24};
+
+void CC1101_ISR(void);
+
+// Prototipos das funcoes de apoio
+static void emuAdvance(unsigned long ns);
+static void emuTimer(volatile unsigned short * ctl, volatile unsigned short * cctl0, volatile unsigned short * ccr0,
+                     volatile unsigned short * r, unsigned long long * acc, unsigned long ns);
+static void emuRadio(void);
+static void emuSignals(void);
+static void emuIrq(void);
+static void emuSetState(unsigned char marc);
+static unsigned char emuStrobe(unsigned char addr);
+static unsigned char emuStatus(void);
+static void emuAirStep(void);
+static void emuRxByte(unsigned char b);
+static void emuRxEnd(void);
+static void emuRxDiscard(void);
+static void emuTxStep(void);
+static void emuSleep(void);
+static unsigned char emuFixedLength(void);
+static unsigned long emuDataByteNs(void);
+static unsigned char emuReadReg(unsigned char addr);
+static void emuWriteReg(unsigned char addr, unsigned char value);
+static unsigned char emuRxPop(void);
+static void emuTxPush(unsigned char b);
+static istate_t emuBusEnter(void);
+static void emuBusExit(istate_t s, unsigned short ops);
+
+/*! \brief Volta o emulador para o estado de power-on: nucleo em IDLE com a configuracao de
+ *   reset, FIFOs vazias, registradores do CC430 zerados e interrupcoes desabilitadas.
+ */
+void rf1aEmuReset(void)
+{
+   memset(&rf1aEmu, 0, sizeof(rf1aEmu));
+   memcpy(rf1aEmu.reg, EMU_REG_RESET, sizeof(EMU_REG_RESET));
+   rf1aEmu.paTable = 0xC6;
+   rf1aEmu.marcState = RF1A_EMU_MARC_IDLE;
+   rf1aEmu.lqi = 0x7F;
+
+   hostRF1AIFG = 0;
+   hostRF1AIE = 0;
+   hostRF1AIES = 0;
+   hostRF1AIV = 0;
+   hostRF1AIFERR = 0;
+   hostTA0CTL = 0;
+   hostTA0CCTL0 = 0;
+   hostTA0CCR0 = 0;
+   hostTA0R = 0;
+   hostTA1CTL = 0;
+   hostTA1CCTL0 = 0;
+   hostTA1CCR0 = 0;
+   hostTA1R = 0;
+
+   rf1aEmu.in = 0;
+   emuSignals();
+   hostRF1AIFG = 0;
+}
+
+/*! \brief Deixa o tempo passar (a CPU parada no laco principal ou em LPM). */
+void rf1aEmuRun(unsigned long us)
+{
+   while (us--)
+   {
+      emuAdvance(1000);
+   }
+}
+
+/*! \brief Coloca um pacote no ar. Ele e recebido se o radio estiver em rx (ou em WOR) no
+ *   canal e com a palavra de sincronismo do pacote quando a sync terminar.
+ */
+void rf1aEmuAir(const RF1A_EMU_FRAME * frame)
+{
+   unsigned short len = (frame->len > RF1A_EMU_FRAME_SIZE) ? RF1A_EMU_FRAME_SIZE : frame->len;
+
+   memset(rf1aEmu.air.data, 0, sizeof(rf1aEmu.air.data));
+   memcpy(rf1aEmu.air.data, frame->data, len);
+   rf1aEmu.air.len = len;
+   rf1aEmu.air.sync = frame->sync;
+   rf1aEmu.air.channel = frame->channel;
+   rf1aEmu.air.rssi = frame->rssi;
+   rf1aEmu.air.crcOk = frame->crcOk;
+   rf1aEmu.air.active = 1;
+   rf1aEmu.air.phase = 0;
+   rf1aEmu.air.receiving = 0;
+   rf1aEmu.air.pos = 0;
+   rf1aEmu.air.nextAt = rf1aEmu.nowNs +
+      (unsigned long long)(EMU_PREAMBLE_BYTES[(rf1aEmu.reg[MDMCFG1] >> 4) & 7] + 4) * rf1aEmuByteNs();
+}
+
+/*! \brief Coloca no ar um pacote com CRC correto na rede e no canal configurados no radio. */
+void rf1aEmuSend(const unsigned char * data, unsigned short len, signed char rssi)
+{
+   RF1A_EMU_FRAME frame;
+
+   frame.data = data;
+   frame.len = len;
+   frame.sync = rf1aEmuSync();
+   frame.channel = rf1aEmu.reg[CHANNR];
+   frame.rssi = rssi;
+   frame.crcOk = 1;
+   rf1aEmuAir(&frame);
+}
+
+/*! \brief Forca o estouro da FIFO de rx, como se a CPU nao tivesse lido a FIFO a tempo. */
+void rf1aEmuRxOverflow(void)
+{
+   if ((rf1aEmu.marcState == RF1A_EMU_MARC_RX) || rf1aEmu.wor)
+   {
+      rf1aEmu.rxCount = RF1A_EMU_FIFO_SIZE;
+      rf1aEmu.wor = 0;
+      emuSetState(RF1A_EMU_MARC_RX_OVF);
+      emuSignals();
+      emuIrq();
+   }
+}
+
+/*! \brief Palavra de sincronismo configurada (SYNC1:SYNC0). */
+unsigned short rf1aEmuSync(void)
+{
+   return ((unsigned short)rf1aEmu.reg[SYNC1] << 8) | rf1aEmu.reg[SYNC0];
+}
+
+/*! \brief Duracao de um byte no ar em ns, pela taxa configurada em MDMCFG4/MDMCFG3. */
+unsigned long rf1aEmuByteNs(void)
+{
+   double rate = (256.0 + rf1aEmu.reg[MDMCFG3]) * (double)(1ul << (rf1aEmu.reg[MDMCFG4] & 0x0F)) *
+                 EMU_FXOSC_HZ / 268435456.0;
+
+   return (unsigned long)(8e9 / rate);
+}
+
+// Interface de rf1a.h
+
+void BSP_Delay(unsigned short usec)
+{
+   emuAdvance(usec * 1000ul);
+}
+
+unsigned char radioStrobe(unsigned char addr)
+{
+   unsigned char statusByte;
+   unsigned short ops = 1;
+   istate_t s = emuBusEnter();
+
+   statusByte = emuStrobe(addr);
+   if ((addr > RF_SRES) && (addr < RF_SNOP) && (statusByte & EMU_STATUS_CHIP_RDYN) &&
+       (addr != RF_SXOFF) && (addr != RF_SPWD) && (addr != RF_SWOR))
+   { // acordando do SLEEP: espera o CHIP_RDYn
+      do
+      {
+         statusByte = emuStrobe(RF_SNOP);
+         ++ops;
+      }
+      while (statusByte & EMU_STATUS_CHIP_RDYN);
+      emuAdvance(760000ul);
+   }
+   emuBusExit(s, ops);
+   return statusByte;
+}
+
+unsigned char radioWritePaTable(unsigned char value)
+{
+   istate_t s = emuBusEnter();
+
+   if (rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP) ++rf1aEmu.errors;
+   rf1aEmu.paTable = value;
+   emuBusExit(s, 6);
+   return rf1aEmu.paTable;
+}
+
+void radioWriteReg(unsigned char addr, unsigned char value)
+{
+   istate_t s = emuBusEnter();
+
+   emuWriteReg(addr, value);
+   emuBusExit(s, 2);
+}
+
+unsigned char radioReadReg(unsigned char addr)
+{
+   unsigned char value;
+   istate_t s = emuBusEnter();
+
+   value = emuReadReg(addr);
+   emuBusExit(s, 2);
+   return value;
+}
+
+void radioWriteBurstReg(unsigned char addr, const unsigned char * pData, unsigned char len)
+{
+   istate_t s;
+
+   if (len == 0) return;
+
+   s = emuBusEnter();
+   for (unsigned char i = 0; i < len; i++)
+   {
+      if (addr == TXFIFO)
+      {
+         emuTxPush(pData[i]);
+      }
+      else
+      {
+         emuWriteReg(addr + i, pData[i]);
+      }
+   }
+   emuBusExit(s, len);
+}
+
+void radioReadBurstReg(unsigned char addr, unsigned char * pData, unsigned char len)
+{
+   istate_t s;
+
+   if (len == 0) return;
+
+   s = emuBusEnter();
+   for (unsigned char i = 0; i < len; i++)
+   {
+      pData[i] = (addr == RXFIFO) ? emuRxPop() : emuReadReg(addr + i);
+   }
+   emuBusExit(s, len + 1);
+}
+
+void radioReadRxFifo(unsigned char * pData, unsigned char len)
+{
+   radioReadBurstReg(RXFIFO, pData, len);
+}
+
+void radioWriteTxFifo(unsigned char * pData, unsigned char len)
+{
+   radioWriteBurstReg(TXFIFO, pData, len);
+}
+
+// Intrinsecos do compilador e acesso aos registradores do CC430
+
+istate_t __get_interrupt_state(void)
+{
+   return (rf1aEmu.gie) ? GIE : 0;
+}
+
+void __disable_interrupt(void)
+{
+   rf1aEmu.gie = 0;
+}
+
+void __enable_interrupt(void)
+{
+   rf1aEmu.gie = 1;
+   emuIrq();
+}
+
+void __set_interrupt_state(istate_t state)
+{
+   rf1aEmu.gie = (state & GIE) ? 1 : 0;
+   emuIrq();
+}
+
+void __bic_SR_register_on_exit(unsigned short bits)
+{
+   if (bits & CPUOFF) ++rf1aEmu.lpmExit;
+}
+
+/*! \brief Acesso da CPU a um registrador: avanca o tempo e, para o RF1AIV, entrega a
+ *   interrupcao pendente de maior prioridade e limpa o flag dela.
+ */
+volatile unsigned short * hostReg(volatile unsigned short * reg)
+{
+   emuAdvance(EMU_ACCESS_NS);
+   if (reg == &hostRF1AIV)
+   {
+      unsigned short pending = hostRF1AIFG & hostRF1AIE;
+
+      hostRF1AIV = RF1AIV_NONE;
+      for (unsigned char n = 0; n < 16; n++)
+      {
+         if (pending & (1u << n))
+         {
+            hostRF1AIV = 2 * (n + 1);
+            hostRF1AIFG &= ~(1u << n);
+            break;
+         }
+      }
+   }
+   return reg;
+}
+
+// Funcoes de apoio
+
+/*! \brief Avanca o tempo em passos de ate 1 us: timers, ar, sinais dos GDOs e interrupcoes. */
+static void emuAdvance(unsigned long ns)
+{
+   while (ns)
+   {
+      unsigned long step = (ns > EMU_STEP_NS) ? EMU_STEP_NS : ns;
+
+      ns -= step;
+      rf1aEmu.nowNs += step;
+      emuTimer(&hostTA0CTL, &hostTA0CCTL0, &hostTA0CCR0, &hostTA0R, &rf1aEmu.ta0Acc, step);
+      emuTimer(&hostTA1CTL, &hostTA1CCTL0, &hostTA1CCR0, &hostTA1R, &rf1aEmu.ta1Acc, step);
+      emuRadio();
+      emuSignals();
+      emuIrq();
+   }
+}
+
+/*! \brief Timer_A em up mode: conta de 0 ate CCR0 e liga o CCIFG do CCR0 ao chegar nele. */
+static void emuTimer(volatile unsigned short * ctl, volatile unsigned short * cctl0, volatile unsigned short * ccr0,
+                     volatile unsigned short * r, unsigned long long * acc, unsigned long ns)
+{
+   unsigned long long hz;
+
+   if (*ctl & TACLR)
+   {
+      *r = 0;
+      *acc = 0;
+      *ctl &= ~TACLR;
+   }
+   if ((*ctl & MC_3) != MC_1)
+   {
+      return;
+   }
+   hz = (((*ctl & 0x0300) == TASSEL_2) ? EMU_SMCLK_HZ : EMU_ACLK_HZ) >> ((*ctl >> 6) & 3);
+   *acc += hz * ns;
+   while (*acc >= 1000000000ull)
+   {
+      *acc -= 1000000000ull;
+      if (*r >= *ccr0)
+      {
+         *r = 0;
+      }
+      else if (++(*r) == *ccr0)
+      {
+         *cctl0 |= CCIFG;
+      }
+   }
+}
+
+/*! \brief Eventos do nucleo do radio que venceram: fim da calibracao, bytes no ar e na tx. */
+static void emuRadio(void)
+{
+   if (rf1aEmu.calEndAt && (rf1aEmu.nowNs >= rf1aEmu.calEndAt))
+   { // resultado da calibracao depende do canal, para os testes verem o cache do driver
+      rf1aEmu.calEndAt = 0;
+      rf1aEmu.reg[FSCAL3] = 0xE9;
+      rf1aEmu.reg[FSCAL2] = 0x2A;
+      rf1aEmu.reg[FSCAL1] = 0x10 + rf1aEmu.reg[CHANNR];
+      emuSetState(RF1A_EMU_MARC_IDLE);
+   }
+   while (rf1aEmu.air.active && (rf1aEmu.nowNs >= rf1aEmu.air.nextAt))
+   {
+      emuAirStep();
+   }
+   while (rf1aEmu.txPhase && (rf1aEmu.nowNs >= rf1aEmu.txNextAt))
+   {
+      emuTxStep();
+   }
+}
+
+/*! \brief Sinal de um GDO conforme o IOCFGx (so as funcoes usadas pelo driver). */
+static unsigned char emuGdo(unsigned char cfg)
+{
+   unsigned char v;
+
+   switch (cfg & 0x3F)
+   {
+      case 0x00: // FIFO de rx no limiar ou acima
+         v = (rf1aEmu.rxCount >= 4 * ((rf1aEmu.reg[FIFOTHR] & 0x0F) + 1));
+         break;
+      case 0x02: // FIFO de tx no limiar ou acima
+         v = (rf1aEmu.txCount >= 65 - 4 * ((rf1aEmu.reg[FIFOTHR] & 0x0F) + 1));
+         break;
+      case 0x06: // palavra de sincronismo ate o fim do pacote
+         v = rf1aEmu.sync;
+         break;
+      case 0x1B: // PA_PD: baixo no TX (e no SLEEP)
+         v = (rf1aEmu.marcState != RF1A_EMU_MARC_TX) && (rf1aEmu.marcState != RF1A_EMU_MARC_SLEEP);
+         break;
+      case 0x1E: // RSSI valido
+         v = rf1aEmu.rssiValidAt && (rf1aEmu.nowNs >= rf1aEmu.rssiValidAt);
+         break;
+      case 0x29: // CHIP_RDYn
+         v = (rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP) || rf1aEmu.waking;
+         break;
+      default:
+         v = 0;
+         break;
+   }
+   if (cfg & 0x40)
+   {
+      v = !v;
+   }
+   return v;
+}
+
+/*! \brief Atualiza o RF1AIN e liga em RF1AIFG as bordas selecionadas em RF1AIES. */
+static void emuSignals(void)
+{
+   unsigned short in;
+   unsigned short changed;
+
+   in = emuGdo(rf1aEmu.reg[IOCFG0]) | (emuGdo(rf1aEmu.reg[IOCFG1]) << 1) | (emuGdo(rf1aEmu.reg[IOCFG2]) << 2);
+   if (emuGdo(0x00)) in |= BIT3;
+   if (emuGdo(0x02)) in |= BIT5;
+   if (rf1aEmu.sync) in |= BIT9;
+
+   changed = in ^ rf1aEmu.in;
+   hostRF1AIFG |= (changed & in & ~hostRF1AIES) | (changed & ~in & hostRF1AIES);
+   hostRF1AIN = in;
+   rf1aEmu.in = in;
+}
+
+/*! \brief Chama as rotinas de interrupcao pendentes se a CPU aceita interrupcoes. */
+static void emuIrq(void)
+{
+   if (!rf1aEmu.gie || rf1aEmu.inIsr)
+   {
+      return;
+   }
+   for (;;)
+   {
+      if (!rf1aEmu.irqHold && (hostRF1AIFG & hostRF1AIE))
+      {
+         rf1aEmu.inIsr = 1;
+         rf1aEmu.gie = 0;
+         CC1101_ISR();
+      }
+      else if ((hostTA1CCTL0 & (CCIE | CCIFG)) == (CCIE | CCIFG))
+      { // o CCIFG do CCR0 e limpo na entrada da interrupcao
+         hostTA1CCTL0 &= ~CCIFG;
+         rf1aEmu.inIsr = 1;
+         rf1aEmu.gie = 0;
+         if (rf1aEmu.tick) rf1aEmu.tick();
+      }
+      else
+      {
+         break;
+      }
+      rf1aEmu.gie = 1;
+      rf1aEmu.inIsr = 0;
+   }
+}
+
+/*! \brief Muda o MARCSTATE e faz o que vem junto: RSSI, inicio da tx, fim da rx. */
+static void emuSetState(unsigned char marc)
+{
+   unsigned char old = rf1aEmu.marcState;
+
+   if ((old == RF1A_EMU_MARC_RX) && (marc != RF1A_EMU_MARC_RX))
+   { // sai do rx: abandona o pacote que estava recebendo
+      rf1aEmu.rssiValidAt = 0;
+      if (rf1aEmu.air.receiving)
+      {
+         rf1aEmu.air.receiving = 0;
+         rf1aEmu.sync = 0;
+      }
+   }
+   if ((old == RF1A_EMU_MARC_TX) && (marc != RF1A_EMU_MARC_TX) && rf1aEmu.txPhase)
+   { // transmissao interrompida
+      rf1aEmu.txPhase = 0;
+      rf1aEmu.sync = 0;
+   }
+   rf1aEmu.marcState = marc;
+   if ((marc == RF1A_EMU_MARC_RX) && (old != RF1A_EMU_MARC_RX))
+   {
+      rf1aEmu.rssiValidAt = rf1aEmu.nowNs + EMU_RSSI_VALID_NS;
+   }
+   if ((marc == RF1A_EMU_MARC_TX) && (old != RF1A_EMU_MARC_TX))
+   {
+      rf1aEmu.txPhase = 1;
+      rf1aEmu.txPhaseBytes = 0;
+      rf1aEmu.txStartNs = rf1aEmu.nowNs;
+      rf1aEmu.txNextAt = rf1aEmu.nowNs + rf1aEmuByteNs();
+   }
+}
+
+/*! \brief Proximo estado depois de um pacote (RXOFF_MODE ou TXOFF_MODE do MCSM1). */
+static void emuOffMode(unsigned char mode)
+{
+   static const unsigned char next[4] =
+      {RF1A_EMU_MARC_IDLE, RF1A_EMU_MARC_FSTXON, RF1A_EMU_MARC_TX, RF1A_EMU_MARC_RX};
+
+   if (next[mode & 3] == rf1aEmu.marcState)
+   { // continua no mesmo estado: o rx volta a procurar a sync, o tx manda outro pacote
+      rf1aEmu.marcState = RF1A_EMU_MARC_IDLE;
+   }
+   emuSetState(next[mode & 3]);
+}
+
+/*! \brief Executa um strobe.
+ *   \return byte de status
+ */
+static unsigned char emuStrobe(unsigned char addr)
+{
+   if ((addr >= RF_SRES) && (addr <= RF_SNOP))
+   {
+      ++rf1aEmu.strobes[addr - RF_SRES];
+   }
+
+   if (addr == RF_SRES)
+   {
+      memcpy(rf1aEmu.reg, EMU_REG_RESET, sizeof(EMU_REG_RESET));
+      rf1aEmu.paTable = 0xC6;
+      rf1aEmu.rxCount = 0;
+      rf1aEmu.txCount = 0;
+      rf1aEmu.wor = 0;
+      rf1aEmu.waking = 0;
+      rf1aEmu.calEndAt = 0;
+      emuSetState(RF1A_EMU_MARC_IDLE);
+      return emuStatus();
+   }
+
+   if (rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP)
+   { // o strobe so acorda o nucleo, que volta para IDLE depois do cristal estabilizar
+      if (rf1aEmu.waking == 0)
+      {
+         rf1aEmu.waking = EMU_WAKE_NOPS;
+      }
+      if (--rf1aEmu.waking == 0)
+      {
+         rf1aEmu.wor = 0;
+         emuSetState(RF1A_EMU_MARC_IDLE);
+         return emuStatus();
+      }
+      return EMU_STATUS_CHIP_RDYN;
+   }
+
+   switch (addr)
+   {
+      case RF_SFSTXON:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE) emuSetState(RF1A_EMU_MARC_FSTXON);
+         break;
+      case RF_SCAL:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE)
+         {
+            ++rf1aEmu.calibrations;
+            rf1aEmu.calEndAt = rf1aEmu.nowNs + EMU_CAL_NS;
+            emuSetState(RF1A_EMU_MARC_MANCAL);
+         }
+         break;
+      case RF_SRX:
+         if ((rf1aEmu.marcState == RF1A_EMU_MARC_IDLE) || (rf1aEmu.marcState == RF1A_EMU_MARC_FSTXON))
+         {
+            emuSetState(RF1A_EMU_MARC_RX);
+         }
+         break;
+      case RF_STX:
+         if ((rf1aEmu.marcState == RF1A_EMU_MARC_IDLE) || (rf1aEmu.marcState == RF1A_EMU_MARC_FSTXON))
+         {
+            emuSetState(RF1A_EMU_MARC_TX);
+         }
+         else if (rf1aEmu.marcState == RF1A_EMU_MARC_RX)
+         { // CCA (MCSM1.CCA_MODE): fica no rx se o canal estiver ocupado
+            if (!((rf1aEmu.reg[MCSM1] >> 4) & 3) || !(rf1aEmu.channelBusy || rf1aEmu.air.active))
+            {
+               emuSetState(RF1A_EMU_MARC_TX);
+            }
+         }
+         break;
+      case RF_SIDLE:
+         rf1aEmu.calEndAt = 0;
+         emuSetState(RF1A_EMU_MARC_IDLE);
+         break;
+      case RF_SWOR:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE)
+         {
+            emuSleep();
+            rf1aEmu.wor = 1;
+         }
+         break;
+      case RF_SPWD:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE)
+         {
+            emuSleep();
+         }
+         break;
+      case RF_SFRX:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_RX_OVF)
+         {
+            emuSetState(RF1A_EMU_MARC_IDLE);
+         }
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE)
+         {
+            rf1aEmu.rxCount = 0;
+         }
+         break;
+      case RF_SFTX:
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_TX_UNF)
+         {
+            emuSetState(RF1A_EMU_MARC_IDLE);
+         }
+         if (rf1aEmu.marcState == RF1A_EMU_MARC_IDLE)
+         {
+            rf1aEmu.txCount = 0;
+         }
+         break;
+      default: // SXOFF, SWORRST, SNOP
+         break;
+   }
+   return emuStatus();
+}
+
+/*! \brief Byte de status: CHIP_RDYn, estado e bytes na FIFO de rx (ate 15). */
+static unsigned char emuStatus(void)
+{
+   unsigned char state;
+
+   switch (rf1aEmu.marcState)
+   {
+      case RF1A_EMU_MARC_RX:     state = 1; break;
+      case RF1A_EMU_MARC_TX:     state = 2; break;
+      case RF1A_EMU_MARC_FSTXON: state = 3; break;
+      case RF1A_EMU_MARC_MANCAL: state = 4; break;
+      case RF1A_EMU_MARC_RX_OVF: state = 6; break;
+      case RF1A_EMU_MARC_TX_UNF: state = 7; break;
+      default:                   state = 0; break;
+   }
+   return ((rf1aEmu.waking) ? EMU_STATUS_CHIP_RDYN : 0) | (state << 4) | ((rf1aEmu.rxCount > 15) ? 15 : rf1aEmu.rxCount);
+}
+
+/*! \brief SLEEP (SPWD ou entre os eventos do WOR): perde os registradores de teste. */
+static void emuSleep(void)
+{
+   memcpy(&rf1aEmu.reg[EMU_REG_NOT_RETAINED], &EMU_REG_RESET[EMU_REG_NOT_RETAINED], 0x2F - EMU_REG_NOT_RETAINED);
+   emuSetState(RF1A_EMU_MARC_SLEEP);
+}
+
+static unsigned char emuFixedLength(void)
+{
+   return (rf1aEmu.reg[PKTCTRL0] & 0x03) == 0;
+}
+
+/*! \brief Duracao de um byte de dados no ar: com FEC cada byte vira dois. */
+static unsigned long emuDataByteNs(void)
+{
+   return (rf1aEmu.reg[MDMCFG1] & 0x80) ? 2 * rf1aEmuByteNs() : rf1aEmuByteNs();
+}
+
+/*! \brief Proximo passo do pacote no ar: fim da sync, um byte de dados ou o fim do CRC. */
+static void emuAirStep(void)
+{
+   unsigned char listening = (rf1aEmu.marcState == RF1A_EMU_MARC_RX) || rf1aEmu.wor;
+
+   switch (rf1aEmu.air.phase)
+   {
+      case 0: // fim do preambulo e da sync
+         rf1aEmu.air.phase = 1;
+         rf1aEmu.air.pos = 0;
+         rf1aEmu.air.total = (emuFixedLength()) ? rf1aEmu.reg[PKTLEN] : rf1aEmu.air.data[0] + 1;
+         if (listening && (rf1aEmu.air.sync == rf1aEmuSync()) && (rf1aEmu.air.channel == rf1aEmu.reg[CHANNR]))
+         {
+            if (rf1aEmu.wor)
+            { // o evento do WOR achou o preambulo
+               rf1aEmu.wor = 0;
+               emuSetState(RF1A_EMU_MARC_RX);
+            }
+            rf1aEmu.air.receiving = 1;
+            rf1aEmu.sync = 1;
+            ++rf1aEmu.rxSyncs;
+            rf1aEmu.rxSyncNs = rf1aEmu.nowNs;
+         }
+         rf1aEmu.air.nextAt += emuDataByteNs();
+         break;
+      case 1:
+         if (rf1aEmu.air.receiving)
+         {
+            emuRxByte(rf1aEmu.air.data[rf1aEmu.air.pos]);
+         }
+         if (++rf1aEmu.air.pos >= rf1aEmu.air.total)
+         {
+            rf1aEmu.air.phase = 2;
+            rf1aEmu.air.nextAt += 2 * emuDataByteNs();
+         }
+         else
+         {
+            rf1aEmu.air.nextAt += emuDataByteNs();
+         }
+         break;
+      default: // fim do CRC
+         if (rf1aEmu.air.receiving)
+         {
+            emuRxEnd();
+         }
+         rf1aEmu.air.active = 0;
+         rf1aEmu.air.receiving = 0;
+         break;
+   }
+}
+
+/*! \brief Um byte recebido: vai para a FIFO de rx e passa pelos filtros de tamanho e endereco. */
+static void emuRxByte(unsigned char b)
+{
+   unsigned char adrChk = rf1aEmu.reg[PKTCTRL1] & 0x03;
+
+   if (rf1aEmu.rxCount >= RF1A_EMU_FIFO_SIZE)
+   {
+      rf1aEmu.air.receiving = 0;
+      rf1aEmu.sync = 0;
+      emuSetState(RF1A_EMU_MARC_RX_OVF);
+      return;
+   }
+   rf1aEmu.rxFifo[(rf1aEmu.rxHead + rf1aEmu.rxCount) % RF1A_EMU_FIFO_SIZE] = b;
+   ++rf1aEmu.rxCount;
+
+   if (!emuFixedLength() && (rf1aEmu.air.pos == 0) && (b > rf1aEmu.reg[PKTLEN]))
+   {
+      emuRxDiscard();
+   }
+   else if (adrChk && (rf1aEmu.air.pos == (emuFixedLength() ? 0 : 1)) &&
+            (b != rf1aEmu.reg[ADDR]) && !((adrChk >= 2) && (b == 0x00)) && !((adrChk == 3) && (b == 0xFF)))
+   {
+      emuRxDiscard();
+   }
+}
+
+/*! \brief Pacote descartado pelos filtros: sai da FIFO e o radio volta a procurar a sync. */
+static void emuRxDiscard(void)
+{
+   unsigned char n = rf1aEmu.air.pos + 1;
+
+   rf1aEmu.rxCount = (rf1aEmu.rxCount > n) ? rf1aEmu.rxCount - n : 0;
+   rf1aEmu.air.receiving = 0;
+   rf1aEmu.sync = 0;
+}
+
+/*! \brief Fim do pacote recebido: bytes de status (APPEND_STATUS) e RXOFF_MODE. */
+static void emuRxEnd(void)
+{
+   rf1aEmu.lqi = 0x20;
+   rf1aEmu.crcOk = rf1aEmu.air.crcOk;
+   if (rf1aEmu.reg[PKTCTRL1] & 0x04)
+   {
+      unsigned char status[2];
+
+      status[0] = (unsigned char)((rf1aEmu.air.rssi + EMU_RSSI_OFFSET) * 2);
+      status[1] = rf1aEmu.lqi | ((rf1aEmu.crcOk) ? 0x80 : 0);
+      for (unsigned char i = 0; i < 2; i++)
+      {
+         if (rf1aEmu.rxCount >= RF1A_EMU_FIFO_SIZE)
+         {
+            rf1aEmu.sync = 0;
+            emuSetState(RF1A_EMU_MARC_RX_OVF);
+            return;
+         }
+         rf1aEmu.rxFifo[(rf1aEmu.rxHead + rf1aEmu.rxCount) % RF1A_EMU_FIFO_SIZE] = status[i];
+         ++rf1aEmu.rxCount;
+      }
+   }
+   if ((rf1aEmu.reg[PKTCTRL1] & 0x08) && !rf1aEmu.crcOk)
+   { // CRC_AUTOFLUSH
+      rf1aEmu.rxCount = 0;
+   }
+   rf1aEmu.sync = 0;
+   rf1aEmu.air.receiving = 0;
+   emuOffMode(rf1aEmu.reg[MCSM1] >> 2);
+}
+
+/*! \brief Proximo byte da transmissao: preambulo (enquanto a FIFO estiver vazia), sync,
+ *   dados da FIFO de tx e CRC.
+ */
+static void emuTxStep(void)
+{
+   unsigned char b;
+
+   switch (rf1aEmu.txPhase)
+   {
+      case 1: // preambulo
+         if ((++rf1aEmu.txPhaseBytes >= EMU_PREAMBLE_BYTES[(rf1aEmu.reg[MDMCFG1] >> 4) & 7]) && rf1aEmu.txCount)
+         {
+            rf1aEmu.txPhase = 2;
+            rf1aEmu.txPhaseBytes = 0;
+            rf1aEmu.txPreambleNs = rf1aEmu.nowNs - rf1aEmu.txStartNs;
+         }
+         rf1aEmu.txNextAt += rf1aEmuByteNs();
+         break;
+      case 2: // sync
+         if (++rf1aEmu.txPhaseBytes >= (((rf1aEmu.reg[MDMCFG2] & 3) == 3) ? 4 : 2))
+         {
+            rf1aEmu.txPhase = 3;
+            rf1aEmu.txFrameLen = 0;
+            rf1aEmu.txTotal = RF1A_EMU_FRAME_SIZE;
+            rf1aEmu.txSyncNs = rf1aEmu.nowNs;
+            rf1aEmu.sync = 1;
+            rf1aEmu.txNextAt += emuDataByteNs();
+         }
+         else
+         {
+            rf1aEmu.txNextAt += rf1aEmuByteNs();
+         }
+         break;
+      case 3: // dados
+         if (rf1aEmu.txCount == 0)
+         {
+            rf1aEmu.sync = 0;
+            emuSetState(RF1A_EMU_MARC_TX_UNF);
+            break;
+         }
+         b = rf1aEmu.txFifo[rf1aEmu.txHead];
+         rf1aEmu.txHead = (rf1aEmu.txHead + 1) % RF1A_EMU_FIFO_SIZE;
+         --rf1aEmu.txCount;
+         if (rf1aEmu.txFrameLen < RF1A_EMU_FRAME_SIZE)
+         {
+            rf1aEmu.txFrame[rf1aEmu.txFrameLen] = b;
+         }
+         if (++rf1aEmu.txFrameLen == 1)
+         {
+            rf1aEmu.txTotal = (emuFixedLength()) ? rf1aEmu.reg[PKTLEN] : b + 1;
+         }
+         if (rf1aEmu.txFrameLen >= rf1aEmu.txTotal)
+         {
+            rf1aEmu.txPhase = 4;
+            rf1aEmu.txNextAt += 2 * emuDataByteNs();
+         }
+         else
+         {
+            rf1aEmu.txNextAt += emuDataByteNs();
+         }
+         break;
+      default: // fim do CRC
+         rf1aEmu.txPhase = 0;
+         rf1aEmu.sync = 0;
+         ++rf1aEmu.txFrames;
+         emuOffMode(rf1aEmu.reg[MCSM1]);
+         break;
+   }
+}
+
+static unsigned char emuReadReg(unsigned char addr)
+{
+   signed char rssi;
+
+   if (rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP) ++rf1aEmu.errors;
+   if (addr < 0x2F)
+   {
+      return rf1aEmu.reg[addr];
+   }
+   switch (addr)
+   {
+      case PATABLE:
+         return rf1aEmu.paTable;
+      case VERSION:
+         return 0x06;
+      case LQI:
+         return rf1aEmu.lqi | ((rf1aEmu.crcOk) ? 0x80 : 0);
+      case RSSI:
+         rssi = (rf1aEmu.air.receiving) ? rf1aEmu.air.rssi :
+                (rf1aEmu.channelBusy) ? RF1A_EMU_BUSY_DBM : RF1A_EMU_NOISE_DBM;
+         return (unsigned char)((rssi + EMU_RSSI_OFFSET) * 2);
+      case MARCSTATE:
+         return rf1aEmu.marcState;
+      case PKTSTATUS:
+         return ((rf1aEmu.crcOk) ? 0x80 : 0) | ((rf1aEmu.channelBusy) ? 0x40 : 0) | ((rf1aEmu.sync) ? 0x08 : 0);
+      case TXBYTES:
+         return rf1aEmu.txCount | ((rf1aEmu.marcState == RF1A_EMU_MARC_TX_UNF) ? 0x80 : 0);
+      case RXBYTES:
+         return rf1aEmu.rxCount | ((rf1aEmu.marcState == RF1A_EMU_MARC_RX_OVF) ? 0x80 : 0);
+      default:
+         return 0;
+   }
+}
+
+static void emuWriteReg(unsigned char addr, unsigned char value)
+{
+   if (rf1aEmu.marcState == RF1A_EMU_MARC_SLEEP) ++rf1aEmu.errors;
+   if (addr < 0x2F)
+   {
+      rf1aEmu.reg[addr] = value;
+      ++rf1aEmu.regWrites[addr];
+   }
+   else if (addr == PATABLE)
+   {
+      rf1aEmu.paTable = value;
+   }
+}
+
+/*! \brief Le um byte da FIFO de rx. Esvaziar a FIFO durante a recepcao e erro (errata do CC1101). */
+static unsigned char emuRxPop(void)
+{
+   unsigned char b;
+
+   if ((rf1aEmu.rxCount == 0) || ((rf1aEmu.rxCount == 1) && rf1aEmu.air.receiving))
+   {
+      ++rf1aEmu.errors;
+   }
+   if (rf1aEmu.rxCount == 0)
+   {
+      return 0;
+   }
+   b = rf1aEmu.rxFifo[rf1aEmu.rxHead];
+   rf1aEmu.rxHead = (rf1aEmu.rxHead + 1) % RF1A_EMU_FIFO_SIZE;
+   --rf1aEmu.rxCount;
+   return b;
+}
+
+static void emuTxPush(unsigned char b)
+{
+   if (rf1aEmu.txCount >= RF1A_EMU_FIFO_SIZE)
+   {
+      ++rf1aEmu.errors;
+      return;
+   }
+   if (rf1aEmu.marcState == RF1A_EMU_MARC_TX_UNF)
+   {
+      return;
+   }
+   rf1aEmu.txFifo[(rf1aEmu.txHead + rf1aEmu.txCount) % RF1A_EMU_FIFO_SIZE] = b;
+   ++rf1aEmu.txCount;
+}
+
+/*! \brief Inicio de um acesso ao barramento do radio: as funcoes de rf1a.c travam as interrupcoes. */
+static istate_t emuBusEnter(void)
+{
+   istate_t s = __get_interrupt_state();
+
+   rf1aEmu.gie = 0;
+   return s;
+}
+
+/*! \brief Fim de um acesso ao barramento: conta as transacoes, avanca o tempo e libera as interrupcoes. */
+static void emuBusExit(istate_t s, unsigned short ops)
+{
+   rf1aEmu.busOps += ops;
+#ifdef RADIO_BUS_STATS
+   radio1.busOps += ops;
+#endif
+   emuAdvance(ops * EMU_ACCESS_NS);
+   __set_interrupt_state(s);
+}
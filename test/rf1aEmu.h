@@ -0,0 +1,130 @@
+/*! \file rf1aEmu.h
+ *  \brief emulador do nucleo de radio do CC430 (RF1A/CC1101) para testar o driver no PC.
+ *
+ *  Implementa a interface de rf1a.h sobre um modelo do CC1101: registradores de configuracao
+ *  e de status, strobes, FIFOs de rx e tx, MARCSTATE, CHIP_RDYn depois do SLEEP e os sinais
+ *  dos GDOs em RF1AIN, com as bordas (RF1AIES) em RF1AIFG e o vetor RF1AIV. O radio.c e
+ *  ligado sem nenhuma mudanca no lugar de rf1a.c.
+ *
+ *  O tempo so anda quando o driver acessa um registrador ou o barramento do radio, ou quando
+ *  o teste chama rf1aEmuRun. A interrupcao do radio (CC1101_ISR) e a do tick (TA1 CCR0) sao
+ *  chamadas pelo emulador quando estao pendentes e habilitadas.
+ *
+ *  Sinais em RF1AIN (os mesmos que o driver usa):
+ *  - bit 0..2: GDO0..GDO2 conforme IOCFG0..2 (0x1B PA_PD, 0x1E RSSI valido, 0x06 sync, 0x29 CHIP_RDYn)
+ *  - bit 3: FIFO de rx no limiar ou acima (FIFOTHR)
+ *  - bit 5: FIFO de tx no limiar ou acima (FIFOTHR)
+ *  - bit 9: palavra de sincronismo ate o fim do pacote
+ */
+
+#ifndef RF1A_EMU_H
+#define RF1A_EMU_H
+
+#define RF1A_EMU_FIFO_SIZE      64
+#define RF1A_EMU_FRAME_SIZE     256
+#define RF1A_EMU_NOISE_DBM      (-100)    // RSSI sem portadora
+#define RF1A_EMU_BUSY_DBM       (-40)     // RSSI com o canal ocupado
+
+// MARCSTATE do CC1101
+#define RF1A_EMU_MARC_SLEEP     0x00
+#define RF1A_EMU_MARC_IDLE      0x01
+#define RF1A_EMU_MARC_MANCAL    0x05
+#define RF1A_EMU_MARC_FSTXON    0x12
+#define RF1A_EMU_MARC_RX        0x0D
+#define RF1A_EMU_MARC_RX_OVF    0x11
+#define RF1A_EMU_MARC_TX        0x13
+#define RF1A_EMU_MARC_TX_UNF    0x16
+
+// pacote colocado no ar pelo teste
+typedef struct
+{
+   const unsigned char * data;   // como escrito na FIFO de tx: tamanho + dados
+   unsigned short len;           // bytes em data (no tamanho fixo, o que faltar e zero)
+   unsigned short sync;          // palavra de sincronismo (SYNC1:SYNC0)
+   unsigned char  channel;
+   signed char    rssi;          // dBm
+   unsigned char  crcOk;
+} RF1A_EMU_FRAME;
+
+typedef struct
+{
+   // nucleo do radio
+   unsigned char  reg[0x2F];     // IOCFG2 ate TEST0
+   unsigned char  paTable;
+   unsigned char  marcState;
+   unsigned char  wor;           // SWOR: dormindo, recebe os pacotes como se estivesse em rx
+   unsigned char  waking;        // strobes que ainda veem CHIP_RDYn depois do SLEEP
+   unsigned char  rxFifo[RF1A_EMU_FIFO_SIZE];
+   unsigned char  rxCount;
+   unsigned char  rxHead;
+   unsigned char  txFifo[RF1A_EMU_FIFO_SIZE];
+   unsigned char  txCount;
+   unsigned char  txHead;
+   unsigned char  lqi;           // status do ultimo pacote recebido
+   unsigned char  crcOk;
+   unsigned long long rssiValidAt;   // instante em que o RSSI fica valido no rx (0 = fora do rx)
+   unsigned long long calEndAt;      // fim da calibracao (SCAL)
+   unsigned char  sync;          // sinal da palavra de sincronismo (ate o fim do pacote)
+   unsigned short in;            // ultimo valor de RF1AIN
+
+   // canal
+   unsigned char  channelBusy;   // portadora de outro transmissor: o CCA falha
+   struct
+   {
+      unsigned char  data[RF1A_EMU_FRAME_SIZE];
+      unsigned short len;
+      unsigned short sync;
+      unsigned char  channel;
+      signed char    rssi;
+      unsigned char  crcOk;
+      unsigned char  active;     // pacote no ar
+      unsigned char  phase;      // 0 preambulo e sync, 1 dados, 2 CRC
+      unsigned char  receiving;  // o radio achou a palavra de sincronismo e esta recebendo
+      unsigned short pos;        // bytes de dados ja transmitidos
+      unsigned short total;      // bytes de dados do pacote (tamanho fixo ou variavel)
+      unsigned long long nextAt;
+   } air;
+
+   // transmissao
+   unsigned char  txPhase;       // 0 nada, 1 preambulo, 2 sync, 3 dados, 4 CRC
+   unsigned short txPhaseBytes;
+   unsigned short txTotal;
+   unsigned long long txNextAt;
+   unsigned long long txStartNs;
+   unsigned long long txSyncNs;
+   unsigned char  txFrame[RF1A_EMU_FRAME_SIZE]; // ultimo pacote transmitido (bytes da FIFO)
+   unsigned short txFrameLen;
+   unsigned short txFrames;      // pacotes transmitidos ate o fim
+   unsigned long long txPreambleNs; // preambulo do ultimo pacote (do inicio do tx ate a sync)
+
+   // CPU e timers
+   unsigned long long nowNs;
+   unsigned char  gie;
+   unsigned char  inIsr;
+   unsigned char  irqHold;       // segura a interrupcao do radio (simula a CPU ocupada)
+   unsigned long long ta0Acc;
+   unsigned long long ta1Acc;
+   void (* tick)(void);          // interrupcao do TA1 CCR0 (tick do sistema)
+   unsigned short lpmExit;       // pedidos de saida do LPM pela interrupcao
+
+   // contadores
+   unsigned long  busOps;        // transacoes no barramento, contadas como em rf1a.c
+   unsigned short strobes[0x0E]; // strobes recebidos (indice addr - RF_SRES)
+   unsigned short regWrites[0x2F];
+   unsigned short calibrations;
+   unsigned short rxSyncs;       // palavras de sincronismo achadas
+   unsigned long long rxSyncNs;  // instante da ultima
+   unsigned short errors;        // acessos invalidos (FIFO vazia/cheia, registrador no SLEEP)
+} RF1A_EMU;
+
+extern RF1A_EMU rf1aEmu;
+
+void rf1aEmuReset(void);
+void rf1aEmuRun(unsigned long us);
+void rf1aEmuAir(const RF1A_EMU_FRAME * frame);
+void rf1aEmuSend(const unsigned char * data, unsigned short len, signed char rssi);
+void rf1aEmuRxOverflow(void);
+unsigned short rf1aEmuSync(void);
+unsigned long rf1aEmuByteNs(void);
+
+#endif
@@ -0,0 +1,78 @@
+/* \file scramblerBench.c
+ * \brief Vazao do scrambler.c (um byte por passo) contra a versao bit a bit, no PC.
+ *
+ *  No MSP430 a diferenca e da mesma ordem: o laco de 8 passos por byte vira um XOR e dois
+ *  deslocamentos.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "scrambler.h"
+#include "scramblerRef.h"
+
+#define BENCH_LEN      64
+#define BENCH_ROUNDS   200000
+
+static unsigned char sink;
+
+static double benchSeconds(clock_t start)
+{
+   return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(void)
+{
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   unsigned char in[BENCH_LEN], out[BENCH_LEN];
+   double mbytes = (double)BENCH_LEN * BENCH_ROUNDS / 1e6;
+   double tRef, tByte, tRefDe, tByteDe;
+   clock_t start;
+
+   for (unsigned char i = 0; i < BENCH_LEN; i++)
+   {
+      in[i] = (unsigned char)(i * 37 + 11);
+   }
+
+   start = clock();
+   for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+   {
+      in[0] = (unsigned char)n;
+      scramblerRef(in, out, BENCH_LEN, seed, 1);
+      sink ^= out[BENCH_LEN - 1];
+   }
+   tRef = benchSeconds(start);
+
+   start = clock();
+   for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+   {
+      in[0] = (unsigned char)n;
+      scrambler(in, out, BENCH_LEN, seed);
+      sink ^= out[BENCH_LEN - 1];
+   }
+   tByte = benchSeconds(start);
+
+   start = clock();
+   for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+   {
+      in[0] = (unsigned char)n;
+      scramblerRef(in, out, BENCH_LEN, seed, 0);
+      sink ^= out[BENCH_LEN - 1];
+   }
+   tRefDe = benchSeconds(start);
+
+   start = clock();
+   for (unsigned long n = 0; n < BENCH_ROUNDS; n++)
+   {
+      in[0] = (unsigned char)n;
+      descrambler(in, out, BENCH_LEN, seed);
+      sink ^= out[BENCH_LEN - 1];
+   }
+   tByteDe = benchSeconds(start);
+
+   printf("%d x %d bytes (%u)\n", BENCH_ROUNDS, BENCH_LEN, sink);
+   printf("scrambler:   bit a bit %7.1f MB/s, byte a byte %7.1f MB/s (%.1fx)\n",
+          mbytes / tRef, mbytes / tByte, tRef / tByte);
+   printf("descrambler: bit a bit %7.1f MB/s, byte a byte %7.1f MB/s (%.1fx)\n",
+          mbytes / tRefDe, mbytes / tByteDe, tRefDe / tByteDe);
+   return 0;
+}
@@ -0,0 +1,42 @@
+/*! \file scramblerRef.h
+ *  \brief versao original, bit a bit, do scrambler: referencia para o scrambler.c.
+ */
+
+#ifndef SCRAMBLER_REF_H
+#define SCRAMBLER_REF_H
+
+/*! \brief Um passo do registrador de 23 bits (x^23 + x^18 + 1), bit mais significativo primeiro.
+ *   \return bit de saida
+ */
+static unsigned char scramblerRefBit(unsigned char shifter[3], unsigned char bitIn, char scramble)
+{
+   unsigned char bit18 = (shifter[2] >> 2) & 0x01;
+   unsigned char bit23 = (shifter[2] >> 7) & 0x01;
+   unsigned char bitOut = (bitIn ^ (bit18 ^ bit23));
+
+   shifter[2] <<= 1;
+   shifter[2] |= (shifter[1] >> 7);
+   shifter[1] <<= 1;
+   shifter[1] |= (shifter[0] >> 7);
+   shifter[0] <<= 1;
+   shifter[0] |= (scramble) ? bitOut : bitIn;   // realimentado pela saida no scrambler
+   return bitOut;
+}
+
+static void scramblerRef(unsigned char * dataIn, unsigned char * dataOut, unsigned char len, unsigned char seed[3], char scramble)
+{
+   unsigned char shifter[3] = {seed[0], seed[1], seed[2]};
+
+   for (unsigned char i = 0; i < len; i++)
+   {
+      unsigned char byteIn = dataIn[i];
+
+      dataOut[i] = 0;
+      for (unsigned char j = 0; j < 8; j++)
+      {
+         dataOut[i] |= (unsigned char)(scramblerRefBit(shifter, (byteIn >> (7 - j)) & 0x01, scramble) << (7 - j));
+      }
+   }
+}
+
+#endif
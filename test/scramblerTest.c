@@ -0,0 +1,74 @@
+/* \file scramblerTest.c
+ * \brief O scrambler.c (um byte por passo) tem que dar o mesmo resultado da versao bit a bit.
+ */
+
+#include <string.h>
+#include "scrambler.h"
+#include "scramblerRef.h"
+#include "test.h"
+
+#define TEST_ROUNDS   20000
+
+static unsigned long randState = 0x12345678;
+
+/*! \brief Gerador pseudo-aleatorio (xorshift32), para o teste ser repetivel. */
+static unsigned char testRandom(void)
+{
+   randState ^= (randState << 13) & 0xFFFFFFFF;
+   randState ^= randState >> 17;
+   randState ^= (randState << 5) & 0xFFFFFFFF;
+   return (unsigned char)randState;
+}
+
+/*! \brief Semente do pacote: a saida conhecida dos primeiros bytes nao pode mudar entre versoes. */
+static void testKnownVector(void)
+{
+   unsigned char seed[3] = {SCRAMBLER_SEED1, SCRAMBLER_SEED2, SCRAMBLER_SEED3};
+   unsigned char zero[8] = {0};
+   unsigned char ref[8], out[8];
+
+   scramblerRef(zero, ref, sizeof(zero), seed, 1);
+   scrambler(zero, out, sizeof(zero), seed);
+   CHECK(memcmp(ref, out, sizeof(out)) == 0);
+   CHECK(memcmp(seed, "\x01\x23\x45", 3) == 0);  // a semente nao e alterada
+}
+
+/*! \brief Buffers, tamanhos e sementes aleatorios nos dois sentidos, inclusive no mesmo buffer. */
+static void testRandomBuffers(void)
+{
+   unsigned char in[255], ref[255], out[255], back[255];
+   unsigned short diffs = 0, roundTrip = 0;
+
+   for (unsigned short n = 0; n < TEST_ROUNDS; n++)
+   {
+      unsigned char seed[3] = {testRandom(), testRandom(), testRandom()};
+      unsigned char len = testRandom();
+
+      for (unsigned char i = 0; i < len; i++)
+      {
+         in[i] = testRandom();
+      }
+
+      scramblerRef(in, ref, len, seed, 1);
+      scrambler(in, out, len, seed);
+      diffs += (memcmp(ref, out, len) != 0);
+
+      scramblerRef(out, ref, len, seed, 0);
+      descrambler(out, back, len, seed);
+      diffs += (memcmp(ref, back, len) != 0);
+      roundTrip += (memcmp(in, back, len) != 0);
+
+      memcpy(back, in, len);             // entrada e saida no mesmo buffer, como no packet.c
+      scrambler(back, back, len, seed);
+      diffs += (memcmp(out, back, len) != 0);
+   }
+   CHECK(diffs == 0);
+   CHECK(roundTrip == 0);
+}
+
+int main(void)
+{
+   testKnownVector();
+   testRandomBuffers();
+   return testSummary("scramblerTest");
+}
@@ -0,0 +1,250 @@
+/* \file securityTest.c
+ * \brief Testes da seguranca dos pacotes no PC (aes.c com AES_SOFTWARE e packet.c com
+ *  PACKET_SECURITY): vetores do FIPS-197 e da RFC 3610 (por isso o MIC de 8 bytes nesta
+ *  compilacao), ida e volta pelo packetBuild/packetParse, chaves derivadas do segredo da
+ *  instalacao, nonce dos EDs sem endereco e a troca de epoca do contador.
+ */
+
+#include <string.h>
+#include "packet.h"
+#include "radio.h"
+#include "test.h"
+
+static unsigned short savedEpoch;
+static unsigned short epochSaves;
+
+static void epochSave(unsigned short epoch)
+{
+   savedEpoch = epoch;
+   ++epochSaves;
+}
+
+/*! \brief AES-128 do FIPS-197 (apendice C.1). */
+static void testAes(void)
+{
+   static const unsigned char key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                         0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+   static const unsigned char plain[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+                                           0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+   static const unsigned char cipher[16] = {0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30,
+                                            0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A};
+   unsigned char out[16];
+
+   aesEncrypt(key, plain, out);
+   CHECK(memcmp(out, cipher, 16) == 0);
+}
+
+/*! \brief CCM da RFC 3610 (packet vector #1: M = 8, L = 2). */
+static void testCcm(void)
+{
+   static const unsigned char key[16] = {0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7,
+                                         0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF};
+   static const unsigned char nonce[13] = {0x00, 0x00, 0x00, 0x03, 0x02, 0x01, 0x00,
+                                           0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+   static const unsigned char cipher[23] = {0x58, 0x8C, 0x97, 0x9A, 0x61, 0xC6, 0x63, 0xD2,
+                                            0xF0, 0x66, 0xD0, 0xC2, 0xC0, 0xF9, 0x89, 0x80,
+                                            0x6D, 0x5F, 0x6B, 0x61, 0xDA, 0xC3, 0x84};
+   static const unsigned char tag[8] = {0x17, 0xE8, 0xD1, 0x2C, 0xFD, 0xF9, 0x26, 0xE0};
+   unsigned char aad[8];
+   unsigned char data[23];
+   unsigned char mic[8];
+
+   for (unsigned char i = 0; i < 8; i++)
+   {
+      aad[i] = i;
+   }
+   for (unsigned char i = 0; i < 23; i++)
+   {
+      data[i] = (unsigned char)(8 + i);
+   }
+   aesCcmEncrypt(key, nonce, aad, 8, data, 23, mic);
+   CHECK(memcmp(data, cipher, 23) == 0);
+   CHECK(memcmp(mic, tag, 8) == 0);
+
+   CHECK(aesCcmDecrypt(key, nonce, aad, 8, data, 23, mic));
+   CHECK(data[0] == 8 && data[22] == 30);
+
+   // dado associado alterado: o MIC nao confere
+   aesCcmEncrypt(key, nonce, aad, 8, data, 23, mic);
+   aad[3] ^= 0x01;
+   CHECK(!aesCcmDecrypt(key, nonce, aad, 8, data, 23, mic));
+}
+
+/*! \brief Monta um STATUS sem eventos nem canais. */
+static unsigned char statusBuild(unsigned char src, const unsigned char * id, unsigned char * frame)
+{
+   PACKET tx;
+
+   memset(&tx, 0, sizeof(tx));
+   packetSetHeader(&tx, PACKET_TYPE_STATUS, 0, 7, RADIO_ADDR_AP, src);
+   memcpy(tx.body.status.id, id, PACKET_ID_SIZE);
+   tx.body.status.sensorType = 0x31;
+   tx.body.status.value[0] = 'F';
+   tx.body.status.value[1] = 'F';
+   tx.body.status.paLevel = 3;
+   return packetBuild(&tx, frame);
+}
+
+/*! \brief Ida e volta pelo packetBuild/packetParse, com o contador no cabecalho e o MIC. */
+static void testRoundTrip(void)
+{
+   static const unsigned char id[PACKET_ID_SIZE] = {0x12, 0x34, 0x56, 0x78};
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET rx;
+
+   epochSaves = 0;
+   packetSecurityInit(41, epochSave, 0);
+   CHECK(savedEpoch == 42 && epochSaves == 1);
+   packetSetNetwork(1);
+
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(len == PACKET_FRAME_SIZE(PACKET_STATUS_BASE_SIZE));
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(rx.hdr.counter == ((42ul << 16) | 1));
+   CHECK(memcmp(rx.body.status.id, id, PACKET_ID_SIZE) == 0);
+   CHECK(rx.body.status.sensorType == 0x31 && rx.body.status.paLevel == 3);
+
+   // com endereco o corpo todo vai cifrado
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(memcmp(&frame[PACKET_HEADER_SIZE], id, PACKET_ID_SIZE) != 0);
+
+   // corpo, cabecalho ou MIC alterados: descartado
+   frame[PACKET_HEADER_SIZE + 5] ^= 0x40;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   frame[4] ^= 0x01;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   frame[len - 1] ^= 0x80;
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+}
+
+/*! \brief Chaves das redes: de fabrica sem segredo; com segredo so quem tem o mesmo segredo
+ *   le os pacotes, menos na rede de pareamento.
+ */
+static void testKeys(void)
+{
+   static const unsigned char id[PACKET_ID_SIZE] = {0x01, 0x02, 0x03, 0x04};
+   static const unsigned char secret1[16] = {0x5E, 0xC2, 0x37, 0x01, 0x9A, 0x44, 0xB0, 0x6D,
+                                             0x18, 0xF3, 0x2B, 0x85, 0xC7, 0x60, 0x0E, 0xD9};
+   static const unsigned char secret2[16] = {0x5E, 0xC2, 0x37, 0x01, 0x9A, 0x44, 0xB0, 0x6D,
+                                             0x18, 0xF3, 0x2B, 0x85, 0xC7, 0x60, 0x0E, 0xD8};
+   unsigned char frame[64];
+   unsigned char len;
+   PACKET rx;
+
+   // pacote da instalacao 1 na rede 1
+   packetSecurityInit(0, epochSave, secret1);
+   packetSetNetwork(1);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+
+   // sem segredo (chaves de fabrica) ou com outro segredo nao passa
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   packetSecurityInit(0, epochSave, 0);
+   packetSetNetwork(1);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+   packetSecurityInit(0, epochSave, secret1);
+   packetSetNetwork(1);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   packetSecurityInit(0, epochSave, secret2);
+   packetSetNetwork(1);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   // cada rede tem a sua chave
+   packetSecurityInit(0, epochSave, secret1);
+   packetSetNetwork(1);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   packetSetNetwork(2);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_INVALID);
+
+   // a rede de pareamento fica com a chave de fabrica
+   packetSetNetwork(RADIO_NETWORK_PAIRING);
+   len = statusBuild(RADIO_ADDR_BROADCAST, id, frame);
+   packetSecurityInit(0, epochSave, 0);
+   packetSetNetwork(RADIO_NETWORK_PAIRING);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+}
+
+/*! \brief EDs sem endereco com o mesmo contador: o ID vai aberto, entra no MIC e muda o nonce
+ *   (o resto do corpo cifrado sai diferente).
+ */
+static void testPairingNonce(void)
+{
+   static const unsigned char id1[PACKET_ID_SIZE] = {0xA0, 0x00, 0x00, 0x01};
+   static const unsigned char id2[PACKET_ID_SIZE] = {0xA0, 0x00, 0x00, 0x02};
+   unsigned char frame1[64], frame2[64];
+   unsigned char len1, len2;
+   PACKET rx;
+
+   packetSecurityInit(0, epochSave, 0);
+   packetSetNetwork(RADIO_NETWORK_PAIRING);
+   len1 = statusBuild(RADIO_ADDR_BROADCAST, id1, frame1);
+   packetSecurityInit(0, epochSave, 0);
+   len2 = statusBuild(RADIO_ADDR_BROADCAST, id2, frame2);
+   CHECK(len1 == len2);
+   CHECK(memcmp(&frame1[6], &frame2[6], PACKET_COUNTER_SIZE) == 0);
+   CHECK(memcmp(&frame1[PACKET_HEADER_SIZE], id1, PACKET_ID_SIZE) == 0);
+   CHECK(memcmp(&frame2[PACKET_HEADER_SIZE], id2, PACKET_ID_SIZE) == 0);
+   CHECK(memcmp(&frame1[PACKET_HEADER_SIZE + PACKET_ID_SIZE], &frame2[PACKET_HEADER_SIZE + PACKET_ID_SIZE],
+                PACKET_STATUS_BASE_SIZE - PACKET_ID_SIZE) != 0);
+
+   CHECK(packetParse(frame1, len1, &rx) == PACKET_TYPE_STATUS);
+   CHECK(memcmp(rx.body.status.id, id1, PACKET_ID_SIZE) == 0);
+   CHECK(packetParse(frame2, len2, &rx) == PACKET_TYPE_STATUS);
+   CHECK(memcmp(rx.body.status.id, id2, PACKET_ID_SIZE) == 0);
+
+   // ID trocado no ar: o MIC nao confere
+   len1 = statusBuild(RADIO_ADDR_BROADCAST, id1, frame1);
+   frame1[PACKET_HEADER_SIZE + 3] = 0x02;
+   CHECK(packetParse(frame1, len1, &rx) == PACKET_TYPE_INVALID);
+}
+
+/*! \brief Proxima epoca: a contagem recomeca, a epoca e gravada e o contador continua
+ *   mais novo que o ultimo aceito.
+ */
+static void testEpoch(void)
+{
+   static const unsigned char id[PACKET_ID_SIZE] = {0x01, 0x02, 0x03, 0x04};
+   unsigned char frame[64];
+   unsigned char len;
+   unsigned long last = 0;
+   PACKET rx;
+
+   packetSecurityInit(9, epochSave, 0);
+   packetSetNetwork(1);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(rx.hdr.counter == ((10ul << 16) | 2));
+   CHECK(packetCounterFresh(rx.hdr.counter, &last));
+   CHECK(!packetCounterFresh(rx.hdr.counter, &last));
+
+   epochSaves = 0;
+   packetEpochNext();
+   CHECK(savedEpoch == 11 && epochSaves == 1);
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(rx.hdr.counter == ((11ul << 16) | 1));
+   CHECK(packetCounterFresh(rx.hdr.counter, &last));
+
+   // limite do AP depois do boot (epoca 11 gravada): so aceita a partir da epoca 12
+   last = (11ul << 16) | 0xFFFF;
+   CHECK(!packetCounterFresh(rx.hdr.counter, &last));
+   packetEpochNext();
+   len = statusBuild(RADIO_ADDR_ED_FIRST, id, frame);
+   CHECK(packetParse(frame, len, &rx) == PACKET_TYPE_STATUS);
+   CHECK(packetCounterFresh(rx.hdr.counter, &last));
+}
+
+int main(void)
+{
+   testAes();
+   testCcm();
+   testRoundTrip();
+   testKeys();
+   testPairingNonce();
+   testEpoch();
+   return testSummary("securityTest");
+}
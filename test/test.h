@@ -0,0 +1,34 @@
+/*! \file test.h
+ *  \brief verificacoes minimas dos testes no PC: CHECK conta as falhas e mostra onde foi.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int testChecks;
+static int testFails;
+
+#define CHECK(cond)  testCheck((cond) != 0, #cond, __FILE__, __LINE__)
+
+static void testCheck(int ok, const char * expr, const char * file, int line)
+{
+   ++testChecks;
+   if (!ok)
+   {
+      ++testFails;
+      printf("%s:%d: falhou: %s\n", file, line, expr);
+   }
+}
+
+/*! \brief Mostra o resumo.
+ *   \return codigo de saida do programa (0 se nao teve falhas)
+ */
+static int testSummary(const char * name)
+{
+   printf("%s: %d verificacoes, %d falhas\n", name, testChecks, testFails);
+   return testFails != 0;
+}
+
+#endif